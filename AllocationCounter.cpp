@@ -0,0 +1,119 @@
+#include "AllocationCounter.h"
+
+#include <assert.h>
+#include <stdio.h>
+
+#include <atomic>
+
+namespace Memory
+{
+	namespace AllocationCounter
+	{
+		// ----------------------------------------------------------
+
+		static std::atomic<uint64_t> sAllocations(0);
+		static std::atomic<uint64_t> sFrees(0);
+
+		// Set between BeginFrame and EndFrame once the warm up is over
+		static std::atomic<bool>     sSteadyStateFrame(false);
+
+		static uint64_t              sFrameStartAllocations       = 0;
+		static uint64_t              sFrameStartFrees             = 0;
+		static uint64_t              sLastFrameAllocations        = 0;
+		static uint64_t              sLastFrameFrees              = 0;
+		static uint64_t              sMostFrameAllocations        = 0;
+		static unsigned int          sSteadyStateFrames           = 0;
+		static unsigned int          sSteadyStateFramesAllocating = 0;
+
+		// ----------------------------------------------------------
+
+		void RecordAllocation(size_t bytes)
+		{
+			sAllocations.fetch_add(1, std::memory_order_relaxed);
+
+#if AssertNoFrameAllocations
+			// printf rather than cout, which could allocate its way back into here
+			if (sSteadyStateFrame.load(std::memory_order_relaxed))
+			{
+				printf("Heap allocation of %zu bytes during a frame after the warm up\n", bytes);
+				assert("Heap allocation during a steady state frame" && false);
+			}
+#else
+			(void)bytes;
+#endif
+		}
+
+		// ----------------------------------------------------------
+
+		void RecordFree()
+		{
+			sFrees.fetch_add(1, std::memory_order_relaxed);
+
+#if AssertNoFrameAllocations
+			if (sSteadyStateFrame.load(std::memory_order_relaxed))
+			{
+				printf("Heap free during a frame after the warm up\n");
+				assert("Heap free during a steady state frame" && false);
+			}
+#endif
+		}
+
+		// ----------------------------------------------------------
+
+		void BeginFrame(unsigned int frameNumber)
+		{
+			sFrameStartAllocations = sAllocations.load(std::memory_order_relaxed);
+			sFrameStartFrees       = sFrees.load(std::memory_order_relaxed);
+
+			sSteadyStateFrame.store(frameNumber >= FrameAllocationWarmupFrames, std::memory_order_relaxed);
+		}
+
+		// ----------------------------------------------------------
+
+		void EndFrame()
+		{
+			sLastFrameAllocations = sAllocations.load(std::memory_order_relaxed) - sFrameStartAllocations;
+			sLastFrameFrees       = sFrees.load(std::memory_order_relaxed)       - sFrameStartFrees;
+
+			if (sSteadyStateFrame.load(std::memory_order_relaxed))
+			{
+				sSteadyStateFrames++;
+
+				if (sLastFrameAllocations > 0 || sLastFrameFrees > 0)
+					sSteadyStateFramesAllocating++;
+
+				if (sLastFrameAllocations > sMostFrameAllocations)
+					sMostFrameAllocations = sLastFrameAllocations;
+			}
+
+			sSteadyStateFrame.store(false, std::memory_order_relaxed);
+		}
+
+		// ----------------------------------------------------------
+
+		uint64_t GetLastFrameAllocations()
+		{
+			return sLastFrameAllocations;
+		}
+
+		// ----------------------------------------------------------
+
+		uint64_t GetLastFrameFrees()
+		{
+			return sLastFrameFrees;
+		}
+
+		// ----------------------------------------------------------
+
+		void Output()
+		{
+			printf("Heap allocations / frees through the overrides: %llu / %llu\n",
+				(unsigned long long)sAllocations.load(), (unsigned long long)sFrees.load());
+
+			printf("Frames after the warm up that touched the heap: %u of %u (most allocations in one: %llu)\n",
+				sSteadyStateFramesAllocating, sSteadyStateFrames, (unsigned long long)sMostFrameAllocations);
+		}
+
+		// ----------------------------------------------------------
+	}
+}
\ No newline at end of file
@@ -0,0 +1,34 @@
+#pragma once
+
+#include "Commons.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace Memory
+{
+	// ----------------------------------------------------------
+
+	// Counts the allocations and frees that go through the new/delete overrides, and how many of them landed inside a frame
+	// of Quadtree::Update. Once the lists have reached their size a frame should not touch the heap at all, so with
+	// AssertNoFrameAllocations anything that does after FrameAllocationWarmupFrames asserts on the spot, with the culprit on
+	// the stack. Counts every thread - nothing else should be allocating while the workers are running a frame either
+	namespace AllocationCounter
+	{
+		// Called by the overrides
+		void     RecordAllocation(size_t bytes);
+		void     RecordFree();
+
+		// Around each frame, by the thread that drives the frames
+		void     BeginFrame(unsigned int frameNumber);
+		void     EndFrame();
+
+		uint64_t GetLastFrameAllocations();
+		uint64_t GetLastFrameFrees();
+
+		// Totals since the start, and how many frames after the warm up touched the heap at all
+		void     Output();
+	}
+
+	// ----------------------------------------------------------
+}
\ No newline at end of file
@@ -0,0 +1,354 @@
+#include "AllocationSampler.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <iostream>
+
+#ifdef _WIN32
+	#include <windows.h>
+	#include <dbghelp.h>
+#else
+	#include <execinfo.h>
+#endif
+
+namespace Memory
+{
+	namespace AllocationSampler
+	{
+		// -------------------------------------------------------------------------
+
+		// Maps a sampled address back to the site it was charged to, so the free can take the bytes off again
+		struct SampledAllocation
+		{
+			std::atomic<void*> mAddress;   // nullptr = never used, kRemovedSample = used before and can be re-used
+			size_t             mWeight;
+			unsigned int       mSiteIndex;
+		};
+
+		static void* const         kRemovedSample = (void*)1;
+
+		// How far along the address table an insert or a lookup will go before giving up
+		constexpr unsigned int     kMaxProbeCount = 64;
+
+		// -------------------------------------------------------------------------
+
+		// Starts at a full interval, rather than 0, so that every thread's first allocation is not sampled
+		thread_local intptr_t      tBytesUntilNextSample = AllocationSampleRate;
+		static thread_local uint64_t tRandomState        = 0;
+		static thread_local bool   tInsideSampler        = false;
+
+		std::atomic<unsigned int>  sLiveSampleCount(0);
+		static std::atomic<size_t> sDroppedSamples(0);
+
+		static AllocationSite      sSites[kMaxAllocationSites];
+		static std::atomic_flag    sSitesLock            = ATOMIC_FLAG_INIT;
+
+		static SampledAllocation   sSampledAllocations[kMaxSampledAllocations];
+
+		// -------------------------------------------------------------------------
+
+		// The gaps between samples are exponentially distributed, so that allocations happening on a fixed pattern cannot all
+		// land between samples and be missed
+		static intptr_t NextSampleInterval()
+		{
+			if (tRandomState == 0)
+				tRandomState = (uint64_t)(uintptr_t)&tRandomState ^ 0x9E3779B97F4A7C15ull;
+
+			// xorshift64
+			tRandomState ^= tRandomState << 13;
+			tRandomState ^= tRandomState >> 7;
+			tRandomState ^= tRandomState << 17;
+
+			// 53 random bits into (0, 1]
+			double uniform = ((double)(tRandomState >> 11) + 1.0) / 9007199254740992.0;
+
+			return (intptr_t)(-log(uniform) * (double)AllocationSampleRate) + 1;
+		}
+
+		// -------------------------------------------------------------------------
+
+		static uint64_t HashStack(void* const* stack, unsigned int depth)
+		{
+			// FNV-1a over the return addresses
+			uint64_t hash = 14695981039346656037ull;
+
+			for (unsigned int i = 0; i < depth; i++)
+			{
+				hash ^= (uint64_t)(uintptr_t)stack[i];
+				hash *= 1099511628211ull;
+			}
+
+			return hash;
+		}
+
+		// -------------------------------------------------------------------------
+
+		static unsigned int HashAddress(const void* memoryPointer)
+		{
+			// Allocations are at least 4 byte aligned, so the bottom bits carry nothing
+			return (unsigned int)((((uint64_t)(uintptr_t)memoryPointer >> 4) * 0x9E3779B97F4A7C15ull) >> 32) % kMaxSampledAllocations;
+		}
+
+		// -------------------------------------------------------------------------
+
+		// Returns the index of the site, or -1 if the table is full
+		static int FindOrAddSite(uint64_t stackHash, void* const* stack, unsigned int depth)
+		{
+			while (sSitesLock.test_and_set(std::memory_order_acquire))
+			{ }
+
+			int          siteIndex = -1;
+			unsigned int start     = (unsigned int)(stackHash % kMaxAllocationSites);
+
+			for (unsigned int probe = 0; probe < kMaxAllocationSites; probe++)
+			{
+				AllocationSite& site = sSites[(start + probe) % kMaxAllocationSites];
+
+				// A depth of 0 marks an unused site
+				if (site.mStackDepth == 0)
+				{
+					site.mStackHash  = stackHash;
+					site.mStackDepth = depth;
+					memcpy(site.mStack, stack, depth * sizeof(void*));
+
+					siteIndex = (int)((start + probe) % kMaxAllocationSites);
+					break;
+				}
+
+				if (site.mStackHash == stackHash && site.mStackDepth == depth && memcmp(site.mStack, stack, depth * sizeof(void*)) == 0)
+				{
+					siteIndex = (int)((start + probe) % kMaxAllocationSites);
+					break;
+				}
+			}
+
+			sSitesLock.clear(std::memory_order_release);
+
+			return siteIndex;
+		}
+
+		// -------------------------------------------------------------------------
+
+		static bool InsertSample(void* memoryPointer, size_t weight, unsigned int siteIndex)
+		{
+			unsigned int start = HashAddress(memoryPointer);
+
+			for (unsigned int probe = 0; probe < kMaxProbeCount; probe++)
+			{
+				SampledAllocation& entry = sSampledAllocations[(start + probe) % kMaxSampledAllocations];
+
+				void* current = entry.mAddress.load(std::memory_order_relaxed);
+
+				if (current != nullptr && current != kRemovedSample)
+					continue;
+
+				if (!entry.mAddress.compare_exchange_strong(current, memoryPointer, std::memory_order_acq_rel))
+					continue;
+
+				// Nobody can free this address until it has been handed back to the caller, so these are safe to fill in after the swap
+				entry.mWeight    = weight;
+				entry.mSiteIndex = siteIndex;
+
+				sLiveSampleCount.fetch_add(1, std::memory_order_relaxed);
+
+				return true;
+			}
+
+			return false;
+		}
+
+		// -------------------------------------------------------------------------
+
+		void SampleAllocation(void* memoryPointer, size_t size)
+		{
+			// Set the next gap first, so that every early out below still leaves the countdown running
+			tBytesUntilNextSample = NextSampleInterval();
+
+			// The sampler's own work is never sampled
+			if (tInsideSampler || !memoryPointer)
+				return;
+
+			tInsideSampler = true;
+
+			// Frame 0 is this function - the new override's frames are kept, as how much of them is inlined depends on the build
+			void*        stack[kMaxSampledStackDepth + 1];
+			unsigned int depth = 0;
+
+#ifdef _WIN32
+			depth = (unsigned int)CaptureStackBackTrace(1, kMaxSampledStackDepth, stack, nullptr);
+#else
+			int captured = backtrace(stack, kMaxSampledStackDepth + 1);
+
+			if (captured > 1)
+			{
+				depth = (unsigned int)captured - 1;
+				memmove(stack, stack + 1, depth * sizeof(void*));
+			}
+#endif
+
+			// Keep a single empty frame rather than a depth of 0, as that marks an unused site
+			if (depth == 0)
+			{
+				stack[0] = nullptr;
+				depth    = 1;
+			}
+
+			// Each sample stands in for the bytes skipped to get to it - large allocations are more likely to be picked, so count for less
+			double sizeAsDouble = (double)size;
+			size_t weight       = (size_t)(sizeAsDouble / (1.0 - exp(-sizeAsDouble / (double)AllocationSampleRate)));
+
+			int siteIndex = FindOrAddSite(HashStack(stack, depth), stack, depth);
+
+			if (siteIndex >= 0)
+			{
+				AllocationSite& site = sSites[siteIndex];
+
+				site.mCumulativeBytes.fetch_add(weight, std::memory_order_relaxed);
+				site.mSampleCount.fetch_add(1, std::memory_order_relaxed);
+
+				// Without a slot for the address the free can not be matched up, so the bytes are only counted as cumulative
+				if (InsertSample(memoryPointer, weight, (unsigned int)siteIndex))
+					site.mLiveBytes.fetch_add(weight, std::memory_order_relaxed);
+				else
+					sDroppedSamples.fetch_add(1, std::memory_order_relaxed);
+			}
+			else
+			{
+				sDroppedSamples.fetch_add(1, std::memory_order_relaxed);
+			}
+
+			tInsideSampler = false;
+		}
+
+		// -------------------------------------------------------------------------
+
+		void RemoveSample(void* memoryPointer)
+		{
+			unsigned int start = HashAddress(memoryPointer);
+
+			for (unsigned int probe = 0; probe < kMaxProbeCount; probe++)
+			{
+				SampledAllocation& entry = sSampledAllocations[(start + probe) % kMaxSampledAllocations];
+
+				void* current = entry.mAddress.load(std::memory_order_acquire);
+
+				// Never used slot - nothing past here can be this address
+				if (current == nullptr)
+					return;
+
+				if (current != memoryPointer)
+					continue;
+
+				size_t       weight    = entry.mWeight;
+				unsigned int siteIndex = entry.mSiteIndex;
+
+				entry.mAddress.store(kRemovedSample, std::memory_order_release);
+
+				sSites[siteIndex].mLiveBytes.fetch_sub(weight, std::memory_order_relaxed);
+				sLiveSampleCount.fetch_sub(1, std::memory_order_relaxed);
+
+				return;
+			}
+		}
+
+		// -------------------------------------------------------------------------
+
+		static void OutputFrame(void* address)
+		{
+#ifdef _WIN32
+			static bool symbolsLoaded = false;
+
+			if (!symbolsLoaded)
+			{
+				SymSetOptions(SYMOPT_UNDNAME | SYMOPT_DEFERRED_LOADS | SYMOPT_LOAD_LINES);
+				SymInitialize(GetCurrentProcess(), nullptr, TRUE);
+
+				symbolsLoaded = true;
+			}
+
+			char         symbolBuffer[sizeof(SYMBOL_INFO) + 256];
+			SYMBOL_INFO* symbol = (SYMBOL_INFO*)symbolBuffer;
+			             symbol->SizeOfStruct = sizeof(SYMBOL_INFO);
+			             symbol->MaxNameLen   = 255;
+
+			DWORD64 displacement = 0;
+
+			if (!SymFromAddr(GetCurrentProcess(), (DWORD64)address, &displacement, symbol))
+			{
+				std::cout << "\t\t" << address << std::endl;
+				return;
+			}
+
+			IMAGEHLP_LINE64 line       = {};
+			                line.SizeOfStruct = sizeof(IMAGEHLP_LINE64);
+			DWORD           lineOffset = 0;
+
+			std::cout << "\t\t" << symbol->Name;
+
+			if (SymGetLineFromAddr64(GetCurrentProcess(), (DWORD64)address, &lineOffset, &line))
+				std::cout << " (" << line.FileName << ":" << line.LineNumber << ")";
+
+			std::cout << std::endl;
+#else
+			// backtrace_symbols mallocs the strings, which is fine as it does not go through new
+			char** symbols = backtrace_symbols(&address, 1);
+
+			if (symbols)
+			{
+				std::cout << "\t\t" << symbols[0] << std::endl;
+				free(symbols);
+			}
+			else
+			{
+				std::cout << "\t\t" << address << std::endl;
+			}
+#endif
+		}
+
+		// -------------------------------------------------------------------------
+
+		void OutputReport(unsigned int siteCount)
+		{
+			tInsideSampler = true;
+
+			static unsigned int siteIndices[kMaxAllocationSites];
+			unsigned int        sitesUsed = 0;
+
+			for (unsigned int i = 0; i < kMaxAllocationSites; i++)
+			{
+				if (sSites[i].mStackDepth > 0)
+					siteIndices[sitesUsed++] = i;
+			}
+
+			std::sort(siteIndices, siteIndices + sitesUsed, [](unsigned int a, unsigned int b)
+			{
+				return sSites[a].mCumulativeBytes.load(std::memory_order_relaxed) > sSites[b].mCumulativeBytes.load(std::memory_order_relaxed);
+			});
+
+			std::cout << "Allocation sites - sampling 1 in " << AllocationSampleRate << " bytes, " << sitesUsed << " sites, ";
+			std::cout << sLiveSampleCount.load(std::memory_order_relaxed) << " live samples, " << sDroppedSamples.load(std::memory_order_relaxed) << " dropped" << std::endl;
+
+			for (unsigned int i = 0; i < sitesUsed && i < siteCount; i++)
+			{
+				const AllocationSite& site = sSites[siteIndices[i]];
+
+				std::cout << "Cumulative:\t" << site.mCumulativeBytes.load(std::memory_order_relaxed);
+				std::cout << "\tLive:\t"     << site.mLiveBytes.load(std::memory_order_relaxed);
+				std::cout << "\tSamples:\t"  << site.mSampleCount.load(std::memory_order_relaxed) << std::endl;
+
+				for (unsigned int frame = 0; frame < site.mStackDepth; frame++)
+					OutputFrame(site.mStack[frame]);
+			}
+
+			std::cout << std::endl;
+
+			tInsideSampler = false;
+		}
+
+		// -------------------------------------------------------------------------
+	}
+}
\ No newline at end of file
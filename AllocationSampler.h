@@ -0,0 +1,68 @@
+#pragma once
+
+#include "Commons.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+
+namespace Memory
+{
+	// ----------------------------------------------------------
+
+	constexpr unsigned int kMaxSampledStackDepth   = 24;
+	constexpr unsigned int kMaxAllocationSites     = 4096;
+	constexpr unsigned int kMaxSampledAllocations  = 64 * 1024;
+
+	// ----------------------------------------------------------
+
+	// One call stack that has had at least one of its allocations sampled - the byte counts are estimates of the
+	// real totals, as each sample stands in for all of the unsampled bytes allocated around it
+	struct AllocationSite
+	{
+		uint64_t            mStackHash;
+		unsigned int        mStackDepth;
+		void*               mStack[kMaxSampledStackDepth];
+
+		std::atomic<size_t> mLiveBytes;
+		std::atomic<size_t> mCumulativeBytes;
+		std::atomic<size_t> mSampleCount;
+	};
+
+	// ----------------------------------------------------------
+
+	// Samples roughly one allocation per AllocationSampleRate bytes, records its call stack and keeps per-site byte counts.
+	// Everything the sampler stores lives in fixed tables, so it never calls back into the new override
+	namespace AllocationSampler
+	{
+		// Bytes left before this thread takes its next sample - the only thing touched on an unsampled allocation
+		extern thread_local intptr_t       tBytesUntilNextSample;
+		extern std::atomic<unsigned int>   sLiveSampleCount;
+
+		void SampleAllocation(void* memoryPointer, size_t size);
+		void RemoveSample(void* memoryPointer);
+
+		inline void RecordAllocation(void* memoryPointer, size_t size)
+		{
+			tBytesUntilNextSample -= (intptr_t)size;
+
+			if (tBytesUntilNextSample <= 0)
+				SampleAllocation(memoryPointer, size);
+		}
+
+		// Must be called before the memory is given back, otherwise another thread could be handed the same address first
+		inline void RecordFree(void* memoryPointer)
+		{
+			if (sLiveSampleCount.load(std::memory_order_relaxed) == 0)
+				return;
+
+			RemoveSample(memoryPointer);
+		}
+
+		// Sites sorted by cumulative bytes, with their stacks resolved to symbols where possible
+		void OutputReport(unsigned int siteCount = 20);
+	}
+
+	// ----------------------------------------------------------
+}
\ No newline at end of file
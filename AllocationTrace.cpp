@@ -0,0 +1,159 @@
+#include "AllocationTrace.h"
+
+#include <chrono>
+#include <mutex>
+
+#include <malloc.h>
+#include <stdio.h>
+
+namespace Memory
+{
+	namespace AllocationTrace
+	{
+		// -------------------------------------------------------------------------
+
+		struct TraceBuffer
+		{
+			TraceRecord  mRecords[kTraceRecordsPerBuffer];
+			unsigned int mCount;
+			uint16_t     mThread;
+		};
+
+		// -------------------------------------------------------------------------
+
+		std::atomic<bool>                            sRecording(false);
+
+		static FILE*                                 sTraceFile = nullptr;
+		static std::mutex                            sTraceFileMutex;
+		static std::chrono::steady_clock::time_point sTraceStart;
+
+		// Kept so that Stop can flush the threads' partly filled buffers
+		static TraceBuffer*                          sBuffers[kMaxTraceThreads] = { nullptr };
+		static std::atomic<unsigned int>             sBuffersUsed(0);
+
+		static thread_local TraceBuffer*             tBuffer = nullptr;
+
+		// -------------------------------------------------------------------------
+
+		static void FlushBuffer(TraceBuffer* buffer)
+		{
+			if (buffer->mCount == 0)
+				return;
+
+			std::lock_guard<std::mutex> lock(sTraceFileMutex);
+
+			if (sTraceFile)
+				fwrite(buffer->mRecords, sizeof(TraceRecord), buffer->mCount, sTraceFile);
+
+			buffer->mCount = 0;
+		}
+
+		// -------------------------------------------------------------------------
+
+		static TraceBuffer* GetBufferForThisThread()
+		{
+			if (tBuffer)
+				return tBuffer;
+
+			unsigned int bufferIndex = sBuffersUsed.fetch_add(1, std::memory_order_relaxed);
+
+			// Threads past the limit are not recorded, rather than sharing a buffer and needing a lock per record
+			if (bufferIndex >= kMaxTraceThreads)
+				return nullptr;
+
+			// malloc rather than new, so that setting up the trace does not show up in it
+			TraceBuffer* buffer = (TraceBuffer*)malloc(sizeof(TraceBuffer));
+
+			if (!buffer)
+				return nullptr;
+
+			buffer->mCount  = 0;
+			buffer->mThread = (uint16_t)bufferIndex;
+
+			sBuffers[bufferIndex] = buffer;
+			tBuffer               = buffer;
+
+			return buffer;
+		}
+
+		// -------------------------------------------------------------------------
+
+		bool Start(const char* path)
+		{
+			if (sRecording.load())
+				return false;
+
+			sTraceFile = fopen(path, "wb");
+
+			if (!sTraceFile)
+				return false;
+
+			TraceFileHeader header = { kTraceFileMagic, kTraceFileVersion, (uint32_t)sizeof(TraceRecord), 0 };
+			fwrite(&header, sizeof(header), 1, sTraceFile);
+
+			sTraceStart = std::chrono::steady_clock::now();
+
+			sRecording.store(true);
+
+			return true;
+		}
+
+		// -------------------------------------------------------------------------
+
+		void Stop()
+		{
+			if (!sRecording.exchange(false))
+				return;
+
+			unsigned int buffersUsed = sBuffersUsed.load();
+
+			if (buffersUsed > kMaxTraceThreads)
+				buffersUsed = kMaxTraceThreads;
+
+			for (unsigned int i = 0; i < buffersUsed; i++)
+			{
+				if (sBuffers[i])
+					FlushBuffer(sBuffers[i]);
+			}
+
+			std::lock_guard<std::mutex> lock(sTraceFileMutex);
+
+			fclose(sTraceFile);
+			sTraceFile = nullptr;
+		}
+
+		// -------------------------------------------------------------------------
+
+		void Record(TraceOperation operation, void* memoryPointer, size_t size, size_t alignment, bool forArray)
+		{
+			TraceBuffer* buffer = GetBufferForThisThread();
+
+			if (!buffer)
+				return;
+
+			uint8_t alignmentLog2 = 0;
+
+			while (alignment > 1)
+			{
+				alignment >>= 1;
+				alignmentLog2++;
+			}
+
+			TraceRecord& record   = buffer->mRecords[buffer->mCount];
+			record.mTimestamp     = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - sTraceStart).count();
+			record.mAddress       = (uint64_t)(uintptr_t)memoryPointer;
+			record.mSize          = (uint32_t)size;
+			record.mThread        = buffer->mThread;
+			record.mOperation     = operation;
+			record.mAlignmentLog2 = alignmentLog2;
+			record.mFlags         = forArray ? kTraceFlagArray : 0;
+
+			buffer->mCount++;
+
+			if (buffer->mCount == kTraceRecordsPerBuffer)
+				FlushBuffer(buffer);
+		}
+
+		// -------------------------------------------------------------------------
+	}
+}
\ No newline at end of file
@@ -0,0 +1,85 @@
+#pragma once
+
+#include "Commons.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+
+namespace Memory
+{
+	// ----------------------------------------------------------
+
+	enum class TraceOperation : uint8_t
+	{
+		Allocate,
+		Free
+	};
+
+	enum TraceFlags : uint8_t
+	{
+		kTraceFlagArray = 1 << 0
+	};
+
+	// One allocation or free as seen by the new/delete overrides - the raw address is stored, and turned into an id
+	// when the trace is loaded, so that nothing has to be looked up while recording
+#pragma pack(push, 1)
+	struct TraceRecord
+	{
+		uint64_t       mTimestamp;      // Nanoseconds since the trace was started
+		uint64_t       mAddress;
+		uint32_t       mSize;           // What the caller asked for
+		uint16_t       mThread;         // Small index, in the order threads first allocated while recording
+		TraceOperation mOperation;
+		uint8_t        mAlignmentLog2;  // 0 for the default alignment
+		uint8_t        mFlags;
+	};
+#pragma pack(pop)
+
+	// Written once at the start of the file
+	struct TraceFileHeader
+	{
+		uint32_t mMagic;
+		uint32_t mVersion;
+		uint32_t mRecordSize;
+		uint32_t mPadding;
+	};
+
+	constexpr uint32_t     kTraceFileMagic         = 0x43525441; // "ATRC"
+	constexpr uint32_t     kTraceFileVersion       = 1;
+
+	// Each thread fills its own buffer and only takes the file lock when it is full
+	constexpr unsigned int kTraceRecordsPerBuffer  = 16 * 1024;
+	constexpr unsigned int kMaxTraceThreads        = 64;
+
+	// ----------------------------------------------------------
+
+	// Records every allocation and free that goes through the overrides to a compact binary file, for TraceReplay to play back
+	namespace AllocationTrace
+	{
+		extern std::atomic<bool> sRecording;
+
+		bool Start(const char* path);
+
+		// Writes out what every thread still has buffered - threads must have stopped allocating by now
+		void Stop();
+
+		void Record(TraceOperation operation, void* memoryPointer, size_t size, size_t alignment, bool forArray);
+
+		inline void RecordAllocation(void* memoryPointer, size_t size, size_t alignment, bool forArray)
+		{
+			if (sRecording.load(std::memory_order_relaxed))
+				Record(TraceOperation::Allocate, memoryPointer, size, alignment, forArray);
+		}
+
+		// Must be recorded before the memory is given back, so that the address cannot show up in another allocation first
+		inline void RecordFree(void* memoryPointer, size_t size, size_t alignment, bool forArray)
+		{
+			if (sRecording.load(std::memory_order_relaxed))
+				Record(TraceOperation::Free, memoryPointer, size, alignment, forArray);
+		}
+	}
+
+	// ----------------------------------------------------------
+}
\ No newline at end of file
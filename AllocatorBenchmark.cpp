@@ -0,0 +1,541 @@
+#include "AllocatorBenchmark.h"
+
+#include "Commons.h"
+#include "MemoryPool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+	#include <windows.h>
+	#include <psapi.h>
+#endif
+
+namespace Benchmarks
+{
+	// -------------------------------------------------------------------------
+
+	constexpr unsigned int kAllocatorBenchmarkThreadCounts[] = { 1, 2, 4, 8, 16 };
+	constexpr unsigned int kMaxAllocatorBenchmarkThreads     = 16;
+
+	// Roughly how many allocations plus frees each thread does per pattern
+	constexpr unsigned int kOperationsPerThread              = 200000;
+
+	// Cross thread pattern - each thread allocates a batch, then frees the batch the thread before it allocated
+	constexpr unsigned int kCrossThreadBatchSize             = 512;
+
+	// Array pattern - how many arrays each thread keeps alive at once
+	constexpr unsigned int kLiveArraysPerThread              = 64;
+
+	// -------------------------------------------------------------------------
+
+	struct AllocatorUnderTest
+	{
+		const char* mName;
+		void*     (*mAllocate)(size_t size, bool forArray);
+		void      (*mFree)(void* memory, size_t size, bool forArray);
+	};
+
+	// -------------------------------------------------------------------------
+
+	// Straight into the pool, taking its mutex the same way the override does
+	static void* PoolAllocate(size_t size, bool forArray)
+	{
+		Memory::MemoryPool*       pool  = Memory::MemoryPool::Get();
+		Profiling::ProfiledMutex* mutex = pool->GetMutex();
+
+		if (mutex)
+			mutex->lock();
+
+		void* memory = pool->AssignMemory(size, forArray);
+
+		if (mutex)
+			mutex->unlock();
+
+		return memory;
+	}
+
+	static void PoolFree(void* memory, size_t size, bool forArray)
+	{
+		Memory::MemoryPool*       pool  = Memory::MemoryPool::Get();
+		Profiling::ProfiledMutex* mutex = pool->GetMutex();
+
+		if (mutex)
+			mutex->lock();
+
+		pool->FreeMemory(forArray ? 0 : size, memory, forArray);
+
+		if (mutex)
+			mutex->unlock();
+	}
+
+	// -------------------------------------------------------------------------
+
+	// Whatever new/delete currently are - the pool through the override when MemoryOverride is on, otherwise the system's
+	static void* OverrideAllocate(size_t size, bool forArray)
+	{
+		if (forArray)
+			return ::operator new[](size);
+
+		return ::operator new(size);
+	}
+
+	static void OverrideFree(void* memory, size_t size, bool forArray)
+	{
+		if (forArray)
+			::operator delete[](memory);
+		else
+			::operator delete(memory, size);
+	}
+
+	// -------------------------------------------------------------------------
+
+	static void* MallocAllocate(size_t size, bool)
+	{
+		return malloc(size);
+	}
+
+	static void MallocFree(void* memory, size_t, bool)
+	{
+		free(memory);
+	}
+
+	// -------------------------------------------------------------------------
+
+	enum class AllocationPattern
+	{
+		VectorRegrowth,   // A list growing 16 -> 4096 bytes by doubling, copying across each time - what the leaves' lists do
+		CrossThreadFrees, // Allocated on one thread and freed on another, as happens when cubes move between leaves
+		ArrayNewDelete    // Short lived arrays of mixed sizes
+	};
+
+	static const char* GetPatternName(AllocationPattern pattern)
+	{
+		switch (pattern)
+		{
+		case AllocationPattern::VectorRegrowth:   return "Vector regrowth";
+		case AllocationPattern::CrossThreadFrees: return "Cross thread frees";
+		case AllocationPattern::ArrayNewDelete:   return "Array new/delete";
+		}
+
+		return "";
+	}
+
+	// -------------------------------------------------------------------------
+
+	// Every thread spins until they have all arrived - used to keep the cross thread batches in step
+	class SpinBarrier
+	{
+	public:
+		explicit SpinBarrier(unsigned int threadCount)
+			: mThreadCount(threadCount)
+			, mArrived(0)
+			, mGeneration(0)
+		{ }
+
+		void Wait()
+		{
+			unsigned int generation = mGeneration.load(std::memory_order_acquire);
+
+			if (mArrived.fetch_add(1, std::memory_order_acq_rel) + 1 == mThreadCount)
+			{
+				mArrived.store(0, std::memory_order_relaxed);
+				mGeneration.fetch_add(1, std::memory_order_release);
+
+				return;
+			}
+
+			while (mGeneration.load(std::memory_order_acquire) == generation)
+				std::this_thread::yield();
+		}
+
+	private:
+		unsigned int              mThreadCount;
+		std::atomic<unsigned int> mArrived;
+		std::atomic<unsigned int> mGeneration;
+	};
+
+	// -------------------------------------------------------------------------
+
+	// Each thread's state for one run - the buffers are malloc'd up front so none of the bookkeeping lands in the allocator being measured
+	struct BenchmarkThreadState
+	{
+		uint64_t  mRandomState;
+
+		uint32_t* mLatencies;        // Nanoseconds per operation, only filled on the latency pass
+		size_t    mLatencyCount;
+		size_t    mLatencyCapacity;
+
+		size_t    mOperations;
+
+		void**    mBatch;            // Cross thread pattern - what this thread allocated for its neighbour to free
+		size_t*   mBatchSizes;
+	};
+
+	// -------------------------------------------------------------------------
+
+	static inline uint32_t NextRandom(BenchmarkThreadState& state)
+	{
+		// xorshift64
+		state.mRandomState ^= state.mRandomState << 13;
+		state.mRandomState ^= state.mRandomState >> 7;
+		state.mRandomState ^= state.mRandomState << 17;
+
+		return (uint32_t)(state.mRandomState >> 32);
+	}
+
+	// -------------------------------------------------------------------------
+
+	template<bool kRecordLatency>
+	static inline void* TimedAllocate(const AllocatorUnderTest& allocator, BenchmarkThreadState& state, size_t size, bool forArray)
+	{
+		state.mOperations++;
+
+		if (!kRecordLatency)
+			return allocator.mAllocate(size, forArray);
+
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+		void* memory = allocator.mAllocate(size, forArray);
+
+		std::chrono::nanoseconds taken = std::chrono::steady_clock::now() - start;
+
+		if (state.mLatencyCount < state.mLatencyCapacity)
+			state.mLatencies[state.mLatencyCount++] = (uint32_t)taken.count();
+
+		return memory;
+	}
+
+	template<bool kRecordLatency>
+	static inline void TimedFree(const AllocatorUnderTest& allocator, BenchmarkThreadState& state, void* memory, size_t size, bool forArray)
+	{
+		state.mOperations++;
+
+		if (!kRecordLatency)
+		{
+			allocator.mFree(memory, size, forArray);
+			return;
+		}
+
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+		allocator.mFree(memory, size, forArray);
+
+		std::chrono::nanoseconds taken = std::chrono::steady_clock::now() - start;
+
+		if (state.mLatencyCount < state.mLatencyCapacity)
+			state.mLatencies[state.mLatencyCount++] = (uint32_t)taken.count();
+	}
+
+	// -------------------------------------------------------------------------
+
+	template<bool kRecordLatency>
+	static void RunPatternOnThread(AllocationPattern pattern, const AllocatorUnderTest& allocator, unsigned int threadIndex, unsigned int threadCount, 
+		                           BenchmarkThreadState* states, SpinBarrier& barrier)
+	{
+		BenchmarkThreadState& state = states[threadIndex];
+
+		switch (pattern)
+		{
+		case AllocationPattern::VectorRegrowth:
+		{
+			// 9 allocations and 9 frees per list
+			unsigned int listCount = kOperationsPerThread / 18;
+
+			for (unsigned int list = 0; list < listCount; list++)
+			{
+				size_t capacity = 16;
+				char*  data     = (char*)TimedAllocate<kRecordLatency>(allocator, state, capacity, false);
+				memset(data, 0, capacity);
+
+				while (capacity < 4096)
+				{
+					char* grown = (char*)TimedAllocate<kRecordLatency>(allocator, state, capacity * 2, false);
+
+					memcpy(grown, data, capacity);
+					memset(grown + capacity, 0, capacity);
+
+					TimedFree<kRecordLatency>(allocator, state, data, capacity, false);
+
+					data      = grown;
+					capacity *= 2;
+				}
+
+				TimedFree<kRecordLatency>(allocator, state, data, capacity, false);
+			}
+
+			break;
+		}
+
+		case AllocationPattern::CrossThreadFrees:
+		{
+			unsigned int          rounds    = kOperationsPerThread / (2 * kCrossThreadBatchSize);
+			BenchmarkThreadState& neighbour = states[(threadIndex + threadCount - 1) % threadCount];
+
+			for (unsigned int round = 0; round < rounds; round++)
+			{
+				for (unsigned int i = 0; i < kCrossThreadBatchSize; i++)
+				{
+					size_t size = 16 + (NextRandom(state) % 241);
+
+					state.mBatch[i]      = TimedAllocate<kRecordLatency>(allocator, state, size, false);
+					state.mBatchSizes[i] = size;
+
+					memset(state.mBatch[i], 0, size);
+				}
+
+				barrier.Wait();
+
+				for (unsigned int i = 0; i < kCrossThreadBatchSize; i++)
+					TimedFree<kRecordLatency>(allocator, state, neighbour.mBatch[i], neighbour.mBatchSizes[i], false);
+
+				// Nobody can start refilling their batch until their neighbour has finished emptying it
+				barrier.Wait();
+			}
+
+			break;
+		}
+
+		case AllocationPattern::ArrayNewDelete:
+		{
+			void*  arrays[kLiveArraysPerThread];
+			size_t sizes[kLiveArraysPerThread];
+
+			for (unsigned int i = 0; i < kLiveArraysPerThread; i++)
+			{
+				sizes[i]  = 8 + (NextRandom(state) % 505);
+				arrays[i] = TimedAllocate<kRecordLatency>(allocator, state, sizes[i], true);
+			}
+
+			unsigned int replacements = (kOperationsPerThread - (2 * kLiveArraysPerThread)) / 2;
+
+			for (unsigned int i = 0; i < replacements; i++)
+			{
+				unsigned int slot = NextRandom(state) % kLiveArraysPerThread;
+
+				TimedFree<kRecordLatency>(allocator, state, arrays[slot], sizes[slot], true);
+
+				sizes[slot]  = 8 + (NextRandom(state) % 505);
+				arrays[slot] = TimedAllocate<kRecordLatency>(allocator, state, sizes[slot], true);
+
+				memset(arrays[slot], 0, sizes[slot]);
+			}
+
+			for (unsigned int i = 0; i < kLiveArraysPerThread; i++)
+				TimedFree<kRecordLatency>(allocator, state, arrays[i], sizes[i], true);
+
+			break;
+		}
+		}
+	}
+
+	// -------------------------------------------------------------------------
+
+	// Returns the wall clock time of the run in seconds
+	template<bool kRecordLatency>
+	static double RunPattern(AllocationPattern pattern, const AllocatorUnderTest& allocator, unsigned int threadCount, BenchmarkThreadState* states)
+	{
+		SpinBarrier              barrier(threadCount);
+		std::atomic<bool>        go(false);
+		std::vector<std::thread> threads;
+
+		threads.reserve(threadCount);
+
+		for (unsigned int i = 0; i < threadCount; i++)
+		{
+			states[i].mOperations   = 0;
+			states[i].mLatencyCount = 0;
+
+			threads.emplace_back([&, i]()
+			{
+				while (!go.load(std::memory_order_acquire))
+					std::this_thread::yield();
+
+				RunPatternOnThread<kRecordLatency>(pattern, allocator, i, threadCount, states, barrier);
+			});
+		}
+
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+		go.store(true, std::memory_order_release);
+
+		for (std::thread& thread : threads)
+			thread.join();
+
+		std::chrono::duration<double> taken = std::chrono::steady_clock::now() - start;
+
+		return taken.count();
+	}
+
+	// -------------------------------------------------------------------------
+
+	// Resident memory in bytes - either now, or the high water mark since ResetPeakResidentBytes
+	static size_t GetResidentBytes(bool peak)
+	{
+#ifdef _WIN32
+		PROCESS_MEMORY_COUNTERS counters = {};
+
+		if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+			return 0;
+
+		return peak ? counters.PeakWorkingSetSize : counters.WorkingSetSize;
+#else
+		FILE* file = fopen("/proc/self/status", "r");
+
+		if (!file)
+			return 0;
+
+		const char* format    = peak ? "VmHWM: %zu kB" : "VmRSS: %zu kB";
+		char        line[256];
+		size_t      kilobytes = 0;
+
+		while (fgets(line, sizeof(line), file))
+		{
+			if (sscanf(line, format, &kilobytes) == 1)
+				break;
+		}
+
+		fclose(file);
+
+		return kilobytes * 1024;
+#endif
+	}
+
+	// -------------------------------------------------------------------------
+
+	// Brings the high water mark down to what is resident now. Windows has no way of doing this, so there a row only shows
+	// its own peak if it goes higher than every row before it did
+	static void ResetPeakResidentBytes()
+	{
+#ifndef _WIN32
+		FILE* file = fopen("/proc/self/clear_refs", "w");
+
+		if (!file)
+			return;
+
+		fputs("5", file);
+		fclose(file);
+#endif
+	}
+
+	// -------------------------------------------------------------------------
+
+	void CompareAllocators()
+	{
+		std::vector<AllocatorUnderTest> allocators;
+
+#if UseMemoryPools
+		allocators.push_back({ "MemoryPool", &PoolAllocate, &PoolFree });
+#endif
+
+#if MemoryOverride
+		allocators.push_back({ "new override", &OverrideAllocate, &OverrideFree });
+#else
+		allocators.push_back({ "new (system)", &OverrideAllocate, &OverrideFree });
+#endif
+
+		allocators.push_back({ "malloc", &MallocAllocate, &MallocFree });
+
+		// All of the per-thread buffers are from malloc, and made before anything is timed
+		BenchmarkThreadState* states = (BenchmarkThreadState*)malloc(sizeof(BenchmarkThreadState) * kMaxAllocatorBenchmarkThreads);
+
+		if (!states)
+			return;
+
+		for (unsigned int i = 0; i < kMaxAllocatorBenchmarkThreads; i++)
+		{
+			BenchmarkThreadState& state = states[i];
+
+			state.mRandomState     = 0x9E3779B97F4A7C15ull * (i + 1);
+			state.mLatencyCapacity = kOperationsPerThread + 1024;
+			state.mLatencies       = (uint32_t*)malloc(sizeof(uint32_t) * state.mLatencyCapacity);
+			state.mLatencyCount    = 0;
+			state.mOperations      = 0;
+			state.mBatch           = (void**)malloc(sizeof(void*) * kCrossThreadBatchSize);
+			state.mBatchSizes      = (size_t*)malloc(sizeof(size_t) * kCrossThreadBatchSize);
+		}
+
+		uint32_t* mergedLatencies = (uint32_t*)malloc(sizeof(uint32_t) * states[0].mLatencyCapacity * kMaxAllocatorBenchmarkThreads);
+
+		std::cout << "Allocator benchmark - " << kOperationsPerThread << " operations per thread per pattern" << std::endl;
+		std::cout << std::left << std::setw(20) << "Pattern" << std::setw(16) << "Allocator" << std::setw(10) << "Threads";
+		std::cout << std::setw(12) << "ns/op" << std::setw(12) << "p99 ns" << "Peak RSS growth (MB)" << std::endl;
+
+		const AllocationPattern patterns[] = { AllocationPattern::VectorRegrowth, AllocationPattern::CrossThreadFrees, AllocationPattern::ArrayNewDelete };
+
+		for (AllocationPattern pattern : patterns)
+		{
+			for (const AllocatorUnderTest& allocator : allocators)
+			{
+				for (unsigned int threadCount : kAllocatorBenchmarkThreadCounts)
+				{
+					// Measured from where this row starts - the pool never hands its pages back, so the peak on its own would carry
+					// every earlier row's footprint along with it
+					ResetPeakResidentBytes();
+
+					size_t startResidentBytes = GetResidentBytes(false);
+
+					// Throughput without any timing inside the loop, then again timing every operation for the tail
+					double seconds = RunPattern<false>(pattern, allocator, threadCount, states);
+
+					size_t operations = 0;
+
+					for (unsigned int i = 0; i < threadCount; i++)
+						operations += states[i].mOperations;
+
+					RunPattern<true>(pattern, allocator, threadCount, states);
+
+					size_t peakResidentBytes = GetResidentBytes(true);
+					size_t peakGrowthBytes   = peakResidentBytes > startResidentBytes ? peakResidentBytes - startResidentBytes : 0;
+
+					size_t latencyCount = 0;
+
+					for (unsigned int i = 0; i < threadCount; i++)
+					{
+						memcpy(mergedLatencies + latencyCount, states[i].mLatencies, sizeof(uint32_t) * states[i].mLatencyCount);
+						latencyCount += states[i].mLatencyCount;
+					}
+
+					uint32_t p99 = 0;
+
+					if (latencyCount > 0)
+					{
+						size_t p99Index = (latencyCount * 99) / 100;
+
+						std::nth_element(mergedLatencies, mergedLatencies + p99Index, mergedLatencies + latencyCount);
+						p99 = mergedLatencies[p99Index];
+					}
+
+					// Wall clock time against every thread's operations, so this is the cost seen by the program as a whole
+					double nanosecondsPerOperation = operations > 0 ? (seconds * 1e9) / (double)operations : 0.0;
+
+					std::cout << std::left << std::setw(20) << GetPatternName(pattern) << std::setw(16) << allocator.mName << std::setw(10) << threadCount;
+					std::cout << std::setw(12) << std::fixed << std::setprecision(1) << nanosecondsPerOperation << std::setw(12) << p99;
+					std::cout << std::setprecision(1) << (double)peakGrowthBytes / (1024.0 * 1024.0) << std::endl;
+				}
+			}
+		}
+
+		for (unsigned int i = 0; i < kMaxAllocatorBenchmarkThreads; i++)
+		{
+			free(states[i].mLatencies);
+			free(states[i].mBatch);
+			free(states[i].mBatchSizes);
+		}
+
+		free(mergedLatencies);
+		free(states);
+	}
+
+	// -------------------------------------------------------------------------
+}
\ No newline at end of file
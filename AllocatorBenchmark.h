@@ -0,0 +1,8 @@
+#pragma once
+
+namespace Benchmarks
+{
+	// Times the memory pool, the new/delete override and plain malloc/free on the allocation patterns the simulation produces,
+	// at 1 to 16 threads - prints ns per operation, p99 latency and peak RSS for each
+	void CompareAllocators();
+}
\ No newline at end of file
@@ -2,97 +2,171 @@
 
 #include "GlobalTrackers.h"
 #include <iostream>
+#include <chrono>
+#include <cstddef>
+
+#include <stdio.h>
+#include <string.h>
 
 #if MemoryOverride
 
 #include <malloc.h>
+#include <stddef.h>
 #include <mutex>
 
 #include "MemoryPool.h"
 
+#if UseAllocationSampling
+	#include "AllocationSampler.h"
+#endif
+
+#if CaptureAllocationTrace
+	#include "AllocationTrace.h"
+#endif
+
+#if UseMemoryTags
+	#include "MemoryTags.h"
+#endif
+
+#if CountFrameAllocations
+	#include "AllocationCounter.h"
+#endif
+
 // ------------------------------------------------------------------------------------------------------ 
 // ------------------------------------------------------------------------------------------------------ 
 // ------------------------------------------------------------------------------------------------------ 
 
-// Global override of new - is called whenever something calls new and doesn't have its own new override
-void* operator new(size_t size) 
+// The header has to take up a whole number of alignment steps so that the pointer after it is still aligned
+static inline size_t GetTrackingHeaderSize(size_t alignment)
 {
-	std::mutex* mutex = Memory::MemoryPool::Get()->GetMutex();
+	if (alignment > 0)
+		return (sizeof(Header) + alignment - 1) & ~(alignment - 1);
 
-	if(mutex)
-		mutex->lock();
+	return sizeof(Header);
+}
 
-	unsigned int originalDataSize = size;
+// ------------------------------------------------------------------------------------------------------ 
 
-#if UseMemoryTracking
-	// Add the size of the header and the footer to the amount of bytes to allocate
-	size += sizeof(Header) + sizeof(Footer);
-#endif
+#if UseMemoryTags
+// Sits at the very start of each allocation, in front of any tracking header, so that the free knows who to take the bytes off
+struct TagPrefix
+{
+	unsigned int      mBytesInMemory; // Everything given to the allocator, prefix included
+	unsigned int      mDataBytes;     // What the caller asked for - this is what is charged to the tag
+	Memory::MemoryTag mTag;
+};
 
-	// Now allocate the memory
-#if UseMemoryPools
-	void* newMemory = Memory::MemoryPool::Get()->AssignMemory(size, false);
-#else
-	void* newMemory = malloc(size);
-#endif
+// A whole number of alignment steps, so that the pointer after it is as aligned as what the allocator gave back
+static inline size_t GetTagPrefixSize(size_t alignment)
+{
+	if (alignment == 0)
+		alignment = alignof(std::max_align_t);
 
+	return (sizeof(TagPrefix) + alignment - 1) & ~(alignment - 1);
+}
+#endif
 
-	if (!newMemory)
-	{
-		if (mutex)
-			mutex->unlock();
+// ------------------------------------------------------------------------------------------------------ 
 
-		return nullptr;
-	}
-	
-#if UseMemoryTracking
-	// Setup the header
-	Header* header = (Header*)newMemory; 
-			*header = Header(size, nullptr, nullptr);
+// Hands memory back to wherever it came from - startOfMemory is what the pool or malloc gave out, before any header
+static void ReleaseMemory(void* startOfMemory, size_t size, bool forArray, size_t alignment)
+{
+#if UseMemoryTags
+	// The prefix knows the full size, which neither the caller nor the tracking header include it in
+	TagPrefix* prefix = (TagPrefix*)((char*)startOfMemory - GetTagPrefixSize(alignment));
 
-	// Now setup the footer
-	Footer* footer = (Footer*)((char*)newMemory + sizeof(Header) + originalDataSize);
-			*footer = Footer();
+	Memory::MemoryTags::RemoveTaggedBytes(prefix->mTag, prefix->mDataBytes);
 
-	// Now add the memory for this call to the global generic tracker
-	if(Memory::mGenericTracker != nullptr)
-	{
-		Memory::mGenericTracker->AddMemoryAllocated(header);
-	}
+	startOfMemory = prefix;
+	size          = prefix->mBytesInMemory;
 #endif
 
+	Profiling::ProfiledMutex* mutex = Memory::MemoryPool::Get()->GetMutex();
+
 	if (mutex)
-		mutex->unlock();
+		mutex->lock();
 
-#if UseMemoryTracking
-	// Now return back the memory address to the caller so that they can use it as before
-	return (void*)((char*)newMemory + sizeof(Header));
+#if UseMemoryPools
+	if (alignment > 0)
+		Memory::MemoryPool::Get()->FreeAlignedMemory(startOfMemory);
+	else
+		Memory::MemoryPool::Get()->FreeMemory(size, startOfMemory, forArray);
 #else
-	return (void*)newMemory;
+	// Free the memory now we are in the right place
+	#ifdef _WIN32
+		if (alignment > 0)
+			_aligned_free(startOfMemory);
+		else
+			free(startOfMemory);
+	#else
+		free(startOfMemory);
+	#endif
 #endif
+
+	if (mutex)
+		mutex->unlock();
 }
 
 // ------------------------------------------------------------------------------------------------------ 
 
-void* operator new[](size_t size)
+// Used by the tracker once a header has been taken out of its segment
+void ReleaseTrackedAllocation(Header* header)
+{
+	size_t alignment     = header->mAlignment;
+	void*  startOfMemory = (void*)((char*)(header + 1) - GetTrackingHeaderSize(alignment));
+
+	ReleaseMemory(startOfMemory, header->mBytesInMemory, header->mForArray, alignment);
+}
+
+// ------------------------------------------------------------------------------------------------------ 
+
+// Shared by all of the new overrides - alignment of 0 means the default architecture alignment
+static void* AllocateThroughOverride(size_t size, bool forArray, size_t alignment)
 {
-	std::mutex* mutex = Memory::MemoryPool::Get()->GetMutex();
+#if CountFrameAllocations
+	// Before the lock, so that asserting on it does not leave the pool locked
+	Memory::AllocationCounter::RecordAllocation(size);
+#endif
+
+	Profiling::ProfiledMutex* mutex = Memory::MemoryPool::Get()->GetMutex();
 
 	if (mutex)
 		mutex->lock();
 
 	unsigned int originalDataSize = size;
 
+#if UseMemoryTags
+	size_t tagPrefixSize = GetTagPrefixSize(alignment);
+
+	size += tagPrefixSize;
+#endif
+
 #if UseMemoryTracking
+	size_t headerSize = GetTrackingHeaderSize(alignment);
+
 	// Add the size of the header and the footer to the amount of bytes to allocate
-	size += sizeof(Header) + sizeof(Footer);
+	size += headerSize + sizeof(Footer);
 #endif
 
 	// Now allocate the memory
 #if UseMemoryPools
-	void* newMemory = Memory::MemoryPool::Get()->AssignMemory(size, true);
+	void* newMemory = nullptr;
+
+	if (alignment > 0)
+		newMemory = Memory::MemoryPool::Get()->AssignAlignedMemory(size, alignment);
+	else
+		newMemory = Memory::MemoryPool::Get()->AssignMemory(size, forArray);
 #else
-	void* newMemory = malloc(size);
+	void* newMemory = nullptr;
+
+	if (alignment > 0)
+	#ifdef _WIN32
+		newMemory = _aligned_malloc(size, alignment);
+	#else
+		newMemory = aligned_alloc(alignment, (size + alignment - 1) & ~(alignment - 1));
+	#endif
+	else
+		newMemory = malloc(size);
 #endif
 
 	if (!newMemory)
@@ -102,176 +176,285 @@ void* operator new[](size_t size)
 
 		return nullptr;
 	}
+
+#if UseMemoryTags
+	// Read once, so the same tag is charged here and stored for the free
+	Memory::MemoryTag tag = Memory::MemoryTags::GetCurrentTag();
+
+	TagPrefix* prefix = (TagPrefix*)newMemory;
+	prefix->mBytesInMemory = (unsigned int)size;
+	prefix->mDataBytes     = originalDataSize;
+	prefix->mTag           = tag;
+
+	// Everything after this point works as if the prefix was not there
+	newMemory = (char*)newMemory + tagPrefixSize;
+#endif
 	
 #if UseMemoryTracking
-	// Setup the header
-	Header* header = (Header*)newMemory; 
-			*header = Header(size, nullptr, nullptr);
+	// Setup the header - placed right before the data handed back, so any alignment padding comes before it
+	Header* header = (Header*)((char*)newMemory + headerSize - sizeof(Header)); 
+			*header = Header((unsigned int)size, originalDataSize, (unsigned int)alignment, forArray);
 
 	// Now setup the footer
-	Footer* footer = (Footer*)((char*)newMemory + sizeof(Header) + originalDataSize);
+	Footer* footer = (Footer*)((char*)newMemory + headerSize + originalDataSize);
 			*footer = Footer();
-
-	// Now add the memory for this call to the global generic tracker
-	if(Memory::mGenericTracker != nullptr)
-	{
-		Memory::mGenericTracker->AddMemoryAllocated(header);
-	}
 #endif
 
 	if (mutex)
 		mutex->unlock();
 
+#if UseMemoryTags
+	// Outside of the lock, as going over a budget prints a warning
+	Memory::MemoryTags::AddTaggedBytes(tag, originalDataSize);
+#endif
+
 #if UseMemoryTracking
+	// Now add the memory for this call to the global generic tracker - the tracker has its own locking, so this is outside the pool's
+	if(Memory::mGenericTracker != nullptr)
+	{
+		Memory::mGenericTracker->AddMemoryAllocated(header);
+	}
+
 	// Now return back the memory address to the caller so that they can use it as before
-	return (void*)((char*)newMemory + sizeof(Header));
+	void* userMemory = (void*)((char*)newMemory + headerSize);
 #else
-	return (void*)newMemory;
+	void* userMemory = newMemory;
+#endif
+
+#if UseAllocationSampling
+	// Outside of the lock, as taking a sample walks the stack
+	Memory::AllocationSampler::RecordAllocation(userMemory, originalDataSize);
 #endif
+
+#if CaptureAllocationTrace
+	Memory::AllocationTrace::RecordAllocation(userMemory, originalDataSize, alignment, forArray);
+#endif
+
+	return userMemory;
 }
 
-// ------------------------------------------------------------------------------------------------------ 
-// ------------------------------------------------------------------------------------------------------ 
 // ------------------------------------------------------------------------------------------------------ 
 
-void operator delete(void* pointer, size_t size)
+// Shared by all of the delete overrides - alignment must match what was passed into the allocation
+static void FreeThroughOverride(void* pointer, size_t size, bool forArray, size_t alignment)
 {
 	if (!pointer)
 		return;
 
-	std::mutex* mutex = Memory::MemoryPool::Get()->GetMutex();
+#if CountFrameAllocations
+	Memory::AllocationCounter::RecordFree();
+#endif
 
-	if (mutex)
-		mutex->lock();
+#if UseAllocationSampling
+	Memory::AllocationSampler::RecordFree(pointer);
+#endif
 
-	void* startOfMemory = pointer;
+#if CaptureAllocationTrace
+	Memory::AllocationTrace::RecordFree(pointer, size, alignment, forArray);
+#endif
 
 #if UseMemoryTracking
-	// Jump back to the start of the header and then delete all of the memory allocated
-	startOfMemory = (void*)((char*)pointer - sizeof(Header));
+	Header* header = (Header*)((char*)pointer - sizeof(Header));
 
-	if (Memory::mGenericTracker != nullptr)
-	{
-		Memory::mGenericTracker->RemoveMemoryAllocated((Header*)startOfMemory);
-	}
-#endif
+	// Another thread's allocation - it is left in place until that thread's segment unlinks it, and is freed from there
+	if (Memory::mGenericTracker != nullptr && !Memory::mGenericTracker->RemoveMemoryAllocated(header))
+		return;
 
-#if UseMemoryPools
-	Memory::MemoryPool::Get()->FreeMemory(size, startOfMemory, false);
+	// The header knows the full size given to the allocator, which the caller's size does not include
+	ReleaseTrackedAllocation(header);
 #else
-	// Free the memory now we are in the right place
-	free(startOfMemory);
+	ReleaseMemory(pointer, size, forArray, alignment);
 #endif
+}
 
-	if (mutex)
-		mutex->unlock();
+// ------------------------------------------------------------------------------------------------------ 
+// ------------------------------------------------------------------------------------------------------ 
+// ------------------------------------------------------------------------------------------------------ 
+
+// Global override of new - is called whenever something calls new and doesn't have its own new override
+void* operator new(size_t size) 
+{
+	return AllocateThroughOverride(size, false, 0);
+}
+
+// ------------------------------------------------------------------------------------------------------ 
+
+void* operator new[](size_t size)
+{
+	return AllocateThroughOverride(size, true, 0);
+}
+
+// ------------------------------------------------------------------------------------------------------ 
+
+// Called for types declared with alignas() larger than the default new alignment - e.g. cache line padded data
+void* operator new(size_t size, std::align_val_t alignment)
+{
+	return AllocateThroughOverride(size, false, (size_t)alignment);
+}
+
+// ------------------------------------------------------------------------------------------------------ 
+
+void* operator new[](size_t size, std::align_val_t alignment)
+{
+	// The aligned path stores its own size, so does not need the array size mapping
+	return AllocateThroughOverride(size, false, (size_t)alignment);
+}
+
+// ------------------------------------------------------------------------------------------------------ 
+// ------------------------------------------------------------------------------------------------------ 
+// ------------------------------------------------------------------------------------------------------ 
+
+void operator delete(void* pointer, size_t size)
+{
+	FreeThroughOverride(pointer, size, false, 0);
 }
 
 // ------------------------------------------------------------------------------------------------------ 
 
 void operator delete[](void* pointer)
 {
-	if (!pointer)
-		return;
+	// If this is for an array then the size is not known here, so the pool looks it up
+	FreeThroughOverride(pointer, 0, true, 0);
+}
 
-	std::mutex* mutex = Memory::MemoryPool::Get()->GetMutex();
+// ------------------------------------------------------------------------------------------------------ 
 
-	if (mutex)
-		mutex->lock();
+void operator delete(void* pointer, std::align_val_t alignment)
+{
+	FreeThroughOverride(pointer, 0, false, (size_t)alignment);
+}
 
-	void* startOfMemory = pointer;
+// ------------------------------------------------------------------------------------------------------ 
 
-#if UseMemoryTracking
-	// Jump back to the start of the header and then delete all of the memory allocated
-	startOfMemory = (void*)((char*)pointer - sizeof(Header));
+void operator delete(void* pointer, size_t size, std::align_val_t alignment)
+{
+	FreeThroughOverride(pointer, size, false, (size_t)alignment);
+}
 
-	if (Memory::mGenericTracker != nullptr)
-	{
-		Memory::mGenericTracker->RemoveMemoryAllocated((Header*)startOfMemory);
-	}
-#endif
+// ------------------------------------------------------------------------------------------------------ 
 
-#if UseMemoryPools
-	Memory::MemoryPool::Get()->FreeMemory(0, startOfMemory, true);
-#else
-	// Free the memory now we are in the right place
-	free(startOfMemory);
-#endif
+void operator delete[](void* pointer, std::align_val_t alignment)
+{
+	FreeThroughOverride(pointer, 0, false, (size_t)alignment);
+}
 
-	if (mutex)
-		mutex->unlock();
+// ------------------------------------------------------------------------------------------------------ 
+
+void operator delete[](void* pointer, size_t size, std::align_val_t alignment)
+{
+	FreeThroughOverride(pointer, size, false, (size_t)alignment);
 }
 
 // ------------------------------------------------------------------------------------------------------ 
 // ------------------------------------------------------------------------------------------------------ 
 // ------------------------------------------------------------------------------------------------------ 
 
+#else
+
+// Nothing is ever tracked without the override, so there is never anything to release
+void ReleaseTrackedAllocation(Header* header) { }
+
 #endif
 
+// ------------------------------------------------------------------------------------------------------ 
+
+// Which segment this thread adds its allocations to - there is only ever the one tracker, so this does not need to be per tracker
+static thread_local TrackerSegment* tTrackerSegment = nullptr;
+
+// ------------------------------------------------------------------------------------------------------ 
+
 BaseTracker::BaseTracker()
-	: mBytesAllocated(0)
-	, mFirstMemoryAddress(nullptr)
-	, mLastMemoryAddress(nullptr)
+	: mSegmentsUsed(0)
+	, mVerifierThread(nullptr)
+	, mVerifierRunning(false)
+	, mHeadersVerified(0)
+	, mChecksFailed(0)
+	, mSegmentPasses(0)
 {
 
+}
 
+// ------------------------------------------------------------------------------------------------------ 
+
+BaseTracker::~BaseTracker()
+{
+	StopVerifier();
 }
 
 // ------------------------------------------------------------------------------------------------------ 
 
-BaseTracker::BaseTracker(Header* firstMemoryAddress)
-	: mBytesAllocated(0)
-	, mFirstMemoryAddress(firstMemoryAddress)
-	, mLastMemoryAddress(firstMemoryAddress)
+TrackerSegment* BaseTracker::GetSegmentForThisThread()
 {
+	if (tTrackerSegment)
+		return tTrackerSegment;
+
+	unsigned int segmentIndex = mSegmentsUsed.fetch_add(1, std::memory_order_relaxed);
 
+	// Out of segments, so share the last one - the lock keeps this safe, it just means more contention for those threads
+	if (segmentIndex >= kMaxTrackerSegments)
+		segmentIndex = kMaxTrackerSegments - 1;
+
+	tTrackerSegment = &mSegments[segmentIndex];
+
+	return tTrackerSegment;
 }
 
 // ------------------------------------------------------------------------------------------------------ 
 
-BaseTracker::~BaseTracker()
+void BaseTracker::LockSegment(TrackerSegment* segment)
 {
-
+	while (segment->mLock.test_and_set(std::memory_order_acquire))
+		std::this_thread::yield();
 }
 
 // ------------------------------------------------------------------------------------------------------ 
 
-bool BaseTracker::WalkTheHeap()
+void BaseTracker::UnlockSegment(TrackerSegment* segment)
 {
-	if (!mFirstMemoryAddress)
-		return false;
+	segment->mLock.clear(std::memory_order_release);
+}
 
-	bool allChecksPassed = true;
+// ------------------------------------------------------------------------------------------------------ 
 
-	Header* currentAddress = mFirstMemoryAddress;
+void BaseTracker::UnlinkHeader(TrackerSegment* segment, Header* header)
+{
+	if (segment->mVerifyCursor == header)
+		segment->mVerifyCursor = header->mNextHeader;
 
-	unsigned int headerAndFooterSize = sizeof(Header) + sizeof(Footer);
+	if (header->mPriorHeader)
+		header->mPriorHeader->mNextHeader = header->mNextHeader;
+	else
+		segment->mFirstHeader = header->mNextHeader;
 
-	while (currentAddress != nullptr)
-	{
-		// Output the memory address
-		std::cout << "Memory Address:\t\t" << currentAddress << std::endl;
+	if (header->mNextHeader)
+		header->mNextHeader->mPriorHeader = header->mPriorHeader;
+	else
+		segment->mLastHeader = header->mPriorHeader;
 
-		// Data size
-		std::cout << "\t\t--Data size:\t\t" << currentAddress->mBytesInMemory - headerAndFooterSize << "(+" << headerAndFooterSize << ")" << std::endl;
+	header->mNextHeader  = nullptr;
+	header->mPriorHeader = nullptr;
+	header->mSegment     = nullptr;
 
-		// Next address
-		std::cout << "\t\t--Next header:\t\t" << currentAddress->mNextHeader << std::endl;
+	segment->mBytesAllocated.fetch_sub(header->mBytesInMemory, std::memory_order_relaxed);
+	segment->mAllocationCount.fetch_sub(1, std::memory_order_relaxed);
+}
 
-		// Prior header
-		std::cout << "\t\t--Prior header:\t\t" << currentAddress->mPriorHeader << std::endl;
+// ------------------------------------------------------------------------------------------------------ 
 
-		// Checksum check
-		bool checkPassed = currentAddress->mCheckValue == ChecksumValue;
-		std::cout << "\t\t--Checksum valid:\t" << (checkPassed ? "yes" : "no") << std::endl;
+void BaseTracker::DrainRemoteFrees(TrackerSegment* segment)
+{
+	// Taking the whole stack at once means there is nothing for the pushing threads to race against
+	Header* header = segment->mRemoteFrees.exchange(nullptr, std::memory_order_acquire);
 
-		if (!checkPassed)
-			allChecksPassed = false;
+	while (header)
+	{
+		Header* nextHeader = header->mNextRemoteFree;
 
-		currentAddress = currentAddress->mNextHeader;
-	}
+		UnlinkHeader(segment, header);
+		ReleaseTrackedAllocation(header);
 
-	return allChecksPassed;
+		header = nextHeader;
+	}
 }
 
 // ------------------------------------------------------------------------------------------------------ 
@@ -281,60 +464,249 @@ void BaseTracker::AddMemoryAllocated(Header* header)
 	if (!header)
 		return;
 
+	TrackerSegment* segment = GetSegmentForThisThread();
+
+	LockSegment(segment);
+
+	if (segment->mRemoteFrees.load(std::memory_order_relaxed))
+		DrainRemoteFrees(segment);
+
+	header->mSegment     = segment;
+	header->mPriorHeader = segment->mLastHeader;
+	header->mNextHeader  = nullptr;
+
+	if (segment->mLastHeader)
+		segment->mLastHeader->mNextHeader = header;
+	else
+		segment->mFirstHeader = header;
+
+	segment->mLastHeader = header;
+
+	segment->mBytesAllocated.fetch_add(header->mBytesInMemory, std::memory_order_relaxed);
+	segment->mAllocationCount.fetch_add(1, std::memory_order_relaxed);
+
+	UnlockSegment(segment);
+}
+
+// ------------------------------------------------------------------------------------------------------ 
+
+bool BaseTracker::RemoveMemoryAllocated(Header* header)
+{
+	if (!header)
+		return true;
+
+	TrackerSegment* segment = header->mSegment;
+
+	// Allocated before the tracker was setup, so was never in a list
+	if (!segment)
+		return true;
+
+	if (segment != tTrackerSegment)
+	{
+		Header* head = segment->mRemoteFrees.load(std::memory_order_relaxed);
+
+		do
+		{
+			header->mNextRemoteFree = head;
+		} 
+		while (!segment->mRemoteFrees.compare_exchange_weak(head, header, std::memory_order_release, std::memory_order_relaxed));
+
+		// If nobody has the segment right now then hand the memory back straight away, otherwise the owner or the verifier will
+		if (!segment->mLock.test_and_set(std::memory_order_acquire))
+		{
+			DrainRemoteFrees(segment);
+			UnlockSegment(segment);
+		}
+
+		return false;
+	}
+
+	LockSegment(segment);
+
+		UnlinkHeader(segment, header);
+
+	UnlockSegment(segment);
+
+	return true;
+}
+
+// ------------------------------------------------------------------------------------------------------ 
+
+static bool CheckHeaderAndFooter(const Header* header)
+{
 	if (header->mCheckValue != ChecksumValue)
+		return false;
+
+	// The footer straight after the caller's data is not necessarily aligned
+	Footer footer;
+	memcpy(&footer, (const char*)(header + 1) + header->mDataBytes, sizeof(Footer));
+
+	return footer.mCheckValue == ChecksumValue;
+}
+
+// ------------------------------------------------------------------------------------------------------ 
+
+unsigned int BaseTracker::VerifySlice(TrackerSegment* segment, unsigned int headersPerSlice)
+{
+	// Only a handful are printed, and only after the lock has been let go
+	constexpr unsigned int kMaxReportedFailures = 4;
+
+	Header*      failedHeaders[kMaxReportedFailures];
+	unsigned int failureCount   = 0;
+	unsigned int headersChecked = 0;
+
+	LockSegment(segment);
+
+	if (segment->mRemoteFrees.load(std::memory_order_relaxed))
+		DrainRemoteFrees(segment);
+
+	if (!segment->mVerifyCursor)
+		segment->mVerifyCursor = segment->mFirstHeader;
+
+	while (segment->mVerifyCursor && headersChecked < headersPerSlice)
 	{
-		std::cout << "a";
+		if (!CheckHeaderAndFooter(segment->mVerifyCursor))
+		{
+			if (failureCount < kMaxReportedFailures)
+				failedHeaders[failureCount] = segment->mVerifyCursor;
+
+			failureCount++;
+		}
+
+		headersChecked++;
+
+		segment->mVerifyCursor = segment->mVerifyCursor->mNextHeader;
+
+		if (!segment->mVerifyCursor)
+			mSegmentPasses.fetch_add(1, std::memory_order_relaxed);
 	}
 
-	mBytesAllocated += header->mBytesInMemory;
+	UnlockSegment(segment);
+
+	mHeadersVerified.fetch_add(headersChecked, std::memory_order_relaxed);
 
-	if (mFirstMemoryAddress == nullptr)
+	if (failureCount > 0)
 	{
-		mFirstMemoryAddress = header;
-		mLastMemoryAddress  = header;
+		mChecksFailed.fetch_add(failureCount, std::memory_order_relaxed);
+
+		// printf rather than cout, so that reporting does not allocate through the override from this thread
+		for (unsigned int i = 0; i < failureCount && i < kMaxReportedFailures; i++)
+			printf("Heap verifier: corrupted header or footer at %p\n", (void*)failedHeaders[i]);
 	}
-	else if(mLastMemoryAddress)
+
+	return headersChecked;
+}
+
+// ------------------------------------------------------------------------------------------------------ 
+
+void BaseTracker::VerifierLoop(unsigned int intervalMilliseconds, unsigned int headersPerSlice)
+{
+	while (mVerifierRunning.load(std::memory_order_relaxed))
 	{
-		mLastMemoryAddress->mNextHeader = header;
+		unsigned int segmentsUsed = mSegmentsUsed.load(std::memory_order_relaxed);
+
+		if (segmentsUsed > kMaxTrackerSegments)
+			segmentsUsed = kMaxTrackerSegments;
 
-		header->mPriorHeader = mLastMemoryAddress;
+		for (unsigned int i = 0; i < segmentsUsed; i++)
+			VerifySlice(&mSegments[i], headersPerSlice);
 
-		mLastMemoryAddress = header;
+		std::this_thread::sleep_for(std::chrono::milliseconds(intervalMilliseconds));
 	}
 }
 
 // ------------------------------------------------------------------------------------------------------ 
 
-void BaseTracker::RemoveMemoryAllocated(Header* header)
+void BaseTracker::StartVerifier(unsigned int intervalMilliseconds, unsigned int headersPerSlice)
 {
-	if (!header)
+	if (mVerifierThread)
 		return;
 
-	mBytesAllocated -= header->mBytesInMemory;
+	mVerifierRunning.store(true);
 
-	if (mFirstMemoryAddress == header)
-	{
-		if (mFirstMemoryAddress->mNextHeader)
-			mFirstMemoryAddress->mNextHeader->mPriorHeader = nullptr;
+	mVerifierThread = new std::thread(&BaseTracker::VerifierLoop, this, intervalMilliseconds, headersPerSlice);
+}
 
-		mFirstMemoryAddress = header->mNextHeader;
-	}
-	else if (mLastMemoryAddress == header)
-	{
-		if (mLastMemoryAddress->mPriorHeader)
-		{
-			mLastMemoryAddress              = mLastMemoryAddress->mPriorHeader;
-			mLastMemoryAddress->mNextHeader = nullptr;
-		}
-	}
-	else
+// ------------------------------------------------------------------------------------------------------ 
+
+void BaseTracker::StopVerifier()
+{
+	if (!mVerifierThread)
+		return;
+
+	mVerifierRunning.store(false);
+
+	mVerifierThread->join();
+
+	delete mVerifierThread;
+	mVerifierThread = nullptr;
+}
+
+// ------------------------------------------------------------------------------------------------------ 
+
+void BaseTracker::OutputVerifierStats() const
+{
+	std::cout << "Heap verifier - headers checked: " << mHeadersVerified.load() << "\tFailed checks: " << mChecksFailed.load();
+	std::cout << "\tSegment passes: " << mSegmentPasses.load() << "\tBytes tracked: " << GetBytesAllocated() << std::endl;
+}
+
+// ------------------------------------------------------------------------------------------------------ 
+
+size_t BaseTracker::GetBytesAllocated() const
+{
+	size_t bytesAllocated = 0;
+
+	for (unsigned int i = 0; i < kMaxTrackerSegments; i++)
+		bytesAllocated += mSegments[i].mBytesAllocated.load(std::memory_order_relaxed);
+
+	return bytesAllocated;
+}
+
+// ------------------------------------------------------------------------------------------------------ 
+
+bool BaseTracker::WalkTheHeap()
+{
+	bool         allChecksPassed = true;
+	unsigned int segmentsUsed    = mSegmentsUsed.load(std::memory_order_relaxed);
+
+	if (segmentsUsed > kMaxTrackerSegments)
+		segmentsUsed = kMaxTrackerSegments;
+
+	// Printed with printf, as anything allocating through the override while this thread holds its own segment would never get the lock
+	for (unsigned int i = 0; i < segmentsUsed; i++)
 	{
-		if (header->mNextHeader && header->mPriorHeader)
+		TrackerSegment* segment = &mSegments[i];
+
+		LockSegment(segment);
+
+		printf("Segment %u - %zu allocations\n", i, segment->mAllocationCount.load(std::memory_order_relaxed));
+
+		for (Header* currentAddress = segment->mFirstHeader; currentAddress != nullptr; currentAddress = currentAddress->mNextHeader)
 		{
-			header->mNextHeader->mPriorHeader = header->mPriorHeader;
-			header->mPriorHeader->mNextHeader = header->mNextHeader;
+			// Output the memory address
+			printf("Memory Address:\t\t%p\n", (void*)currentAddress);
+
+			// Data size
+			printf("\t\t--Data size:\t\t%u(+%u)\n", currentAddress->mDataBytes, currentAddress->mBytesInMemory - currentAddress->mDataBytes);
+
+			// Next address
+			printf("\t\t--Next header:\t\t%p\n", (void*)currentAddress->mNextHeader);
+
+			// Prior header
+			printf("\t\t--Prior header:\t\t%p\n", (void*)currentAddress->mPriorHeader);
+
+			// Checksum check
+			bool checkPassed = CheckHeaderAndFooter(currentAddress);
+			printf("\t\t--Checksum valid:\t%s\n", checkPassed ? "yes" : "no");
+
+			if (!checkPassed)
+				allChecksPassed = false;
 		}
+
+		UnlockSegment(segment);
 	}
+
+	return allChecksPassed;
 }
 
 // ------------------------------------------------------------------------------------------------------ 
\ No newline at end of file
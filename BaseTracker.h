@@ -2,6 +2,10 @@
 
 #include "Commons.h"
 
+#include <new>
+#include <atomic>
+#include <thread>
+
 // ------------------------------------------------
 
 #if MemoryOverride
@@ -9,30 +13,59 @@
 	void* operator new(size_t size);
 	void operator delete(void* pointer, size_t size);
 
+	// Over-aligned versions - used for anything declared with alignas() above the default new alignment
+	void* operator new(size_t size, std::align_val_t alignment);
+	void* operator new[](size_t size, std::align_val_t alignment);
+	void operator delete(void* pointer, std::align_val_t alignment);
+	void operator delete(void* pointer, size_t size, std::align_val_t alignment);
+	void operator delete[](void* pointer, std::align_val_t alignment);
+	void operator delete[](void* pointer, size_t size, std::align_val_t alignment);
+
 #endif
 
 // ------------------------------------------------
 
+struct TrackerSegment;
+
+// Sits directly before the memory handed back to the caller
 struct Header final
 {
 	Header()
-		: mCheckValue(ChecksumValue)
-		, mBytesInMemory(0)
-		, mNextHeader(nullptr)
+		: mNextHeader(nullptr)
 		, mPriorHeader(nullptr)
+		, mSegment(nullptr)
+		, mNextRemoteFree(nullptr)
+		, mBytesInMemory(0)
+		, mDataBytes(0)
+		, mAlignment(0)
+		, mForArray(false)
+		, mCheckValue(ChecksumValue)
 	{ }
 
-	Header(unsigned int bytesInMemory, Header* nextHeader, Header* priorHeader)
-		: mCheckValue(ChecksumValue)
+	Header(unsigned int bytesInMemory, unsigned int dataBytes, unsigned int alignment, bool forArray)
+		: mNextHeader(nullptr)
+		, mPriorHeader(nullptr)
+		, mSegment(nullptr)
+		, mNextRemoteFree(nullptr)
 		, mBytesInMemory(bytesInMemory)
-		, mNextHeader(nextHeader)
-		, mPriorHeader(priorHeader)
+		, mDataBytes(dataBytes)
+		, mAlignment(alignment)
+		, mForArray(forArray)
+		, mCheckValue(ChecksumValue)
 	{ }
 
-	unsigned int mCheckValue;
-	unsigned int mBytesInMemory;
-	Header*      mNextHeader;
-	Header*      mPriorHeader;
+	Header*         mNextHeader;
+	Header*         mPriorHeader;
+	TrackerSegment* mSegment;        // The list this header is in - nullptr if it was allocated before tracking started
+	Header*         mNextRemoteFree; // Only used while waiting in another thread's remote free stack
+
+	unsigned int    mBytesInMemory;  // Everything given to the allocator - header, footer and any alignment padding included
+	unsigned int    mDataBytes;      // What the caller asked for - the footer is straight after this
+	unsigned int    mAlignment;      // 0 for the default alignment
+	bool            mForArray;
+
+	// Last, so that it is the first thing to be hit by a write running backwards off the start of the caller's memory
+	unsigned int    mCheckValue;
 };
 
 // ------------------------------------------------
@@ -48,22 +81,72 @@ struct Footer final
 
 // ------------------------------------------------
 
+// Upper limit on the amount of threads that get their own segment - any past this share the last one
+constexpr unsigned int kMaxTrackerSegments = 64;
+
+// One thread's allocations. Only the owning thread links and unlinks headers, so the lock is only ever contended by the
+// background verifier. Other threads freeing into the segment push onto the remote stack without locking,
+// and the memory is handed back once the header has been unlinked
+struct TrackerSegment
+{
+	std::atomic_flag     mLock = ATOMIC_FLAG_INIT;
+
+	Header*              mFirstHeader     = nullptr;
+	Header*              mLastHeader      = nullptr;
+	Header*              mVerifyCursor    = nullptr; // Where the verifier got up to - moved on if that header is unlinked
+
+	std::atomic<Header*> mRemoteFrees     = nullptr;
+
+	std::atomic<size_t>  mBytesAllocated  = 0;
+	std::atomic<size_t>  mAllocationCount = 0;
+};
+
+// ------------------------------------------------
+
 class BaseTracker
 {
 public:
 	BaseTracker();
-	BaseTracker(Header* firstMemoryAddress);
 	~BaseTracker();
 
+	// Prints every allocation - slow, use the background verifier for regular checking
 	bool WalkTheHeap();
 
 	void AddMemoryAllocated(Header* header);
-	void RemoveMemoryAllocated(Header* header);
+
+	// Returns false if the header belongs to another thread's segment - the memory is then freed by that segment later
+	bool RemoveMemoryAllocated(Header* header);
+
+	// Checks a slice of each segment's headers and footers every interval, on its own thread
+	void StartVerifier(unsigned int intervalMilliseconds, unsigned int headersPerSlice);
+	void StopVerifier();
+	void OutputVerifierStats() const;
+
+	size_t GetBytesAllocated() const;
 
 private:
-	unsigned int mBytesAllocated;
-	Header*      mFirstMemoryAddress;
-	Header*      mLastMemoryAddress;
+	TrackerSegment* GetSegmentForThisThread();
+
+	void LockSegment(TrackerSegment* segment);
+	void UnlockSegment(TrackerSegment* segment);
+
+	// Both must be called with the segment's lock held
+	void UnlinkHeader(TrackerSegment* segment, Header* header);
+	void DrainRemoteFrees(TrackerSegment* segment);
+
+	// Returns how many headers were checked
+	unsigned int VerifySlice(TrackerSegment* segment, unsigned int headersPerSlice);
+	void         VerifierLoop(unsigned int intervalMilliseconds, unsigned int headersPerSlice);
+
+	TrackerSegment            mSegments[kMaxTrackerSegments];
+	std::atomic<unsigned int> mSegmentsUsed;
+
+	std::thread*              mVerifierThread;
+	std::atomic<bool>         mVerifierRunning;
+
+	std::atomic<size_t>       mHeadersVerified;
+	std::atomic<size_t>       mChecksFailed;
+	std::atomic<size_t>       mSegmentPasses;    // Times the verifier has reached the end of a segment
 };
 
 // ------------------------------------------------
\ No newline at end of file
@@ -3,6 +3,9 @@
 // Total box count
 #define NUMBER_OF_BOXES 50000
 
+// Seeds the scene's random numbers, so a run can be repeated - 0 takes the seed from the clock, so every run is different
+#define SceneRandomSeed 0
+
 // Depth of quad-tree (depth of 0 = all on one layer, depth of 1 = splits area into 4)
 #define QuadtreeDepth 4
 
@@ -15,9 +18,99 @@
 // Swapping out malloc/free with our own memory pools
 #define UseMemoryPools true
 
+// Back the memory pool with 2MB pages where the system allows it, to cut down on TLB misses - falls back to normal pages if not
+#define UseHugePages true
+
+// Give each NUMA node its own pool, place each leaf's data on one node, and pin the workers so that they mostly process local leaves
+#define UseNumaPlacement true
+
+// Runs the local vs remote memory bandwidth benchmark instead of the simulation
+#define RunNumaBenchmark false
+
+// Runs the MemoryPool vs new override vs malloc benchmark instead of the simulation
+#define RunAllocatorBenchmark false
+
+// Times the physics, vector and lookup kernels on their own over several input sizes, instead of running the simulation -
+// prints ns per op and throughput, and writes the results to KernelBenchmarkPath as JSON for comparing runs
+#define RunKernelBenchmarks false
+#define KernelBenchmarkPath "KernelBenchmarks.json"
+
+// Runs the same fixed seed scene for ScalingSweepFrames frames at every combination of box count, tree depth (0 to
+// ScalingSweepMaxDepth) and worker count (1 up to the core count), instead of the simulation. Prints frame time, speedup
+// and parallel efficiency, and writes them to ScalingSweepPath. Combinations this build cannot hold are skipped and say why
+#define RunScalingSweep false
+#define ScalingSweepBoxCounts 10000, 50000, 200000, 500000, 2000000
+#define ScalingSweepMaxDepth 8
+#define ScalingSweepFrames 60
+#define ScalingSweepPath "ScalingSweep.csv"
+
+// Runs a fixed set of headless scenes with fixed seeds and time steps, instead of the simulation, and compares their frame
+// times and final state against RegressionBaselinePath. Exits with 1 if a scene has got significantly slower (Mann-Whitney U)
+// or its state no longer matches. With RegressionWriteBaseline, or when there is no baseline yet, writes one instead
+#define RunRegressionCheck false
+#define RegressionWriteBaseline false
+#define RegressionBaselinePath "RegressionBaseline.txt"
+
+// Records every allocation and free through the overrides to AllocationTracePath, so the session can be replayed against other allocators
+#define CaptureAllocationTrace false
+#define AllocationTracePath "AllocationTrace.bin"
+
+// Replays AllocationTracePath against the pool and malloc instead of running the simulation
+#define RunTraceReplay false
+
+// Appends the memory pools' counters to a CSV file while running - reading them does not lock the pools
+#define LogMemoryPoolStats false
+#define MemoryPoolStatsInterval 1.0f
+#define MemoryPoolStatsPath "MemoryPoolStats.csv"
+
+// Records the call stack of roughly one allocation in every AllocationSampleRate bytes, to find where allocations come from
+// Only works with MemoryOverride, as it is hooked into the new/delete overrides
+#define UseAllocationSampling false
+#define AllocationSampleRate (512 * 1024)
+
+// Charges every allocation to the subsystem that made it, and warns the first time a subsystem goes over its budget
+// The tag is stored in front of each allocation made through the overrides, so this only works with MemoryOverride
+#define UseMemoryTags false
+#define MemoryBudgetQuadtree     (48  * 1024 * 1024)
+#define MemoryBudgetLeafLists    (4   * 1024 * 1024)
+#define MemoryBudgetPhysicsState (4   * 1024 * 1024)
+#define MemoryBudgetRender       (16  * 1024 * 1024)
+#define MemoryBudgetIO           (1   * 1024 * 1024)
+
+// Counts the allocations and frees made through the overrides during each Quadtree::Update. A frame past the warm up should
+// make none, so with AssertNoFrameAllocations any it does make assert where they happen. Only works with MemoryOverride
+#define CountFrameAllocations       true
+#define AssertNoFrameAllocations    false
+#define FrameAllocationWarmupFrames 60
+
+// Slides the leaves' lists together between frames, so that hours of lists growing and shrinking do not leave the pools full
+// of small holes. Each frame moves at most this many bytes and looks at this many blocks per pool, so the cost is bounded
+#define CompactPoolsBetweenFrames true
+#define CompactionBytesPerFrame  (64 * 1024)
+#define CompactionBlocksPerFrame 1024
+
+// The leaves' lists sit behind pool handles so that the compaction above can move them. Turned off, they are plain lists
+// allocated straight from the leaf's region through RegionAllocator, which grow in place where they can - no handle to look
+// up, but nothing to compact either
+#define UseMovableLeafLists true
+
+// Starts from the boxes saved in WorldSnapshotPath rather than running initScene, if the file is there - keys 6 and 7 save and load it while running
+#define RestoreWorldFromSnapshot false
+#define WorldSnapshotPath "WorldState.snap"
+
+// Streams what every leaf did each frame - cube counts, pair tests, contacts, migrations and job time - to a CSV file
+// from a background thread, for choosing QuadtreeDepth and the boundary size from measured numbers. Roughly 40 bytes per leaf per frame
+#define LogLeafMetrics false
+#define LeafMetricsPath "LeafMetrics.csv"
+
 // Memory tagging - adding a header and footer to the memory we allocate
 #define UseMemoryTracking false
 
+// With tracking on, checks the headers and footers on a background thread a slice at a time, rather than stopping to walk the heap
+#define VerifyHeapInBackground true
+#define HeapVerifierIntervalMilliseconds 5
+#define HeapVerifierHeadersPerSlice 256
+
 // The value checked when walking the heap
 #define ChecksumValue 0xAAAABBBB
 
@@ -27,8 +120,6 @@
 // The dimensions of the cubes - everything scales according to this value
 #define CubeSize 0.1f
 
-static int LeafQuadrantCount = 0;
-
 #define debugCamera false
 
 #if debugCamera == true
@@ -56,6 +147,26 @@ static int LeafQuadrantCount = 0;
 
 #define FINE_TUNED_MEASUREMENTS true
 
+// Counts cycles, instructions, cache, branch and TLB misses around each leaf stage and each frame through perf_event_open,
+// and prints IPC and misses per stage on exit. Each stage costs two system calls per leaf, so only turn on when looking into one.
+// Linux only - everything reads as zero elsewhere
+#define UsePerfCounters false
+
+// Records PROFILE_ZONE scopes on every thread for a window of frames, and writes them out as a Chrome trace to see on a timeline
+#define UseProfilerZones     false
+#define ProfilerTracePath    "FrameTrace.json"
+#define ProfilerFirstFrame   120
+#define ProfilerFrameCount   10
+
+// Counts how often each named simulation mutex is taken, how often that meant waiting, the total wait and the longest hold,
+// and every LockContentionWindowFrames frames prints the LockContentionReportCount locks that were waited on longest
+#define ProfileLockContention      false
+#define LockContentionWindowFrames 300
+#define LockContentionReportCount  5
+
+// Where the update, idle and display time histograms are written on exit, one row per bucket, for plotting the tails
+#define TimingHistogramPath "TimingHistograms.csv"
+
 #define MaxCubeTransferRate NUMBER_OF_BOXES / 4
 
 #define SegmentBounarySize CubeSize * 2
@@ -1,6 +1,8 @@
 #include "Cube.h"
 #include "Commons.h"
 
+#include <utility>
+
 #include <GL/glut.h>
 #include <GL/freeglut.h>
 
@@ -112,4 +114,38 @@ void Box::CapVelocity()
     }
 }
 
+// -----------------------------------------------------------------------------
+
+bool rayBoxIntersection(const Vec3& rayOrigin, const Vec3& rayDirection, const Box& box)
+{
+    float tMin = (box.position.x - box.halfSize.x - rayOrigin.x) / rayDirection.x;
+    float tMax = (box.position.x + box.halfSize.x - rayOrigin.x) / rayDirection.x;
+
+    if (tMin > tMax) std::swap(tMin, tMax);
+
+    float tyMin = (box.position.y - box.halfSize.y - rayOrigin.y) / rayDirection.y;
+    float tyMax = (box.position.y + box.halfSize.y - rayOrigin.y) / rayDirection.y;
+
+    if (tyMin > tyMax) std::swap(tyMin, tyMax);
+
+    if ((tMin > tyMax) || (tyMin > tMax))
+        return false;
+
+    if (tyMin > tMin)
+        tMin = tyMin;
+
+    if (tyMax < tMax)
+        tMax = tyMax;
+
+    float tzMin = (box.position.z - box.halfSize.z - rayOrigin.z) / rayDirection.z;
+    float tzMax = (box.position.z + box.halfSize.z - rayOrigin.z) / rayDirection.z;
+
+    if (tzMin > tzMax) std::swap(tzMin, tzMax);
+
+    if ((tMin > tzMax) || (tzMin > tMax))
+        return false;
+
+    return true;
+}
+
 // -----------------------------------------------------------------------------
\ No newline at end of file
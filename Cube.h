@@ -18,4 +18,7 @@ public:
     Vec3 halfSize;
     Vec3 velocity;
     Vec3 colour;
-};
\ No newline at end of file
+};
+
+// Slab test - true if the infinite line through rayOrigin along rayDirection passes through the box
+bool rayBoxIntersection(const Vec3& rayOrigin, const Vec3& rayDirection, const Box& box);
\ No newline at end of file
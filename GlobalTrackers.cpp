@@ -1,6 +1,7 @@
 #include "GlobalTrackers.h"
 
 #include <malloc.h>
+#include <new>
 
 // ------------------------------------------------------
 
@@ -12,8 +13,23 @@ namespace Memory
 	{
 		mGenericTracker    = (BaseTracker*)malloc(sizeof(BaseTracker));
 
+		// Constructed in place, as the segments are not copyable
 		if(mGenericTracker)
-			(*mGenericTracker) = BaseTracker();
+			new (mGenericTracker) BaseTracker();
+
+#if VerifyHeapInBackground
+		if(mGenericTracker)
+			mGenericTracker->StartVerifier(HeapVerifierIntervalMilliseconds, HeapVerifierHeadersPerSlice);
+#endif
+	}
+
+	void ShutdownGlobalTrackers()
+	{
+		if (!mGenericTracker)
+			return;
+
+		mGenericTracker->StopVerifier();
+		mGenericTracker->OutputVerifierStats();
 	}
 }
 
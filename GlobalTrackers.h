@@ -7,4 +7,7 @@ namespace Memory
 	extern BaseTracker* mGenericTracker;
 
 	void SetupGlobalTrackers();
+
+	// Stops the background verifier and reports what it found
+	void ShutdownGlobalTrackers();
 }
\ No newline at end of file
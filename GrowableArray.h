@@ -0,0 +1,155 @@
+#pragma once
+
+#include <string.h>
+
+#include <type_traits>
+
+namespace Memory
+{
+	// ----------------------------------------------------------
+
+	// A cut down std::vector for plain data, which asks its allocator to grow the existing block before falling back to
+	// allocate, copy and free. With a region allocator most growth on a busy leaf then stays in place, as the block after
+	// the list's storage is often free. Keeps the std::vector names for the parts it has, so it can be swapped in for one
+	// The leaves only use it with UseMovableLeafLists off - by default MovableArray replaces it, so the lists can be compacted
+	template<typename T, typename Allocator>
+	class GrowableArray
+	{
+		// Not is_trivially_copyable, as std::pair has its own assignment operator even when it holds plain data
+		static_assert(std::is_trivially_copy_constructible<T>::value && std::is_trivially_destructible<T>::value, "GrowableArray moves its elements with memcpy");
+
+	public:
+		using value_type     = T;
+		using allocator_type = Allocator;
+		using iterator       = T*;
+		using const_iterator = const T*;
+
+		explicit GrowableArray(const Allocator& allocator)
+			: mAllocator(allocator)
+			, mData(nullptr)
+			, mSize(0)
+			, mCapacity(0)
+		{ }
+
+		~GrowableArray()
+		{
+			Release();
+		}
+
+		GrowableArray(const GrowableArray&)            = delete;
+		GrowableArray& operator=(const GrowableArray&) = delete;
+
+		GrowableArray(GrowableArray&& other) noexcept
+			: mAllocator(other.mAllocator)
+			, mData(other.mData)
+			, mSize(other.mSize)
+			, mCapacity(other.mCapacity)
+		{
+			other.mData     = nullptr;
+			other.mSize     = 0;
+			other.mCapacity = 0;
+		}
+
+		GrowableArray& operator=(GrowableArray&& other) noexcept
+		{
+			if (this == &other)
+				return *this;
+
+			Release();
+
+			mAllocator      = other.mAllocator;
+			mData           = other.mData;
+			mSize           = other.mSize;
+			mCapacity       = other.mCapacity;
+
+			other.mData     = nullptr;
+			other.mSize     = 0;
+			other.mCapacity = 0;
+
+			return *this;
+		}
+
+		void push_back(const T& value)
+		{
+			if (mSize == mCapacity)
+				Grow(mSize + 1);
+
+			mData[mSize] = value;
+			mSize++;
+		}
+
+		void reserve(size_t count)
+		{
+			if (count > mCapacity)
+				Grow(count);
+		}
+
+		iterator erase(iterator position)
+		{
+			size_t index = position - mData;
+
+			memmove((void*)(mData + index), (const void*)(mData + index + 1), (mSize - index - 1) * sizeof(T));
+			mSize--;
+
+			return mData + index;
+		}
+
+		void   clear()                          { mSize = 0; }
+
+		size_t size()     const                 { return mSize; }
+		size_t capacity() const                 { return mCapacity; }
+		bool   empty()    const                 { return mSize == 0; }
+
+		T&       operator[](size_t index)       { return mData[index]; }
+		const T& operator[](size_t index) const { return mData[index]; }
+
+		iterator       begin()                  { return mData; }
+		iterator       end()                    { return mData + mSize; }
+		const_iterator begin() const            { return mData; }
+		const_iterator end()   const            { return mData + mSize; }
+
+	private:
+		void Grow(size_t minimumCapacity)
+		{
+			size_t newCapacity = mCapacity > 0 ? mCapacity * 2 : 8;
+
+			if (newCapacity < minimumCapacity)
+				newCapacity = minimumCapacity;
+
+			if (mData && mAllocator.try_expand(mData, mCapacity, newCapacity))
+			{
+				mCapacity = newCapacity;
+
+				return;
+			}
+
+			T* newData = mAllocator.allocate(newCapacity);
+
+			if (mData)
+			{
+				memcpy((void*)newData, (const void*)mData, mSize * sizeof(T));
+				mAllocator.deallocate(mData, mCapacity);
+			}
+
+			mData     = newData;
+			mCapacity = newCapacity;
+		}
+
+		void Release()
+		{
+			if (mData)
+				mAllocator.deallocate(mData, mCapacity);
+
+			mData     = nullptr;
+			mSize     = 0;
+			mCapacity = 0;
+		}
+
+		Allocator mAllocator;
+		T*        mData;
+		size_t    mSize;
+		size_t    mCapacity;
+	};
+
+	// ----------------------------------------------------------
+}
\ No newline at end of file
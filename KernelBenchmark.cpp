@@ -0,0 +1,361 @@
+#include "KernelBenchmark.h"
+
+#include "Commons.h"
+#include "Cube.h"
+#include "Vector3D.h"
+#include "Quadtree.h"
+#include "ParentQuadrant.h"
+#include "LeafQuadrant.h"
+#include "TimeTracker.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include <stdint.h>
+#include <stdio.h>
+
+namespace Benchmarks
+{
+	// -------------------------------------------------------------------------
+
+	// From well inside L1 to well outside L2, so the layout of the data shows up as well as the arithmetic
+	constexpr unsigned int kKernelBenchmarkSizes[]   = { 256, 4096, 65536 };
+
+	constexpr unsigned int kKernelBenchmarkPasses    = 15;
+
+	// Each pass goes round the inputs until it has done about this many operations, so small sizes are not lost in the timer
+	constexpr unsigned int kOperationsPerPass        = 1 << 20;
+
+	// Same inputs every run, so that results are comparable between builds
+	constexpr unsigned int kKernelBenchmarkSeed      = 12345;
+
+	// -------------------------------------------------------------------------
+
+	struct KernelResult
+	{
+		const char*  mName;
+		unsigned int mSize;
+		uint64_t     mOperations;     // Per pass
+		double       mBestNsPerOp;
+		double       mMedianNsPerOp;
+	};
+
+	// -------------------------------------------------------------------------
+
+	// Results are added into this, so the compiler cannot throw the work away
+	static volatile float sSink = 0.0f;
+
+	// -------------------------------------------------------------------------
+
+	// kernel does one operation per input and returns something to sink. reset is run before every round and is timed with it,
+	// so kernels that change their inputs are measured from the same starting point each round - keep it cheap next to the kernel
+	template<typename Reset, typename Kernel>
+	static KernelResult MeasureKernel(const char* name, unsigned int size, Reset reset, Kernel kernel)
+	{
+		unsigned int rounds = kOperationsPerPass / size > 0 ? kOperationsPerPass / size : 1;
+		double       nsPerOp[kKernelBenchmarkPasses];
+
+		// One untimed pass to warm the caches and the branch predictors
+		reset();
+		sSink = sSink + kernel();
+
+		for (unsigned int pass = 0; pass < kKernelBenchmarkPasses; pass++)
+		{
+			float    result      = 0.0f;
+			uint64_t startCycles = CycleClock::Start();
+
+			for (unsigned int round = 0; round < rounds; round++)
+			{
+				reset();
+				result += kernel();
+			}
+
+			uint64_t endCycles   = CycleClock::Stop();
+
+			sSink         = sSink + result;
+			nsPerOp[pass] = (double)CycleClock::ToNanoseconds(endCycles - startCycles) / ((double)rounds * (double)size);
+		}
+
+		std::sort(nsPerOp, nsPerOp + kKernelBenchmarkPasses);
+
+		return { name, size, (uint64_t)rounds * size, nsPerOp[0], nsPerOp[kKernelBenchmarkPasses / 2] };
+	}
+
+	// -------------------------------------------------------------------------
+
+	static float RandomRange(std::mt19937& random, float minimum, float maximum)
+	{
+		return std::uniform_real_distribution<float>(minimum, maximum)(random);
+	}
+
+	// -------------------------------------------------------------------------
+
+	static Vec3 RandomVector(std::mt19937& random, float extent)
+	{
+		return Vec3(RandomRange(random, -extent, extent), RandomRange(random, -extent, extent), RandomRange(random, -extent, extent));
+	}
+
+	// -------------------------------------------------------------------------
+
+	// A box somewhere in the play area, moving at up to twice the speed cap so CapVelocity has work to do
+	static Box RandomBox(std::mt19937& random)
+	{
+		Box box;
+
+		box.position = Vec3(RandomRange(random, minX + CubeSize, maxX - CubeSize), RandomRange(random, CubeSize, 10.0f), RandomRange(random, minZ + CubeSize, maxZ - CubeSize));
+		box.halfSize = Vec3(CubeSize / 2.0f, CubeSize / 2.0f, CubeSize / 2.0f);
+		box.velocity = RandomVector(random, (float)MaxSpeed * 2.0f);
+		box.colour   = Vec3(1.0f, 1.0f, 1.0f);
+
+		return box;
+	}
+
+	// -------------------------------------------------------------------------
+
+	static void MeasureVectorKernels(std::mt19937& random, unsigned int size, std::vector<KernelResult>& results)
+	{
+		std::vector<Vec3> a(size);
+		std::vector<Vec3> b(size);
+		std::vector<Vec3> out(size);
+
+		for (unsigned int i = 0; i < size; i++)
+		{
+			a[i] = RandomVector(random, 100.0f);
+			b[i] = RandomVector(random, 100.0f);
+		}
+
+		auto noReset = []() { };
+
+		results.push_back(MeasureKernel("Vec3 add and scale", size, noReset, [&]()
+		{
+			for (unsigned int i = 0; i < size; i++)
+				out[i] = (a[i] + b[i]) * 0.5f;
+
+			return out[size - 1].x;
+		}));
+
+		results.push_back(MeasureKernel("Vec3::normalised", size, noReset, [&]()
+		{
+			for (unsigned int i = 0; i < size; i++)
+				out[i] = a[i].normalised();
+
+			return out[size - 1].x;
+		}));
+
+		results.push_back(MeasureKernel("Vec3::length", size, noReset, [&]()
+		{
+			float total = 0.0f;
+
+			for (unsigned int i = 0; i < size; i++)
+				total += a[i].length();
+
+			return total;
+		}));
+	}
+
+	// -------------------------------------------------------------------------
+
+	static void MeasureBoxKernels(std::mt19937& random, unsigned int size, std::vector<KernelResult>& results)
+	{
+		std::vector<Box>  boxes(size);
+		std::vector<Vec3> startVelocities(size);
+
+		for (unsigned int i = 0; i < size; i++)
+		{
+			boxes[i]           = RandomBox(random);
+			startVelocities[i] = boxes[i].velocity;
+		}
+
+		auto noReset = []() { };
+
+		// Stays in the play area however long it runs, as the walls and floor bounce the boxes back
+		results.push_back(MeasureKernel("Box::UpdatePhysics", size, noReset, [&]()
+		{
+			for (unsigned int i = 0; i < size; i++)
+				boxes[i].UpdatePhysics(0.016f);
+
+			return boxes[size - 1].position.y;
+		}));
+
+		auto resetVelocities = [&]()
+		{
+			for (unsigned int i = 0; i < size; i++)
+				boxes[i].velocity = startVelocities[i];
+		};
+
+		results.push_back(MeasureKernel("Box::CapVelocity", size, resetVelocities, [&]()
+		{
+			for (unsigned int i = 0; i < size; i++)
+				boxes[i].CapVelocity();
+
+			return boxes[size - 1].velocity.x;
+		}));
+
+		// Pairs of boxes next to each other, about half of them overlapping and all heading towards each other, so the
+		// collision test's branches are unpredictable and every resolve goes all the way through
+		std::vector<Box> pairs(size * 2);
+
+		for (unsigned int i = 0; i < size; i++)
+		{
+			Box& first  = pairs[i * 2];
+			Box& second = pairs[i * 2 + 1];
+
+			first              = RandomBox(random);
+
+			float closingSpeed = std::abs(first.velocity.x) + 1.0f;
+
+			second          = first;
+			second.position = first.position + Vec3(RandomRange(random, 0.0f, CubeSize * 2.0f), 0.0f, RandomRange(random, -CubeSize / 2.0f, CubeSize / 2.0f));
+			second.velocity = Vec3(-closingSpeed, first.velocity.y, first.velocity.z);
+			first.velocity  = Vec3( closingSpeed, first.velocity.y, first.velocity.z);
+		}
+
+		results.push_back(MeasureKernel("Box::CheckCollision", size, noReset, [&]()
+		{
+			unsigned int collisions = 0;
+
+			for (unsigned int i = 0; i < size; i++)
+				collisions += pairs[i * 2].CheckCollision(pairs[i * 2 + 1]) ? 1 : 0;
+
+			return (float)collisions;
+		}));
+
+		std::vector<Box> startPairs = pairs;
+
+		results.push_back(MeasureKernel("Box::ResolveCollision", size, [&]()
+		{
+			for (unsigned int i = 0; i < size * 2; i++)
+				pairs[i].velocity = startPairs[i].velocity;
+		},
+		[&]()
+		{
+			for (unsigned int i = 0; i < size; i++)
+				Box::ResolveCollision(pairs[i * 2], pairs[i * 2 + 1]);
+
+			return pairs[0].velocity.x;
+		}));
+
+		// Rays from the camera out through random points in the play area, against boxes scattered over it
+		Vec3              cameraPosition(LOOKAT_X, LOOKAT_Y, LOOKAT_Z);
+		std::vector<Vec3> rayDirections(size);
+
+		for (unsigned int i = 0; i < size; i++)
+		{
+			Vec3 target = boxes[(i * 7) % size].position + RandomVector(random, CubeSize * 2.0f);
+
+			rayDirections[i] = (target - cameraPosition).normalised();
+		}
+
+		results.push_back(MeasureKernel("rayBoxIntersection", size, noReset, [&]()
+		{
+			unsigned int hits = 0;
+
+			for (unsigned int i = 0; i < size; i++)
+				hits += rayBoxIntersection(cameraPosition, rayDirections[i], boxes[(i * 7) % size]) ? 1 : 0;
+
+			return (float)hits;
+		}));
+	}
+
+	// -------------------------------------------------------------------------
+
+	static void MeasureLookupKernels(std::mt19937& random, Quadtree& tree, unsigned int size, std::vector<KernelResult>& results)
+	{
+		std::vector<Vec3> positions(size);
+
+		for (unsigned int i = 0; i < size; i++)
+			positions[i] = Vec3(RandomRange(random, minX, maxX), 0.5f, RandomRange(random, minZ, maxZ));
+
+		auto noReset = []() { };
+
+		ParentQuadrant* root = (ParentQuadrant*)tree.GetRootQuadrant();
+
+		results.push_back(MeasureKernel("ParentQuadrant::FindQuadrantForPosition", size, noReset, [&]()
+		{
+			unsigned int found = 0;
+
+			for (unsigned int i = 0; i < size; i++)
+				found += root->FindQuadrantForPosition(positions[i]) ? 1 : 0;
+
+			return (float)found;
+		}));
+
+		results.push_back(MeasureKernel("Quadtree::FindQuadrantContainingPosition", size, noReset, [&]()
+		{
+			unsigned int found = 0;
+
+			for (unsigned int i = 0; i < size; i++)
+				found += tree.FindQuadrantContainingPosition(positions[i]) ? 1 : 0;
+
+			return (float)found;
+		}));
+	}
+
+	// -------------------------------------------------------------------------
+
+	static bool WriteResults(const char* jsonPath, const std::vector<KernelResult>& results)
+	{
+		FILE* file = fopen(jsonPath, "w");
+
+		if (!file)
+			return false;
+
+		fprintf(file, "{\n\t\"passes\": %u,\n\t\"benchmarks\": [\n", kKernelBenchmarkPasses);
+
+		for (size_t i = 0; i < results.size(); i++)
+		{
+			const KernelResult& result = results[i];
+
+			fprintf(file, "\t\t{ \"name\": \"%s\", \"size\": %u, \"operations_per_pass\": %llu, \"best_ns_per_op\": %.4f, \"median_ns_per_op\": %.4f, \"ops_per_second\": %.0f }%s\n",
+				result.mName, result.mSize, (unsigned long long)result.mOperations, result.mBestNsPerOp, result.mMedianNsPerOp,
+				1e9 / result.mMedianNsPerOp, i + 1 < results.size() ? "," : "");
+		}
+
+		fprintf(file, "\t]\n}\n");
+		fclose(file);
+
+		return true;
+	}
+
+	// -------------------------------------------------------------------------
+
+	void MeasureKernels(const char* jsonPath)
+	{
+		std::vector<KernelResult> results;
+		std::mt19937              random(kKernelBenchmarkSeed);
+
+		for (unsigned int size : kKernelBenchmarkSizes)
+		{
+			MeasureVectorKernels(random, size, results);
+			MeasureBoxKernels(random, size, results);
+		}
+
+		// The lookups need a whole tree, but not its workers - they would only spin on an empty job list next to the timing
+		if (QuadtreeDepth > 0)
+		{
+			Quadtree* tree = new Quadtree(QuadtreeDepth, { minX, 0.0f, minZ }, { maxX, 1.0f, maxZ }, 0);
+
+			for (unsigned int size : kKernelBenchmarkSizes)
+				MeasureLookupKernels(random, *tree, size, results);
+
+			delete tree;
+		}
+
+		std::cout << std::left << std::setw(42) << "Kernel" << std::right << std::setw(8) << "Size" << std::setw(12) << "Best ns/op" << std::setw(14) << "Median ns/op" << std::setw(14) << "Mops/s" << std::endl;
+
+		for (const KernelResult& result : results)
+		{
+			std::cout << std::left << std::setw(42) << result.mName << std::right << std::setw(8) << result.mSize
+			          << std::fixed << std::setprecision(3) << std::setw(12) << result.mBestNsPerOp << std::setw(14) << result.mMedianNsPerOp
+			          << std::setprecision(1) << std::setw(14) << 1e3 / result.mMedianNsPerOp << std::endl;
+		}
+
+		if (!WriteResults(jsonPath, results))
+			std::cout << "Could not open " << jsonPath << " for the kernel benchmark results" << std::endl;
+	}
+
+	// -------------------------------------------------------------------------
+}
\ No newline at end of file
@@ -0,0 +1,8 @@
+#pragma once
+
+namespace Benchmarks
+{
+	// Times the Vec3 operations, the Box physics and collision functions, the quadtree lookups and the ray test on their own,
+	// over randomised inputs at a few sizes - prints ns per op and throughput, and writes the same to jsonPath
+	void MeasureKernels(const char* jsonPath);
+}
\ No newline at end of file
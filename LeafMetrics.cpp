@@ -0,0 +1,177 @@
+#include "LeafMetrics.h"
+
+#include "MemoryTags.h"
+
+// ----------------------------------------------
+
+LeafMetricsWriter::LeafMetricsWriter()
+	: mFile(nullptr)
+	, mLeafCount(0)
+	, mFrames(nullptr)
+	, mFrameNumbers()
+	, mFramesSubmitted(0)
+	, mFramesWritten(0)
+	, mFramesDropped(0)
+	, mWriterThread(nullptr)
+	, mWriterRunning(false)
+	, mWakeMutex()
+	, mWakeWriter()
+{
+
+}
+
+// ----------------------------------------------
+
+LeafMetricsWriter::~LeafMetricsWriter()
+{
+	Close();
+}
+
+// ----------------------------------------------
+
+bool LeafMetricsWriter::Open(const char* path, unsigned int leafCount)
+{
+	Close();
+
+	if (leafCount == 0)
+		return false;
+
+	mFile = fopen(path, "w");
+
+	if (!mFile)
+		return false;
+
+	Memory::ScopedMemoryTag memoryTag(Memory::MemoryTag::IO);
+
+	mLeafCount       = leafCount;
+	mFrames          = new LeafFrameMetrics[kFramesInFlight * leafCount];
+	mFramesSubmitted = 0;
+	mFramesWritten   = 0;
+	mFramesDropped   = 0;
+
+	fprintf(mFile, "frame,leaf,cubes_in_segment,cubes_in_boundary,pair_tests,contacts_resolved,migrated_in,migrated_out,migration_drops,job_nanoseconds\n");
+
+	mWriterRunning.store(true);
+	mWriterThread = new std::thread(&LeafMetricsWriter::WriterLoop, this);
+
+	return true;
+}
+
+// ----------------------------------------------
+
+void LeafMetricsWriter::Close()
+{
+	if (!mFile)
+		return;
+
+	// The writer empties the queue before it stops, so every submitted frame makes it into the file
+	{
+		std::lock_guard<std::mutex> lock(mWakeMutex);
+		mWriterRunning.store(false);
+	}
+	mWakeWriter.notify_one();
+
+	mWriterThread->join();
+
+	delete mWriterThread;
+	mWriterThread = nullptr;
+
+	if (mFramesDropped > 0)
+		printf("Leaf metrics - %u frame(s) dropped as the writer could not keep up\n", mFramesDropped);
+
+	fclose(mFile);
+	mFile = nullptr;
+
+	delete[] mFrames;
+	mFrames    = nullptr;
+	mLeafCount = 0;
+}
+
+// ----------------------------------------------
+
+LeafFrameMetrics* LeafMetricsWriter::BeginFrame()
+{
+	if (!mFile)
+		return nullptr;
+
+	unsigned int submitted = mFramesSubmitted.load(std::memory_order_relaxed);
+
+	if (submitted - mFramesWritten.load(std::memory_order_acquire) >= kFramesInFlight)
+	{
+		mFramesDropped++;
+		return nullptr;
+	}
+
+	return mFrames + ((submitted % kFramesInFlight) * mLeafCount);
+}
+
+// ----------------------------------------------
+
+void LeafMetricsWriter::SubmitFrame(unsigned int frameNumber)
+{
+	unsigned int submitted = mFramesSubmitted.load(std::memory_order_relaxed);
+
+	mFrameNumbers[submitted % kFramesInFlight] = frameNumber;
+
+	// Published under the lock, so the writer cannot check the count and go to sleep in between
+	{
+		std::lock_guard<std::mutex> lock(mWakeMutex);
+		mFramesSubmitted.store(submitted + 1, std::memory_order_release);
+	}
+	mWakeWriter.notify_one();
+}
+
+// ----------------------------------------------
+
+void LeafMetricsWriter::WriterLoop()
+{
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(mWakeMutex);
+
+			mWakeWriter.wait(lock, [this]()
+			{
+				return !mWriterRunning.load() || mFramesWritten.load(std::memory_order_relaxed) != mFramesSubmitted.load(std::memory_order_relaxed);
+			});
+		}
+
+		unsigned int submitted = mFramesSubmitted.load(std::memory_order_acquire);
+		unsigned int written   = mFramesWritten.load(std::memory_order_relaxed);
+
+		for (; written != submitted; written++)
+		{
+			WriteFrame(written % kFramesInFlight);
+
+			// Hands the buffer back to the tree
+			mFramesWritten.store(written + 1, std::memory_order_release);
+		}
+
+		if (!mWriterRunning.load() && mFramesSubmitted.load(std::memory_order_acquire) == written)
+			break;
+	}
+
+	fflush(mFile);
+}
+
+// ----------------------------------------------
+
+void LeafMetricsWriter::WriteFrame(unsigned int bufferIndex)
+{
+	const LeafFrameMetrics* frame       = mFrames + (bufferIndex * mLeafCount);
+	unsigned int            frameNumber = mFrameNumbers[bufferIndex];
+
+	for (unsigned int leaf = 0; leaf < mLeafCount; leaf++)
+	{
+		const LeafFrameMetrics& metrics = frame[leaf];
+
+		fprintf(mFile, "%u,%u,%u,%u,%u,%u,%u,%u,%u,%llu\n",
+			frameNumber, leaf,
+			metrics.mCubesInSegment, metrics.mCubesInBoundary,
+			metrics.mPairTests, metrics.mContactsResolved,
+			metrics.mCubesMigratedIn, metrics.mCubesMigratedOut, metrics.mMigrationDrops,
+			(unsigned long long)metrics.mJobNanoseconds);
+	}
+}
+
+// ----------------------------------------------
\ No newline at end of file
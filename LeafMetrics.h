@@ -0,0 +1,69 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+
+// -------------------------------------
+
+// What one leaf did over one frame - the counts are reset each time the tree collects them
+struct LeafFrameMetrics
+{
+	unsigned int mCubesInSegment;    // At the end of the leaf's update
+	unsigned int mCubesInBoundary;
+	unsigned int mPairTests;         // Cube against cube checks, both inside the leaf and against the neighbours' boundaries
+	unsigned int mContactsResolved;
+	unsigned int mCubesMigratedIn;
+	unsigned int mCubesMigratedOut;
+	unsigned int mMigrationDrops;    // Transfers in or out turned away because MaxCubeTransferRate had been hit
+	uint64_t     mJobNanoseconds;    // The whole ThreadUpdate, as run on whichever worker picked the leaf up
+};
+
+// -------------------------------------
+
+// Streams every leaf's metrics to a CSV file, one row per leaf per frame, with the leaves numbered in job order. The tree
+// copies the counters into one of a few frame buffers between frames, and a background thread does the formatting and
+// writing, so the frame never waits on the disk. If the writer falls that far behind, whole frames are dropped rather than blocking
+class LeafMetricsWriter
+{
+public:
+	LeafMetricsWriter();
+	~LeafMetricsWriter();
+
+	bool              Open(const char* path, unsigned int leafCount);
+	void              Close();
+
+	bool              IsOpen() const { return mFile != nullptr; }
+
+	// Hands back a buffer with room for every leaf, or nullptr if the file is not open or every buffer is still queued.
+	// Anything returned must be passed to SubmitFrame before the next BeginFrame
+	LeafFrameMetrics* BeginFrame();
+	void              SubmitFrame(unsigned int frameNumber);
+
+private:
+	void              WriterLoop();
+	void              WriteFrame(unsigned int bufferIndex);
+
+	static constexpr unsigned int kFramesInFlight = 8;
+
+	FILE*                     mFile;
+	unsigned int              mLeafCount;
+
+	LeafFrameMetrics*         mFrames;                          // kFramesInFlight buffers of mLeafCount entries
+	unsigned int              mFrameNumbers[kFramesInFlight];
+
+	std::atomic<unsigned int> mFramesSubmitted;                 // Only ever counts up - the buffer is the count modulo kFramesInFlight
+	std::atomic<unsigned int> mFramesWritten;
+	unsigned int              mFramesDropped;
+
+	std::thread*              mWriterThread;
+	std::atomic<bool>         mWriterRunning;
+	std::mutex                mWakeMutex;
+	std::condition_variable   mWakeWriter;
+};
+
+// -------------------------------------
\ No newline at end of file
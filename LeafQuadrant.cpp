@@ -2,6 +2,8 @@
 #include "ParentQuadrant.h"
 
 #include "Quadtree.h"
+#include "LinearArena.h"
+#include "Profiler.h"
 
 #include <iostream>
 
@@ -9,17 +11,22 @@
 
 LeafQuadrant::LeafQuadrant(Vec3& minBounds, Vec3& maxBounds, Quadtree& tree)
 	: Quadrant(minBounds, maxBounds, tree)
-	, mCubesInSegment()
-	, mCubesInBoundry()
+	, mRegion()
+	, mCubesInSegment(&mRegion)
+	, mCubesInBoundry(&mRegion)
 	, mCubesToAddToQuadrant()
 	, mCubesToAddToQuadrantFillCount(0)
 	, mCubeIDsMovedOutOfQuadrant()
 	, mCubesMovedOutOfQuadrentIndex(0)
 	, mNeighbours {nullptr, nullptr, nullptr, nullptr}
-	, mQueuedCubeBlockingMutex()
-	, mModifyingMutex()
+	, mHomeNode(0)
+	, mQueuedCubeBlockingMutex("LeafQueuedCubes")
+	, mModifyingMutex("LeafModifying")
+	, mFrameMetrics()
+	, mIncomingDrops(0)
 {
-
+	// Only the thread processing this leaf grows its lists, so the region does not need its own mutex
+	mRegion.Init(Memory::kBytesAllocatedPerLeafRegion, Memory::kBytesAllocatedForLeafFreeArray, false);
 }
 
 // ----------------------------------------------
@@ -44,7 +51,10 @@ void LeafQuadrant::AddCube(unsigned int cubeIndex)
 bool LeafQuadrant::QueueCubeToAdd(unsigned int cubeIndex)
 {
 	if (mCubesToAddToQuadrantFillCount >= MaxCubeTransferRate)
+	{
+		mIncomingDrops.fetch_add(1, std::memory_order_relaxed);
 		return false;
+	}
 
 	mQueuedCubeBlockingMutex.lock();
 		mCubesToAddToQuadrant[mCubesToAddToQuadrantFillCount] = { cubeIndex, false };
@@ -59,7 +69,10 @@ bool LeafQuadrant::QueueCubeToAdd(unsigned int cubeIndex)
 void LeafQuadrant::AddCubeToBoundaries(unsigned int cubeID)
 {
 	if (mCubesToAddToQuadrantFillCount >= MaxCubeTransferRate)
+	{
+		mIncomingDrops.fetch_add(1, std::memory_order_relaxed);
 		return;
+	}
 
 	mQueuedCubeBlockingMutex.lock();
 		mCubesToAddToQuadrant[mCubesToAddToQuadrantFillCount] = { cubeID, true };
@@ -84,7 +97,10 @@ void LeafQuadrant::HandleSegmentCube(Box* cube, unsigned int cubeID, unsigned in
 		{
 			// See if we have any spaces left for cubes to be removed
 			if (mCubesMovedOutOfQuadrentIndex >= MaxCubeTransferRate)
+			{
+				mFrameMetrics.mMigrationDrops++;
 				return;
+			}
 
 			bool goneIntoNeighbour = false;
 
@@ -190,7 +206,10 @@ bool LeafQuadrant::HandleBorderCube(Box* cube, unsigned int cubeID, unsigned int
 	if (!InBounds(cubePosition))
 	{
 		if (mCubesMovedOutOfQuadrentIndex >= MaxCubeTransferRate)
+		{
+			mFrameMetrics.mMigrationDrops++;
 			return false;
+		}
 
 		// Find where it has gone to and add it there
 		for (unsigned int i = 0; i < 4; i++)
@@ -244,6 +263,8 @@ void LeafQuadrant::AddPendingCubes()
 {
 	mQueuedCubeBlockingMutex.lock();
 
+		mFrameMetrics.mCubesMigratedIn += mCubesToAddToQuadrantFillCount;
+
 		// First add the boxes that are queued up to be added to this quadrant
 		for (unsigned int i = 0; i < mCubesToAddToQuadrantFillCount; i++)
 		{
@@ -284,6 +305,8 @@ void LeafQuadrant::RemoveCubesMarked()
 	if (mCubesMovedOutOfQuadrentIndex == 0)
 		return;
 
+	mFrameMetrics.mCubesMigratedOut += mCubesMovedOutOfQuadrentIndex;
+
 	mModifyingMutex.lock();
 
 		// Now handkle cubes that have moved out of the segment
@@ -415,13 +438,33 @@ void LeafQuadrant::HandleCubesTransitioning()
 
 void LeafQuadrant::Update(const float deltaTime)
 {
-	AddPendingCubes();
+	{
+		PROFILE_ZONE("AddPendingCubes");
+		ScopedTiming<ThreadedTimeTracker> timing(mTreePartOf.GetLeafStageTracker(LeafStage::AddPending));
+		ScopedTiming<PerfStageCounters>   counters(mTreePartOf.GetLeafStagePerfCounters(LeafStage::AddPending));
+		AddPendingCubes();
+	}
 
-	UpdatePhysics(deltaTime);
+	{
+		PROFILE_ZONE("UpdatePhysics");
+		ScopedTiming<ThreadedTimeTracker> timing(mTreePartOf.GetLeafStageTracker(LeafStage::Physics));
+		ScopedTiming<PerfStageCounters>   counters(mTreePartOf.GetLeafStagePerfCounters(LeafStage::Physics));
+		UpdatePhysics(deltaTime);
+	}
 
-	HandleCubesTransitioning();
+	{
+		PROFILE_ZONE("HandleCubesTransitioning");
+		ScopedTiming<ThreadedTimeTracker> timing(mTreePartOf.GetLeafStageTracker(LeafStage::Transitions));
+		ScopedTiming<PerfStageCounters>   counters(mTreePartOf.GetLeafStagePerfCounters(LeafStage::Transitions));
+		HandleCubesTransitioning();
+	}
 
-	RemoveCubesMarked();
+	{
+		PROFILE_ZONE("RemoveCubesMarked");
+		ScopedTiming<ThreadedTimeTracker> timing(mTreePartOf.GetLeafStageTracker(LeafStage::RemoveMarked));
+		ScopedTiming<PerfStageCounters>   counters(mTreePartOf.GetLeafStagePerfCounters(LeafStage::RemoveMarked));
+		RemoveCubesMarked();
+	}
 }
 
 // ----------------------------------------------
@@ -436,13 +479,94 @@ void LeafQuadrant::SetNeighbours(LeafQuadrant* neighbours[4])
 
 // ----------------------------------------------
 
+void LeafQuadrant::Reset()
+{
+	mQueuedCubeBlockingMutex.lock();
+	mModifyingMutex.lock();
+
+		// Replace the lists so that they let go of their storage, then throw away anything left in the region
+		mCubesInSegment = SegmentList(&mRegion);
+		mCubesInBoundry = BoundaryList(&mRegion);
+
+		mRegion.Reset();
+
+		mCubesToAddToQuadrantFillCount = 0;
+		mCubesMovedOutOfQuadrentIndex  = 0;
+
+	mModifyingMutex.unlock();
+	mQueuedCubeBlockingMutex.unlock();
+}
+
+// ----------------------------------------------
+
+size_t LeafQuadrant::Compact(size_t maxBytesToMove, unsigned int maxBlocksToVisit)
+{
+	size_t bytesMoved = mRegion.Compact(maxBytesToMove, maxBlocksToVisit);
+
+	if (bytesMoved > 0)
+		RefreshLists();
+
+	return bytesMoved;
+}
+
+// ----------------------------------------------
+
+void LeafQuadrant::RefreshLists()
+{
+#if UseMovableLeafLists
+	mCubesInSegment.Refresh();
+	mCubesInBoundry.Refresh();
+#endif
+}
+
+// ----------------------------------------------
+
+void LeafQuadrant::SetHomeNode(unsigned int node)
+{
+	mHomeNode = node;
+
+	// Take the region out of the node's pool, so that the lists are physically on the same node as the workers that process them
+	mRegion.InitFromParent(Memory::MemoryPool::GetForNode(node), Memory::kBytesAllocatedPerLeafRegion, Memory::kBytesAllocatedForLeafFreeArray, false);
+}
+
+// ----------------------------------------------
+
 void LeafQuadrant::ThreadUpdate(const float deltaTime)
 {
+	PROFILE_ZONE("LeafUpdate");
+
+	uint64_t jobStart = CycleClock::Start();
+
 	// Now call update
 	Update(deltaTime);
 
 	// Now check collisions in this quadrant
-	CheckCollisions();
+	{
+		PROFILE_ZONE("CheckCollisions");
+		ScopedTiming<ThreadedTimeTracker> timing(mTreePartOf.GetLeafStageTracker(LeafStage::Collisions));
+		ScopedTiming<PerfStageCounters>   counters(mTreePartOf.GetLeafStagePerfCounters(LeafStage::Collisions));
+		CheckCollisions();
+	}
+
+	mFrameMetrics.mCubesInSegment  = (unsigned int)mCubesInSegment.size();
+	mFrameMetrics.mCubesInBoundary = (unsigned int)mCubesInBoundry.size();
+	mFrameMetrics.mJobNanoseconds  = CycleClock::ToNanoseconds(CycleClock::Stop() - jobStart);
+}
+
+// ----------------------------------------------
+
+LeafFrameMetrics LeafQuadrant::TakeFrameMetrics()
+{
+	LeafFrameMetrics metrics = mFrameMetrics;
+
+	metrics.mMigrationDrops += mIncomingDrops.exchange(0, std::memory_order_relaxed);
+
+	// The sizes carry over, as a leaf that has not been run since still holds the same cubes
+	mFrameMetrics                  = LeafFrameMetrics();
+	mFrameMetrics.mCubesInSegment  = metrics.mCubesInSegment;
+	mFrameMetrics.mCubesInBoundary = metrics.mCubesInBoundary;
+
+	return metrics;
 }
 
 // ----------------------------------------------
@@ -455,6 +579,10 @@ void LeafQuadrant::CheckCollisions()
 	unsigned int cubeCount     = (unsigned int)mCubesInSegment.size();
 	unsigned int boundaryCount = (unsigned int)mCubesInBoundry.size();
 
+	// Counted locally and added on at the end, so the inner loops are not writing through this
+	unsigned int pairTests     = 0;
+	unsigned int contacts      = 0;
+
 	// Collisions within this segment - this includes all of the boundary cubes
 	for (unsigned int i = 0; i < cubeCount; i++)
 	{
@@ -475,18 +603,22 @@ void LeafQuadrant::CheckCollisions()
 			if (!cubeTwo)
 				continue;
 
+			pairTests++;
+
 			// Check for a collision
 			if (cubeOne->CheckCollision(*cubeTwo))
 			{
 				// Handle the collision if it does happen
 				Box::ResolveCollision(*cubeOne, *cubeTwo);
+				contacts++;
 				break;
 			}
 		}
 	}
 
-	std::vector<int>                  neighbourBounaryCubes;
-	std::vector<std::pair<int, bool>> neighbourSegmentCubes;
+	// Only needed for this frame, so taken from this thread's frame arena rather than the global allocator
+	std::vector<int,                  Memory::FrameArenaAllocator<int>>                  neighbourBounaryCubes;
+	std::vector<std::pair<int, bool>, Memory::FrameArenaAllocator<std::pair<int, bool>>> neighbourSegmentCubes;
 
 	// Now check the boundary cubes against the neighbour's boundary cubes
 	for (unsigned int i = 0; i < boundaryCount; i++)
@@ -501,12 +633,12 @@ void LeafQuadrant::CheckCollisions()
 			if (mNeighbours[j])
 			{
 				// Lock the mutex to make sure that the data will not be in an invalid state while we copy it
-				std::mutex& neighbourMutex = mNeighbours[j]->GetModifyingMutex();
+				Profiling::ProfiledMutex& neighbourMutex = mNeighbours[j]->GetModifyingMutex();
 
 				neighbourMutex.lock();
 
-					neighbourBounaryCubes = mNeighbours[j]->GetBoundaryCubes();
-					neighbourSegmentCubes = mNeighbours[j]->GetSegmentCubes();
+					neighbourBounaryCubes.assign(mNeighbours[j]->GetBoundaryCubes().begin(), mNeighbours[j]->GetBoundaryCubes().end());
+					neighbourSegmentCubes.assign(mNeighbours[j]->GetSegmentCubes().begin(),  mNeighbours[j]->GetSegmentCubes().end());
 
 					unsigned int boundaryCubeCount = (unsigned int)neighbourBounaryCubes.size();
 
@@ -525,10 +657,13 @@ void LeafQuadrant::CheckCollisions()
 					if (!cubeTwo)
 						continue;
 
+					pairTests++;
+
 					if (cube->CheckCollision(*cubeTwo))
 					{
 						// Handle the collision if it does happen
 						Box::ResolveCollision(*cube, *cubeTwo);
+						contacts++;
 
 						break;
 					}
@@ -538,6 +673,9 @@ void LeafQuadrant::CheckCollisions()
 			}
 		}
 	}
+
+	mFrameMetrics.mPairTests        += pairTests;
+	mFrameMetrics.mContactsResolved += contacts;
 }
 
 // ----------------------------------------------
\ No newline at end of file
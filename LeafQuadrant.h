@@ -5,13 +5,30 @@
 
 #include "Commons.h"
 #include "TimeTracker.h"
+#include "MovableArray.h"
+#include "RegionAllocator.h"
+#include "GrowableArray.h"
+#include "LeafMetrics.h"
+#include "LockProfiler.h"
 
 #include <vector>
 #include <mutex>
+#include <atomic>
 
 class LeafQuadrant final : public Quadrant
 {
 public:
+	// The leaf's lists all come out of its own region so that they sit next to each other in memory
+#if UseMovableLeafLists
+	// Movable, so that the holes they leave behind as they grow can be closed up between frames
+	using BoundaryList = Memory::MovableArray<int,                  Memory::MemoryTag::LeafLists>;
+	using SegmentList  = Memory::MovableArray<std::pair<int, bool>, Memory::MemoryTag::LeafLists>;
+#else
+	// GrowableArray rather than std::vector, so that a list growing into the free space after it does not have to be copied
+	using BoundaryList = Memory::GrowableArray<int,                  Memory::RegionAllocator<int,                  Memory::MemoryPool, Memory::MemoryTag::LeafLists>>;
+	using SegmentList  = Memory::GrowableArray<std::pair<int, bool>, Memory::RegionAllocator<std::pair<int, bool>, Memory::MemoryPool, Memory::MemoryTag::LeafLists>>;
+#endif
+
 	LeafQuadrant(Vec3& minBounds, Vec3& maxBounds, Quadtree& tree);
 	~LeafQuadrant() override;
 
@@ -26,13 +43,30 @@ public:
 
 	void        SetNeighbours(LeafQuadrant* neighbours[4]);
 
+	// Empties the leaf and releases everything in its region in one go
+	void        Reset();
+
+	// Closes up the holes in the leaf's region, and picks the lists' new addresses up. Nothing may be using the lists while
+	// this runs - including neighbours - so it is only called between frames. Returns the bytes moved
+	size_t      Compact(size_t maxBytesToMove, unsigned int maxBlocksToVisit);
+
+	// For after the pool the lists fell back onto has been compacted
+	void        RefreshLists();
+
+	// Moves the leaf's region onto the given NUMA node's pool - must be called while the leaf is still empty
+	void         SetHomeNode(unsigned int node);
+	unsigned int GetHomeNode() const { return mHomeNode; }
+
 	//std::vector<int>                  GetBoundaryCubes() { return mCubesInBoundry; }
 	//std::vector<std::pair<int, bool>> GetSegmentCubes()  { return mCubesInSegment; }
 
-	std::vector<int>&                  GetBoundaryCubes() { return mCubesInBoundry; }
-	std::vector<std::pair<int, bool>>& GetSegmentCubes()  { return mCubesInSegment; }
+	BoundaryList& GetBoundaryCubes() { return mCubesInBoundry; }
+	SegmentList&  GetSegmentCubes()  { return mCubesInSegment; }
+
+	Profiling::ProfiledMutex& GetModifyingMutex() { return mModifyingMutex; }
 
-	std::mutex& GetModifyingMutex() { return mModifyingMutex; }
+	// What the leaf has done since the last call, and starts counting again - only called between frames
+	LeafFrameMetrics TakeFrameMetrics();
 
 private:
 	bool HandleBorderCube(Box* cube, unsigned int cubeID, unsigned int internalID);
@@ -43,8 +77,10 @@ private:
 	void RemoveCubesMarked();
 	void HandleCubesTransitioning();
 
-	std::vector<std::pair<int, bool>>          mCubesInSegment; // ID points to a cube in the tree's list - second says if it is in the boundary or not
-	std::vector<int>                           mCubesInBoundry; // ID points to an index in the mCubesInSegment list
+	Memory::MemoryPool                         mRegion;         // Must be declared before the lists, so that it outlives them
+
+	SegmentList                                mCubesInSegment; // ID points to a cube in the tree's list - second says if it is in the boundary or not
+	BoundaryList                               mCubesInBoundry; // ID points to an index in the mCubesInSegment list
 
 	std::pair<unsigned int, bool>              mCubesToAddToQuadrant[MaxCubeTransferRate];      // ID points to a cube in the tree's list
 	unsigned int                               mCubesToAddToQuadrantFillCount;                  // The amount of elements in the array on the line above
@@ -53,6 +89,10 @@ private:
 	unsigned int                               mCubesMovedOutOfQuadrentIndex;                   // The amount of elements in the array on the line above
 
 	LeafQuadrant*                              mNeighbours[4];
-	std::mutex                                 mQueuedCubeBlockingMutex; // Mutex so that external calls cannot add cubes while we are clearing them up/adding them
-	std::mutex                                 mModifyingMutex;          // Mutex so that external calls cannot copy a list while it is in an invalid state
+	unsigned int                               mHomeNode;                // The NUMA node this leaf's data lives on, and which workers prefer to pick it up
+	Profiling::ProfiledMutex                   mQueuedCubeBlockingMutex; // Mutex so that external calls cannot add cubes while we are clearing them up/adding them
+	Profiling::ProfiledMutex                   mModifyingMutex;          // Mutex so that external calls cannot copy a list while it is in an invalid state
+
+	LeafFrameMetrics                           mFrameMetrics;            // Only written by the worker running this leaf
+	std::atomic<unsigned int>                  mIncomingDrops;           // Cubes other leaves could not queue onto this one - they run on other workers
 };
\ No newline at end of file
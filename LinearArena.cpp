@@ -0,0 +1,257 @@
+#include "LinearArena.h"
+#include "Commons.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <new>
+
+#if MemoryOverride && CountFrameAllocations
+	#include "AllocationCounter.h"
+#endif
+
+namespace Memory
+{
+	LinearArena*              FrameArena::sArenas[kMaxFrameArenas]     = { nullptr };
+	std::atomic<bool>         FrameArena::sArenaTaken[kMaxFrameArenas] = { };
+	std::atomic<unsigned int> FrameArena::sArenaCount(0);
+
+	thread_local LinearArena* FrameArena::sThisThreadsArena = nullptr;
+	thread_local unsigned int FrameArena::sThisThreadsSlot  = 0;
+
+	// -------------------------------------------------------------------------
+
+	// Only made on threads that have taken an arena - its destructor runs as the thread exits, and hands the arena back
+	struct FrameArenaReleaser
+	{
+		~FrameArenaReleaser() { FrameArena::ReleaseForThisThread(); }
+	};
+
+	static thread_local FrameArenaReleaser tFrameArenaReleaser;
+
+	// -------------------------------------------------------------------------
+
+	static inline char* AlignPointer(char* pointer, size_t alignment)
+	{
+		return (char*)(((uintptr_t)pointer + (alignment - 1)) & ~((uintptr_t)alignment - 1));
+	}
+
+	// -------------------------------------------------------------------------
+
+	LinearArena::LinearArena()
+		: mStart(nullptr)
+		, mCurrent(nullptr)
+		, mEnd(nullptr)
+
+		, mOverflowChunks(nullptr)
+		, mOverflowCurrent(nullptr)
+		, mOverflowEnd(nullptr)
+		, mOverflowBytesUsed(0)
+	{
+
+	}
+
+	// -------------------------------------------------------------------------
+
+	LinearArena::~LinearArena()
+	{
+		Reset();
+
+		free(mStart);
+	}
+
+	// -------------------------------------------------------------------------
+
+	void LinearArena::Init(size_t bytes)
+	{
+		// Grabbed straight from malloc so that setting up an arena never recurses back into the new override
+		mStart   = (char*)malloc(bytes);
+		mCurrent = mStart;
+		mEnd     = mStart ? mStart + bytes : nullptr;
+	}
+
+	// -------------------------------------------------------------------------
+
+	void* LinearArena::Allocate(size_t size, size_t alignment)
+	{
+		char* alignedCurrent = AlignPointer(mCurrent, alignment);
+
+		// Fast path - fits in the main chunk
+		if (mStart && alignedCurrent + size <= mEnd)
+		{
+			mCurrent = alignedCurrent + size;
+
+			return alignedCurrent;
+		}
+
+		return AllocateFromOverflow(size, alignment);
+	}
+
+	// -------------------------------------------------------------------------
+
+	void* LinearArena::AllocateFromOverflow(size_t size, size_t alignment)
+	{
+		char* alignedCurrent = AlignPointer(mOverflowCurrent, alignment);
+
+		if (!mOverflowChunks || alignedCurrent + size > mOverflowEnd)
+		{
+			// Chain on a new chunk that is at least as large as the main one
+			size_t capacity = GetBytesCapacity();
+
+			if (capacity < size + alignment)
+				capacity = size + alignment;
+
+			LinearArenaOverflowChunk* chunk = (LinearArenaOverflowChunk*)malloc(sizeof(LinearArenaOverflowChunk) + capacity);
+
+#if MemoryOverride && CountFrameAllocations
+			// Straight from malloc, so the overrides never see it - but it is still the heap, in the middle of a frame
+			Memory::AllocationCounter::RecordAllocation(sizeof(LinearArenaOverflowChunk) + capacity);
+#endif
+
+			if (!chunk)
+			{
+				assert("Out of memory" && false);
+				return nullptr;
+			}
+
+			chunk->mNext      = mOverflowChunks;
+			chunk->mCapacity  = capacity;
+			mOverflowChunks   = chunk;
+
+			mOverflowCurrent  = (char*)(chunk + 1);
+			mOverflowEnd      = mOverflowCurrent + capacity;
+
+			alignedCurrent    = AlignPointer(mOverflowCurrent, alignment);
+		}
+
+		mOverflowBytesUsed += (size_t)(alignedCurrent + size - mOverflowCurrent);
+		mOverflowCurrent    = alignedCurrent + size;
+
+		return alignedCurrent;
+	}
+
+	// -------------------------------------------------------------------------
+
+	void LinearArena::Reset()
+	{
+		// If this frame needed more than the main chunk, then grow the main chunk so that the next frame stays on the fast path
+		if (mOverflowChunks)
+		{
+			size_t newCapacity = GetBytesCapacity() + mOverflowBytesUsed;
+
+			while (mOverflowChunks)
+			{
+				LinearArenaOverflowChunk* next = mOverflowChunks->mNext;
+
+				free(mOverflowChunks);
+
+#if MemoryOverride && CountFrameAllocations
+				Memory::AllocationCounter::RecordFree();
+#endif
+
+				mOverflowChunks = next;
+			}
+
+			mOverflowCurrent   = nullptr;
+			mOverflowEnd       = nullptr;
+			mOverflowBytesUsed = 0;
+
+			free(mStart);
+			Init(newCapacity);
+
+#if MemoryOverride && CountFrameAllocations
+			Memory::AllocationCounter::RecordFree();
+			Memory::AllocationCounter::RecordAllocation(newCapacity);
+#endif
+		}
+
+		mCurrent = mStart;
+	}
+
+	// -------------------------------------------------------------------------
+
+	LinearArena* FrameArena::GetForThisThread()
+	{
+		if (sThisThreadsArena)
+			return sThisThreadsArena;
+
+		// First time this thread has needed scratch memory - take the first free slot, reusing the arena of whichever
+		// thread had it last. Anything left in it is rewound with the rest at the next ResetAll
+		unsigned int index = 0;
+
+		for (; index < kMaxFrameArenas; index++)
+		{
+			bool expected = false;
+
+			if (sArenaTaken[index].compare_exchange_strong(expected, true, std::memory_order_acquire))
+				break;
+		}
+
+		// Handing back nullptr would only move the crash into whichever container asked, so stop here instead
+		if (index >= kMaxFrameArenas)
+		{
+			fprintf(stderr, "Out of frame arenas - more than %u threads are using them at once\n", kMaxFrameArenas);
+			abort();
+		}
+
+		if (!sArenas[index])
+		{
+			LinearArena* arena = (LinearArena*)malloc(sizeof(LinearArena));
+
+			if (!arena)
+			{
+				fprintf(stderr, "Could not allocate a frame arena\n");
+				abort();
+			}
+
+			new (arena) LinearArena();
+			arena->Init(kBytesAllocatedPerFrameArena);
+
+			sArenas[index] = arena;
+
+			// Registered once it is setup, so that ResetAll never sees a half made arena
+			unsigned int arenaCount = sArenaCount.load();
+
+			while (arenaCount < index + 1 && !sArenaCount.compare_exchange_weak(arenaCount, index + 1))
+			{ }
+		}
+
+		sThisThreadsArena = sArenas[index];
+		sThisThreadsSlot  = index;
+
+		// Touching it is what makes it, so that it is only destroyed on threads that have an arena
+		(void)&tFrameArenaReleaser;
+
+		return sThisThreadsArena;
+	}
+
+	// -------------------------------------------------------------------------
+
+	void FrameArena::ReleaseForThisThread()
+	{
+		if (!sThisThreadsArena)
+			return;
+
+		sThisThreadsArena = nullptr;
+
+		sArenaTaken[sThisThreadsSlot].store(false, std::memory_order_release);
+	}
+
+	// -------------------------------------------------------------------------
+
+	void FrameArena::ResetAll()
+	{
+		unsigned int arenaCount = sArenaCount.load();
+
+		if (arenaCount > kMaxFrameArenas)
+			arenaCount = kMaxFrameArenas;
+
+		for (unsigned int i = 0; i < arenaCount; i++)
+		{
+			if (sArenas[i])
+				sArenas[i]->Reset();
+		}
+	}
+
+	// -------------------------------------------------------------------------
+}
\ No newline at end of file
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <malloc.h>
+#include <assert.h>
+
+#include <atomic>
+#include <mutex>
+
+namespace Memory
+{
+	// ----------------------------------------------------------
+
+	// Each thread starts with this much scratch space per frame - grows on the next reset if a frame overflows it
+	constexpr unsigned int kBytesAllocatedPerFrameArena = 1024 * 1024;
+
+	// Upper limit on the amount of threads that can own a frame arena at the same time - arenas are handed on as threads exit
+	constexpr unsigned int kMaxFrameArenas              = 64;
+
+	// ----------------------------------------------------------
+
+	// Extra space chained on when the main chunk runs out part way through a frame
+	struct LinearArenaOverflowChunk
+	{
+		LinearArenaOverflowChunk* mNext;
+		size_t                    mCapacity;
+	};
+
+	// ----------------------------------------------------------
+
+	// Bump allocator - allocating is a pointer increment, and nothing is freed until Reset() drops everything at once
+	class LinearArena
+	{
+	public:
+		LinearArena();
+		~LinearArena();
+
+		void   Init(size_t bytes);
+
+		void*  Allocate(size_t size, size_t alignment);
+		void   Reset();
+
+		size_t GetBytesUsed()     const { return (size_t)(mCurrent - mStart) + mOverflowBytesUsed; }
+		size_t GetBytesCapacity() const { return (size_t)(mEnd - mStart); }
+
+	private:
+		void*  AllocateFromOverflow(size_t size, size_t alignment);
+
+		char*                     mStart;
+		char*                     mCurrent;
+		char*                     mEnd;
+
+		LinearArenaOverflowChunk* mOverflowChunks;     // Freed on reset, and the main chunk is grown so that it does not happen again
+		char*                     mOverflowCurrent;
+		char*                     mOverflowEnd;
+		size_t                    mOverflowBytesUsed;
+	};
+
+	// ----------------------------------------------------------
+
+	// One linear arena per thread, all of which get reset together once the frame's jobs are finished. A thread's arena
+	// goes back into the set when the thread exits and the next new thread takes it over, so short lived workers
+	// (e.g. a Quadtree per benchmark run) do not use the arenas up
+	class FrameArena
+	{
+	public:
+		static LinearArena* GetForThisThread();
+
+		// Must only be called when no thread is holding onto frame memory - e.g. at the end of Quadtree::Update
+		static void         ResetAll();
+
+		// Called as the thread exits, so nothing it allocated from its arena can still be in use
+		static void         ReleaseForThisThread();
+
+	private:
+		static LinearArena*              sArenas[kMaxFrameArenas];
+		static std::atomic<bool>         sArenaTaken[kMaxFrameArenas];
+		static std::atomic<unsigned int> sArenaCount;                  // How many slots have ever had an arena made in them
+
+		static thread_local LinearArena* sThisThreadsArena;
+		static thread_local unsigned int sThisThreadsSlot;
+	};
+
+	// ----------------------------------------------------------
+
+	// STL adapter so that containers used for a single frame take their memory from the calling thread's frame arena
+	// Deallocation does nothing - the memory comes back when the arenas are reset
+	template<typename T>
+	class FrameArenaAllocator
+	{
+	public:
+		using value_type                             = T;
+		using is_always_equal                        = std::true_type;
+		using propagate_on_container_move_assignment = std::true_type;
+
+		FrameArenaAllocator() noexcept { }
+
+		template<typename U>
+		FrameArenaAllocator(const FrameArenaAllocator<U>&) noexcept { }
+
+		T* allocate(size_t count)
+		{
+			return (T*)FrameArena::GetForThisThread()->Allocate(count * sizeof(T), alignof(T));
+		}
+
+		void deallocate(T*, size_t) noexcept { }
+
+		template<typename U>
+		bool operator==(const FrameArenaAllocator<U>&) const noexcept { return true; }
+
+		template<typename U>
+		bool operator!=(const FrameArenaAllocator<U>&) const noexcept { return false; }
+	};
+
+	// ----------------------------------------------------------
+}
\ No newline at end of file
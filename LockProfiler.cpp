@@ -0,0 +1,200 @@
+#include "LockProfiler.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+
+#include <string.h>
+
+namespace Profiling
+{
+	// ----------------------------------------------------------
+
+	namespace LockProfiler
+	{
+		// What the totals were at the end of the last window, so each report only covers its own frames
+		struct LockWindowTotals
+		{
+			uint64_t mAcquisitions;
+			uint64_t mContendedAcquisitions;
+			uint64_t mWaitCycles;
+		};
+
+		struct LockWindowReport
+		{
+			const char* mName;
+			uint64_t    mAcquisitions;
+			uint64_t    mContendedAcquisitions;
+			uint64_t    mWaitCycles;
+			uint64_t    mMaxHoldCycles;
+		};
+
+		static LockStats             sLockStats[kMaxNamedLocks];
+		static std::atomic<unsigned> sLockStatsCount(0);
+		static std::mutex            sLockStatsMutex;  // Only taken when a mutex is made, to look up its name
+
+		static LockWindowTotals      sLastWindowTotals[kMaxNamedLocks];
+		static unsigned int          sFramesInWindow = 0;
+
+		// ----------------------------------------------------------
+
+		LockStats* GetStats(const char* name)
+		{
+			std::lock_guard<std::mutex> lock(sLockStatsMutex);
+
+			unsigned int count = sLockStatsCount.load(std::memory_order_relaxed);
+
+			for (unsigned int i = 0; i < count; i++)
+			{
+				if (strcmp(sLockStats[i].mName, name) == 0)
+					return &sLockStats[i];
+			}
+
+			// Out of room - everything else shares the last one rather than going uncounted
+			if (count == kMaxNamedLocks - 1)
+			{
+				sLockStats[count].mName = "(other)";
+				sLockStatsCount.store(kMaxNamedLocks, std::memory_order_release);
+
+				return &sLockStats[count];
+			}
+
+			if (count == kMaxNamedLocks)
+				return &sLockStats[kMaxNamedLocks - 1];
+
+			sLockStats[count].mName = name;
+			sLockStatsCount.store(count + 1, std::memory_order_release);
+
+			return &sLockStats[count];
+		}
+
+		// ----------------------------------------------------------
+
+		void NextFrame()
+		{
+			if (++sFramesInWindow < LockContentionWindowFrames)
+				return;
+
+			LockWindowReport reports[kMaxNamedLocks];
+			unsigned int     count = sLockStatsCount.load(std::memory_order_acquire);
+
+			for (unsigned int i = 0; i < count; i++)
+			{
+				LockStats&        stats = sLockStats[i];
+				LockWindowTotals& last  = sLastWindowTotals[i];
+
+				LockWindowTotals  now   = { stats.mAcquisitions.load(std::memory_order_relaxed), stats.mContendedAcquisitions.load(std::memory_order_relaxed),
+				                            stats.mWaitCycles.load(std::memory_order_relaxed) };
+
+				reports[i].mName                  = stats.mName;
+				reports[i].mAcquisitions          = now.mAcquisitions          - last.mAcquisitions;
+				reports[i].mContendedAcquisitions = now.mContendedAcquisitions - last.mContendedAcquisitions;
+				reports[i].mWaitCycles            = now.mWaitCycles            - last.mWaitCycles;
+				reports[i].mMaxHoldCycles         = stats.mMaxHoldCycles.exchange(0, std::memory_order_relaxed);
+
+				last = now;
+			}
+
+			std::sort(reports, reports + count, [](const LockWindowReport& a, const LockWindowReport& b)
+			{
+				return a.mWaitCycles > b.mWaitCycles;
+			});
+
+			double microsecondsPerCycle = CycleClock::GetNanosecondsPerCycle() / 1000.0;
+
+			std::cout << "Lock contention over the last " << sFramesInWindow << " frames, by time spent waiting" << std::endl;
+			std::cout << std::left << std::setw(20) << "Lock" << std::right << std::setw(12) << "Taken" << std::setw(12) << "Contended"
+			          << std::setw(13) << "Contended %" << std::setw(12) << "Wait ms" << std::setw(16) << "Wait us/frame" << std::setw(14) << "Max hold us" << std::endl;
+
+			unsigned int reportCount = std::min(count, (unsigned int)LockContentionReportCount);
+
+			for (unsigned int i = 0; i < reportCount; i++)
+			{
+				const LockWindowReport& report = reports[i];
+
+				if (report.mAcquisitions == 0)
+					continue;
+
+				double waitMicroseconds = (double)report.mWaitCycles * microsecondsPerCycle;
+
+				std::cout << std::left << std::setw(20) << report.mName << std::right << std::setw(12) << report.mAcquisitions
+				          << std::setw(12) << report.mContendedAcquisitions << std::fixed << std::setprecision(2)
+				          << std::setw(13) << ((double)report.mContendedAcquisitions * 100.0) / (double)report.mAcquisitions
+				          << std::setw(12) << waitMicroseconds / 1000.0
+				          << std::setw(16) << waitMicroseconds / sFramesInWindow
+				          << std::setw(14) << (double)report.mMaxHoldCycles * microsecondsPerCycle << std::endl;
+			}
+
+			sFramesInWindow = 0;
+		}
+	}
+
+	// ----------------------------------------------------------
+
+	ProfiledMutex::ProfiledMutex(const char* name)
+#if ProfileLockContention
+		: mStats(LockProfiler::GetStats(name))
+		, mAcquiredCycles(0)
+		, mMutex()
+#else
+		: mMutex()
+#endif
+	{
+		(void)name;
+	}
+
+	// ----------------------------------------------------------
+
+#if ProfileLockContention
+	void ProfiledMutex::ProfiledLock()
+	{
+		// Taking it straight away is the common case, and costs no more than the plain mutex would
+		if (mMutex.try_lock())
+		{
+			mAcquiredCycles = CycleClock::Start();
+		}
+		else
+		{
+			uint64_t waitStart = CycleClock::Start();
+
+			mMutex.lock();
+
+			mAcquiredCycles = CycleClock::Stop();
+
+			mStats->mContendedAcquisitions.fetch_add(1, std::memory_order_relaxed);
+			mStats->mWaitCycles.fetch_add(mAcquiredCycles - waitStart, std::memory_order_relaxed);
+		}
+
+		mStats->mAcquisitions.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	// ----------------------------------------------------------
+
+	bool ProfiledMutex::ProfiledTryLock()
+	{
+		if (!mMutex.try_lock())
+			return false;
+
+		mAcquiredCycles = CycleClock::Start();
+
+		mStats->mAcquisitions.fetch_add(1, std::memory_order_relaxed);
+
+		return true;
+	}
+
+	// ----------------------------------------------------------
+
+	void ProfiledMutex::ProfiledUnlock()
+	{
+		uint64_t holdCycles = CycleClock::Stop() - mAcquiredCycles;
+		uint64_t maxHold    = mStats->mMaxHoldCycles.load(std::memory_order_relaxed);
+
+		while (holdCycles > maxHold && !mStats->mMaxHoldCycles.compare_exchange_weak(maxHold, holdCycles, std::memory_order_relaxed))
+		{ }
+
+		mMutex.unlock();
+	}
+#endif
+
+	// ----------------------------------------------------------
+}
\ No newline at end of file
@@ -0,0 +1,95 @@
+#pragma once
+
+#include "Commons.h"
+#include "TimeTracker.h"
+
+#include <stdint.h>
+
+#include <atomic>
+#include <mutex>
+
+namespace Profiling
+{
+	// ----------------------------------------------------------
+
+	constexpr unsigned int kMaxNamedLocks = 32; // The last one collects every name past the rest
+
+	// ----------------------------------------------------------
+
+	// Totals for every mutex sharing a name - e.g. all of the leaves' modifying mutexes are counted as one lock
+	struct LockStats
+	{
+		const char*           mName;
+		std::atomic<uint64_t> mAcquisitions;
+		std::atomic<uint64_t> mContendedAcquisitions; // Ones that found the mutex already held and had to wait
+		std::atomic<uint64_t> mWaitCycles;
+		std::atomic<uint64_t> mMaxHoldCycles;         // Since the last report
+	};
+
+	// ----------------------------------------------------------
+
+	namespace LockProfiler
+	{
+		// The stats for name, added the first time it is asked for. The name must outlive the program, so it is always a string literal
+		LockStats* GetStats(const char* name);
+
+		// Called once a frame by the thread that drives the frames. Every LockContentionWindowFrames frames, prints the
+		// LockContentionReportCount locks that were waited on longest over those frames
+		void       NextFrame();
+	}
+
+	// ----------------------------------------------------------
+
+	// A std::mutex that counts how often it is taken, how often that meant waiting, how long was spent waiting and the longest
+	// it was held for, into the stats for its name. With ProfileLockContention off it is only the mutex. Meets the standard
+	// Lockable requirements, so lock_guard and unique_lock work with it
+	class ProfiledMutex
+	{
+	public:
+		explicit ProfiledMutex(const char* name);
+
+		ProfiledMutex(const ProfiledMutex&)            = delete;
+		ProfiledMutex& operator=(const ProfiledMutex&) = delete;
+
+		void lock()
+		{
+#if ProfileLockContention
+			ProfiledLock();
+#else
+			mMutex.lock();
+#endif
+		}
+
+		bool try_lock()
+		{
+#if ProfileLockContention
+			return ProfiledTryLock();
+#else
+			return mMutex.try_lock();
+#endif
+		}
+
+		void unlock()
+		{
+#if ProfileLockContention
+			ProfiledUnlock();
+#else
+			mMutex.unlock();
+#endif
+		}
+
+	private:
+#if ProfileLockContention
+		void       ProfiledLock();
+		bool       ProfiledTryLock();
+		void       ProfiledUnlock();
+
+		LockStats* mStats;
+		uint64_t   mAcquiredCycles; // Only touched by whoever holds the mutex
+#endif
+
+		std::mutex mMutex;
+	};
+
+	// ----------------------------------------------------------
+}
\ No newline at end of file
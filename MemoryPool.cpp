@@ -2,10 +2,64 @@
 
 #include <assert.h>
 #include <memory.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <new>
+
+#ifdef _WIN32
+	#include <windows.h>
+#else
+	#include <sys/mman.h>
+	#include <fcntl.h>
+	#include <unistd.h>
+#endif
 
 namespace Memory
 {
 	MemoryPool* MemoryPool::mThis = nullptr;
+	MemoryPool* MemoryPool::mNodePools[Numa::kMaxNumaNodes] = { nullptr };
+
+	// -------------------------------------------------------------------------
+
+	// Sections of a snapshot file start on this boundary, so that the blocks can be mapped straight from the file
+	// 64KB as that is the mapping granularity on Windows - it is a whole number of pages everywhere else
+	constexpr size_t kSnapshotSectionAlignment = 64 * 1024;
+
+	static inline size_t AlignToSnapshotSection(size_t n)
+	{
+		return (n + kSnapshotSectionAlignment - 1) & ~(kSnapshotSectionAlignment - 1);
+	}
+
+	// Everything a pool needs, beyond the arena itself, to carry on from where the snapshot was taken
+	struct PoolSnapshotHeader
+	{
+		char         mMagic[4];
+		unsigned int mVersion;
+
+		size_t       mTotalBytes;
+		size_t       mBookkeepingBytes;
+		size_t       mBlockBytes;                    // From the start of the arena to the end of the last block
+
+		BlockOffset  mLastElement;
+		BlockOffset  mRoot;
+		unsigned int mFreeElementsAllocated;
+		unsigned int mSavedArraySizesCount;
+		bool         mAllocationsPopulated;
+
+		BlockOffset  mHandleTable;
+		unsigned int mHandleCount;
+		MemoryHandle mFreeHandle;
+
+		size_t       mMemoryUsed;
+		size_t       mPeakMemoryUsed;
+		size_t       mFreeBytesInBlocks;
+		size_t       mFreeBlocksPerSizeClass[kMemoryPoolSizeClasses];
+	};
+
+	constexpr unsigned int kSnapshotVersion = 2;
+
+	// Set on handle table entries that are not in use - the rest of the entry is the next unused handle. Block offsets never get this high
+	constexpr BlockOffset  kFreeHandleBit   = (BlockOffset)1 << ((sizeof(BlockOffset) * 8) - 1);
 
 	// -------------------------------------------------------------------------
 
@@ -20,11 +74,22 @@ namespace Memory
 		, mSavedArraySizes(nullptr)
 		, mSavedArraySizesCount(0)
 
+		, mHandleTable(kNoBlockOffset)
+		, mHandleCount(0)
+		, mFreeHandle(kInvalidMemoryHandle)
+		, mCompactionCursor(kNoBlockOffset)
+
 		, mBlockingMutex(nullptr)
 
-		, mMemoryUsed(0)
+		, mTotalBytes(0)
+		, mBookkeepingBytes(0)
+		, mAssertOnOutOfMemory(true)
+
+		, mBacking(PoolBacking::Malloc)
+		, mMappedBytes(0)
+		, mParentPool(nullptr)
 	{
-		
+		ResetStats();
 	}
 
 	// -------------------------------------------------------------------------
@@ -33,31 +98,593 @@ namespace Memory
 	{
 		delete mBlockingMutex;
 
-		free(mLargeDataAllocationsList);
+		FreeArena();
+	}
+
+	// -------------------------------------------------------------------------
+
+	void MemoryPool::Init(size_t totalBytes, size_t bookkeepingBytes, bool assertOnOutOfMemory, bool useHugePages)
+	{
+		// Allow re-initialising, e.g. when a leaf's region is moved onto a different node
+		FreeArena();
+
+		mLargeDataAllocationsList = (LargeDataMemoryBlock*)AllocateArena(totalBytes, useHugePages);
+
+		SetupLayout(totalBytes, bookkeepingBytes, assertOnOutOfMemory);
+	}
+
+	// -------------------------------------------------------------------------
+
+	void MemoryPool::InitOnNode(unsigned int node, size_t totalBytes, size_t bookkeepingBytes)
+	{
+		FreeArena();
+
+		mLargeDataAllocationsList = (LargeDataMemoryBlock*)Numa::AllocateOnNode(totalBytes, node);
+		mBacking                  = PoolBacking::NumaNode;
+		mMappedBytes              = totalBytes;
+
+		SetupLayout(totalBytes, bookkeepingBytes, true);
+	}
+
+	// -------------------------------------------------------------------------
+
+	void MemoryPool::InitFromParent(MemoryPool* parent, size_t totalBytes, size_t bookkeepingBytes, bool assertOnOutOfMemory)
+	{
+		FreeArena();
+
+		Profiling::ProfiledMutex* mutex = parent->GetMutex();
+
+		if (mutex)
+			mutex->lock();
+
+		// Cache line aligned so that two regions never share a line
+		mLargeDataAllocationsList = (LargeDataMemoryBlock*)parent->AssignAlignedMemory(totalBytes, 64);
+
+		if (mutex)
+			mutex->unlock();
+
+		mBacking     = PoolBacking::ParentPool;
+		mMappedBytes = totalBytes;
+		mParentPool  = parent;
+
+		SetupLayout(totalBytes, bookkeepingBytes, assertOnOutOfMemory);
 	}
 
 	// -------------------------------------------------------------------------
 
-	void MemoryPool::Init()
+	void MemoryPool::SetupLayout(size_t totalBytes, size_t bookkeepingBytes, bool assertOnOutOfMemory)
 	{
-		mLargeDataAllocationsList = (LargeDataMemoryBlock*)malloc(kBytesAllocatedForLargeAllocations);
+		mTotalBytes          = totalBytes;
+		mBookkeepingBytes    = bookkeepingBytes;
+		mAssertOnOutOfMemory = assertOnOutOfMemory;
+
+		// Start from an empty list, in case this pool is being re-initialised
+		mLargeAllocationsPopulated     = false;
+		mLastElementInLargeAllocations = nullptr;
+		mFreeElementsAllocated         = 0;
+		mSavedArraySizesCount          = 0;
 
-		// Use the last 1MB for the free blocks list 
-		mFreeLargeElementsList = (FreeMemoryBlockInfo*)(((char*)mLargeDataAllocationsList) + kBytesAllocatedForLargeAllocations - kBytesAllocatedForFreeArray);
+		ResetHandles();
+		ResetStats();
+
+		// Use the last section for the free blocks list 
+		mFreeLargeElementsList = (FreeMemoryBlockInfo*)(((char*)mLargeDataAllocationsList) + mTotalBytes - mBookkeepingBytes);
 
 		// Set all of the memory at the end to 0 (nullptr) so that we have something to check against as the array fills up
 		// Shifted by 1 as we cannot store nullptr for the first element, as that would lose the pointer to the start of the array
-		memset((char*)mFreeLargeElementsList + sizeof(FreeMemoryBlockInfo), 0, kBytesAllocatedForFreeArray - sizeof(FreeMemoryBlockInfo));
+		memset((char*)mFreeLargeElementsList + sizeof(FreeMemoryBlockInfo), 0, mBookkeepingBytes - sizeof(FreeMemoryBlockInfo));
+
+		// This is the section before the free elements array
+		mSavedArraySizes = (ArraySizingData*)(((char*)mFreeLargeElementsList) - mBookkeepingBytes);
+	}
+
+	// -------------------------------------------------------------------------
+
+	void MemoryPool::InitNodePools()
+	{
+		unsigned int nodeCount = Numa::GetNodeCount();
+
+		for (unsigned int i = 0; i < nodeCount; i++)
+		{
+			if (mNodePools[i])
+				continue;
+
+			// Setup the same way as the main pool, so that creating it does not go through the new override
+			MemoryPool* pool = (MemoryPool*)malloc(sizeof(MemoryPool));
+
+			if (!pool)
+				continue;
+
+			new (pool) MemoryPool();
+
+			pool->InitOnNode(i);
+			pool->InitMutex("NodePool");
 
-		// This is the 1MB before the free elements array
-		mSavedArraySizes = (ArraySizingData*)(((char*)mFreeLargeElementsList) - kBytesAllocatedForFreeArray);
+			mNodePools[i] = pool;
+		}
 	}
 
 	// -------------------------------------------------------------------------
 
-	void MemoryPool::InitMutex()
+	void MemoryPool::Reset()
 	{
-		mBlockingMutex = new std::mutex();
+		// The blocks themselves do not need touching, as the next allocation will construct over the start of the list again
+		if (mLargeDataAllocationsList)
+			*mLargeDataAllocationsList = LargeDataMemoryBlock();
+
+		mLargeAllocationsPopulated     = false;
+		mLastElementInLargeAllocations = nullptr;
+
+		mFreeElementsAllocated         = 0;
+		mSavedArraySizesCount          = 0;
+
+		// The handle table was in the pool, so it has gone with everything else
+		ResetHandles();
+
+		// The allocation and free counts are kept, as they are totals since Init - only what describes the current layout is cleared
+		mMemoryUsed.store(0, std::memory_order_relaxed);
+		mFreeBytesInBlocks.store(0, std::memory_order_relaxed);
+		mEndOfUsedSpace.store(0, std::memory_order_relaxed);
+
+		for (unsigned int i = 0; i < kMemoryPoolSizeClasses; i++)
+			mFreeBlocksPerSizeClass[i].store(0, std::memory_order_relaxed);
+	}
+
+	// -------------------------------------------------------------------------
+
+	bool MemoryPool::SaveSnapshot(const char* path, const void* root) const
+	{
+		if (!mLargeDataAllocationsList || !root || !Owns(root))
+			return false;
+
+		FILE* file = fopen(path, "wb");
+
+		if (!file)
+			return false;
+
+		PoolSnapshotHeader header = {};
+		memcpy(header.mMagic, "PSNP", 4);
+
+		header.mVersion               = kSnapshotVersion;
+		header.mTotalBytes            = mTotalBytes;
+		header.mBookkeepingBytes      = mBookkeepingBytes;
+		header.mBlockBytes            = mLargeAllocationsPopulated ? mEndOfUsedSpace.load(std::memory_order_relaxed) : 0;
+		header.mLastElement           = GetOffset(mLastElementInLargeAllocations);
+		header.mRoot                  = GetOffset(root);
+		header.mFreeElementsAllocated = mFreeElementsAllocated;
+		header.mSavedArraySizesCount  = mSavedArraySizesCount;
+		header.mAllocationsPopulated  = mLargeAllocationsPopulated;
+		header.mHandleTable           = mHandleTable;
+		header.mHandleCount           = mHandleCount;
+		header.mFreeHandle            = mFreeHandle;
+		header.mMemoryUsed            = mMemoryUsed.load(std::memory_order_relaxed);
+		header.mPeakMemoryUsed        = mPeakMemoryUsed.load(std::memory_order_relaxed);
+		header.mFreeBytesInBlocks     = mFreeBytesInBlocks.load(std::memory_order_relaxed);
+
+		for (unsigned int i = 0; i < kMemoryPoolSizeClasses; i++)
+			header.mFreeBlocksPerSizeClass[i] = mFreeBlocksPerSizeClass[i].load(std::memory_order_relaxed);
+
+		// Header, then the blocks, then the two bookkeeping arrays - each padded out to a section boundary.
+		// Only the part of each array in use is written, so a mostly empty pool makes a small file
+		size_t blockSection     = AlignToSnapshotSection(sizeof(PoolSnapshotHeader));
+		size_t bookkeepingStart = blockSection + AlignToSnapshotSection(header.mBlockBytes);
+
+		bool written = fwrite(&header, sizeof(header), 1, file) == 1;
+
+		if (written && header.mBlockBytes > 0)
+		{
+			written = fseek(file, (long)blockSection, SEEK_SET) == 0 &&
+				      fwrite(mLargeDataAllocationsList, 1, header.mBlockBytes, file) == header.mBlockBytes;
+		}
+
+		if (written)
+		{
+			written = fseek(file, (long)bookkeepingStart, SEEK_SET) == 0 &&
+				      fwrite(mFreeLargeElementsList, sizeof(FreeMemoryBlockInfo), mFreeElementsAllocated, file) == mFreeElementsAllocated &&
+				      fwrite(mSavedArraySizes,       sizeof(ArraySizingData),     mSavedArraySizesCount,  file) == mSavedArraySizesCount;
+		}
+
+		fclose(file);
+
+		return written;
+	}
+
+	// -------------------------------------------------------------------------
+
+	void* MemoryPool::RestoreSnapshot(const char* path)
+	{
+		FILE* file = fopen(path, "rb");
+
+		if (!file)
+			return nullptr;
+
+		PoolSnapshotHeader header = {};
+
+		if (fread(&header, sizeof(header), 1, file) != 1 || memcmp(header.mMagic, "PSNP", 4) != 0 || header.mVersion != kSnapshotVersion ||
+			header.mBlockBytes > header.mTotalBytes - (2 * header.mBookkeepingBytes) ||
+			header.mFreeElementsAllocated * sizeof(FreeMemoryBlockInfo) > header.mBookkeepingBytes ||
+			header.mSavedArraySizesCount  * sizeof(ArraySizingData)     > header.mBookkeepingBytes ||
+			(header.mHandleTable != kNoBlockOffset && header.mHandleTable >= header.mBlockBytes))
+		{
+			fclose(file);
+			return nullptr;
+		}
+
+		size_t blockSection     = AlignToSnapshotSection(sizeof(PoolSnapshotHeader));
+		size_t bookkeepingStart = blockSection + AlignToSnapshotSection(header.mBlockBytes);
+
+		// The new arena is filled in before the old one is let go of, so a bad file leaves the pool as it was
+		char* arena = nullptr;
+
+#ifdef _WIN32
+		arena = (char*)VirtualAlloc(nullptr, header.mTotalBytes, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+
+		if (arena && header.mBlockBytes > 0)
+		{
+			if (fseek(file, (long)blockSection, SEEK_SET) != 0 || fread(arena, 1, header.mBlockBytes, file) != header.mBlockBytes)
+			{
+				VirtualFree(arena, 0, MEM_RELEASE);
+				arena = nullptr;
+			}
+		}
+#else
+		arena = (char*)mmap(nullptr, header.mTotalBytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+		if ((void*)arena == MAP_FAILED)
+			arena = nullptr;
+
+		// The blocks are mapped over the start of the arena straight from the file - private, so writes never reach the file,
+		// and pages are only read in as they are touched. Whole pages only, so nothing is mapped past the end of the file
+		if (arena && header.mBlockBytes > 0)
+		{
+			size_t pageSize    = (size_t)sysconf(_SC_PAGESIZE);
+			size_t mappedBytes = (header.mBlockBytes + pageSize - 1) & ~(pageSize - 1);
+
+			void*  mapped      = mmap(arena, mappedBytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fileno(file), (off_t)blockSection);
+
+			if (mapped == MAP_FAILED)
+			{
+				munmap(arena, header.mTotalBytes);
+				arena = nullptr;
+			}
+		}
+#endif
+
+		if (!arena)
+		{
+			fclose(file);
+			return nullptr;
+		}
+
+		// The bookkeeping arrays are at the far end of the arena, so they are copied into place rather than mapped.
+		// The arena is fresh zeroed memory, so the rest of the free list already reads as empty
+		FreeMemoryBlockInfo* freeList   = (FreeMemoryBlockInfo*)(arena + header.mTotalBytes - header.mBookkeepingBytes);
+		ArraySizingData*     arraySizes = (ArraySizingData*)((char*)freeList - header.mBookkeepingBytes);
+
+		bool read = fseek(file, (long)bookkeepingStart, SEEK_SET) == 0 &&
+			        fread(freeList,   sizeof(FreeMemoryBlockInfo), header.mFreeElementsAllocated, file) == header.mFreeElementsAllocated &&
+			        fread(arraySizes, sizeof(ArraySizingData),     header.mSavedArraySizesCount,  file) == header.mSavedArraySizesCount;
+
+		fclose(file);
+
+		if (!read)
+		{
+#ifdef _WIN32
+			VirtualFree(arena, 0, MEM_RELEASE);
+#else
+			munmap(arena, header.mTotalBytes);
+#endif
+			return nullptr;
+		}
+
+		FreeArena();
+
+		mLargeDataAllocationsList      = (LargeDataMemoryBlock*)arena;
+		mBacking                       = PoolBacking::Snapshot;
+		mMappedBytes                   = header.mTotalBytes;
+
+		mTotalBytes                    = header.mTotalBytes;
+		mBookkeepingBytes              = header.mBookkeepingBytes;
+		mFreeLargeElementsList         = freeList;
+		mSavedArraySizes               = arraySizes;
+
+		mLargeAllocationsPopulated     = header.mAllocationsPopulated;
+		mLastElementInLargeAllocations = GetBlock(header.mLastElement);
+		mFreeElementsAllocated         = header.mFreeElementsAllocated;
+		mSavedArraySizesCount          = header.mSavedArraySizesCount;
+
+		// The table is inside the blocks, so the handles come back as they were
+		mHandleTable                   = header.mHandleTable;
+		mHandleCount                   = header.mHandleCount;
+		mFreeHandle                    = header.mFreeHandle;
+		mCompactionCursor              = kNoBlockOffset;
+
+		// Allocation and free counts start again from here, but the layout's counters have to match the blocks
+		ResetStats();
+
+		mMemoryUsed.store(header.mMemoryUsed, std::memory_order_relaxed);
+		mPeakMemoryUsed.store(header.mPeakMemoryUsed, std::memory_order_relaxed);
+		mFreeBytesInBlocks.store(header.mFreeBytesInBlocks, std::memory_order_relaxed);
+		mEndOfUsedSpace.store(header.mBlockBytes, std::memory_order_relaxed);
+
+		for (unsigned int i = 0; i < kMemoryPoolSizeClasses; i++)
+			mFreeBlocksPerSizeClass[i].store(header.mFreeBlocksPerSizeClass[i], std::memory_order_relaxed);
+
+		return header.mRoot == kNoBlockOffset ? nullptr : (char*)mLargeDataAllocationsList + header.mRoot;
+	}
+
+	// -------------------------------------------------------------------------
+
+	void MemoryPool::ResetStats()
+	{
+		mMemoryUsed.store(0, std::memory_order_relaxed);
+		mPeakMemoryUsed.store(0, std::memory_order_relaxed);
+		mFreeBytesInBlocks.store(0, std::memory_order_relaxed);
+		mEndOfUsedSpace.store(0, std::memory_order_relaxed);
+
+		for (unsigned int i = 0; i < kMemoryPoolSizeClasses; i++)
+		{
+			mAllocationsPerSizeClass[i].store(0, std::memory_order_relaxed);
+			mFreesPerSizeClass[i].store(0, std::memory_order_relaxed);
+			mFreeBlocksPerSizeClass[i].store(0, std::memory_order_relaxed);
+		}
+	}
+
+	// -------------------------------------------------------------------------
+
+	void MemoryPool::NoteAllocation(size_t blockSize)
+	{
+		Increment(mAllocationsPerSizeClass[GetSizeClass(blockSize)], 1);
+		Increment(mMemoryUsed, blockSize);
+
+		size_t memoryUsed = mMemoryUsed.load(std::memory_order_relaxed);
+
+		if (memoryUsed > mPeakMemoryUsed.load(std::memory_order_relaxed))
+			mPeakMemoryUsed.store(memoryUsed, std::memory_order_relaxed);
+	}
+
+	// -------------------------------------------------------------------------
+
+	void MemoryPool::NoteFree(size_t blockSize)
+	{
+		Increment(mFreesPerSizeClass[GetSizeClass(blockSize)], 1);
+		Decrement(mMemoryUsed, blockSize);
+	}
+
+	// -------------------------------------------------------------------------
+
+	void MemoryPool::NoteFreeBlockAdded(size_t blockSize)
+	{
+		Increment(mFreeBlocksPerSizeClass[GetSizeClass(blockSize)], 1);
+		Increment(mFreeBytesInBlocks, blockSize);
+	}
+
+	// -------------------------------------------------------------------------
+
+	void MemoryPool::NoteFreeBlockRemoved(size_t blockSize)
+	{
+		Decrement(mFreeBlocksPerSizeClass[GetSizeClass(blockSize)], 1);
+		Decrement(mFreeBytesInBlocks, blockSize);
+	}
+
+	// -------------------------------------------------------------------------
+
+	// Not counted as an allocation - the block was already counted when it was first handed out
+	void MemoryPool::NoteExpansion(size_t extraBytes)
+	{
+		Increment(mMemoryUsed, extraBytes);
+
+		size_t memoryUsed = mMemoryUsed.load(std::memory_order_relaxed);
+
+		if (memoryUsed > mPeakMemoryUsed.load(std::memory_order_relaxed))
+			mPeakMemoryUsed.store(memoryUsed, std::memory_order_relaxed);
+	}
+
+	// -------------------------------------------------------------------------
+
+	void* MemoryPool::AllocateArena(size_t bytes, bool useHugePages)
+	{
+		mMappedBytes = bytes;
+
+		if (!useHugePages)
+		{
+			mBacking = PoolBacking::Malloc;
+
+			return malloc(bytes);
+		}
+
+		// Huge page mappings have to be a whole number of pages
+		size_t hugePageBytes = (bytes + kHugePageSize - 1) & ~(kHugePageSize - 1);
+
+#ifdef _WIN32
+		// Needs the 'Lock pages in memory' privilege - without it this fails and we drop back to normal pages
+		SIZE_T largePageMinimum = GetLargePageMinimum();
+
+		if (largePageMinimum > 0)
+		{
+			size_t largePageBytes = (bytes + largePageMinimum - 1) & ~(largePageMinimum - 1);
+			void*  memory         = VirtualAlloc(nullptr, largePageBytes, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+
+			if (memory)
+			{
+				mBacking     = PoolBacking::ExplicitHugePages;
+				mMappedBytes = largePageBytes;
+
+				return memory;
+			}
+		}
+
+		mBacking     = PoolBacking::NormalPages;
+		mMappedBytes = bytes;
+
+		return VirtualAlloc(nullptr, bytes, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+#else
+	#ifdef MAP_HUGETLB
+		// Explicit huge pages - only works if the system has some reserved (vm.nr_hugepages)
+		void* memory = mmap(nullptr, hugePageBytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+
+		if (memory != MAP_FAILED)
+		{
+			mBacking     = PoolBacking::ExplicitHugePages;
+			mMappedBytes = hugePageBytes;
+
+			return memory;
+		}
+	#endif
+
+		// Fall back to transparent huge pages - map an extra huge page so that the start can be moved onto a 2MB boundary,
+		// as the kernel can only promote ranges that are aligned to the huge page size
+		size_t mappedBytes = hugePageBytes + kHugePageSize;
+		char*  mapped      = (char*)mmap(nullptr, mappedBytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+		if ((void*)mapped == MAP_FAILED)
+		{
+			mBacking = PoolBacking::Malloc;
+
+			return malloc(bytes);
+		}
+
+		char*  aligned     = (char*)(((uintptr_t)mapped + kHugePageSize - 1) & ~((uintptr_t)kHugePageSize - 1));
+		size_t frontSlop   = (size_t)(aligned - mapped);
+		size_t backSlop    = mappedBytes - frontSlop - hugePageBytes;
+
+		if (frontSlop > 0)
+			munmap(mapped, frontSlop);
+
+		if (backSlop > 0)
+			munmap(aligned + hugePageBytes, backSlop);
+
+		mMappedBytes = hugePageBytes;
+
+	#ifdef MADV_HUGEPAGE
+		if (madvise(aligned, hugePageBytes, MADV_HUGEPAGE) == 0)
+		{
+			mBacking = PoolBacking::TransparentHugePages;
+
+			return aligned;
+		}
+	#endif
+
+		mBacking = PoolBacking::NormalPages;
+
+		return aligned;
+#endif
+	}
+
+	// -------------------------------------------------------------------------
+
+	void MemoryPool::FreeArena()
+	{
+		if (!mLargeDataAllocationsList)
+			return;
+
+		if (mBacking == PoolBacking::Malloc)
+		{
+			free(mLargeDataAllocationsList);
+		}
+		else if (mBacking == PoolBacking::NumaNode)
+		{
+			Numa::FreeOnNode(mLargeDataAllocationsList, mMappedBytes);
+		}
+		else if (mBacking == PoolBacking::ParentPool)
+		{
+			Profiling::ProfiledMutex* mutex = mParentPool->GetMutex();
+
+			if (mutex)
+				mutex->lock();
+
+			mParentPool->FreeAlignedMemory(mLargeDataAllocationsList);
+
+			if (mutex)
+				mutex->unlock();
+
+			mParentPool = nullptr;
+		}
+		else
+		{
+#ifdef _WIN32
+			VirtualFree(mLargeDataAllocationsList, 0, MEM_RELEASE);
+#else
+			munmap(mLargeDataAllocationsList, mMappedBytes);
+#endif
+		}
+
+		mLargeDataAllocationsList = nullptr;
+	}
+
+	// -------------------------------------------------------------------------
+
+	size_t MemoryPool::GetHugePageCount() const
+	{
+		switch (mBacking)
+		{
+		case PoolBacking::ExplicitHugePages:
+#ifdef _WIN32
+			return mMappedBytes / GetLargePageMinimum();
+#else
+			return mMappedBytes / kHugePageSize;
+#endif
+
+		case PoolBacking::TransparentHugePages:
+		{
+#ifndef _WIN32
+			// The kernel only tells us through smaps - find the mapping that starts at the arena and read its huge page usage
+			FILE* smaps = fopen("/proc/self/smaps", "r");
+
+			if (!smaps)
+				return 0;
+
+			char          line[512];
+			bool          inArenaMapping = false;
+			unsigned long hugePageKB     = 0;
+
+			while (fgets(line, sizeof(line), smaps))
+			{
+				unsigned long start = 0;
+				unsigned long end   = 0;
+
+				// Mapping header lines start with the address range
+				if (sscanf(line, "%lx-%lx", &start, &end) == 2 && line[0] != ' ')
+				{
+					inArenaMapping = (start <= (uintptr_t)mLargeDataAllocationsList) && ((uintptr_t)mLargeDataAllocationsList < end);
+					continue;
+				}
+
+				if (inArenaMapping && sscanf(line, "AnonHugePages: %lu kB", &hugePageKB) == 1)
+					break;
+			}
+
+			fclose(smaps);
+
+			return (size_t)hugePageKB * 1024 / kHugePageSize;
+#else
+			return 0;
+#endif
+		}
+
+		default:
+			return 0;
+		}
+	}
+
+	// -------------------------------------------------------------------------
+
+	void MemoryPool::OutputHugePageUsage() const
+	{
+		const char* backingNames[] = { "malloc", "explicit huge pages", "transparent huge pages", "normal pages (huge pages unavailable)", "NUMA node", "parent pool", "snapshot" };
+
+		size_t hugePages      = GetHugePageCount();
+		size_t hugePageBytes  = hugePages * kHugePageSize;
+
+		std::cout << "Memory pool backing: " << backingNames[(int)mBacking] << std::endl;
+		std::cout << "Huge pages backing the pool: " << hugePages << " (" << (hugePageBytes / (1024 * 1024)) << "MB of " << (mMappedBytes / (1024 * 1024)) << "MB)" << std::endl;
+	}
+
+	// -------------------------------------------------------------------------
+
+	void MemoryPool::InitMutex(const char* name)
+	{
+		mBlockingMutex = new Profiling::ProfiledMutex(name);
 	}
 
 	// -------------------------------------------------------------------------
@@ -80,10 +707,10 @@ namespace Memory
 			// See if there are any free large blocks of memory that are the right size
 			for (unsigned int i = 0; i < mFreeElementsAllocated; i++)
 			{
-				if (mFreeLargeElementsList[i].mAddress->mDataSizeAndUsed < alignedSizeForLargeAllocation)
-					continue;
+				LargeDataMemoryBlock* addressPointedTo = GetBlock(mFreeLargeElementsList[i].mBlockOffset);
 
-				LargeDataMemoryBlock* addressPointedTo = mFreeLargeElementsList[i].mAddress;
+				if (addressPointedTo->mDataSizeAndUsed < alignedSizeForLargeAllocation)
+					continue;
 
 				if (addressPointedTo->mDataSizeAndUsed == alignedSizeForLargeAllocation || // Exact right size
 					(int)((int)addressPointedTo->mDataSizeAndUsed - (int)alignedSizeForLargeAllocation) > (int)AlignToArchitecture(kMinSizeForLargeAllocationBlock + sizeof(LargeDataMemoryBlock) - 1))
@@ -91,14 +718,19 @@ namespace Memory
 					// Store the size if this is for an array
 					if (forArray)
 					{
-						mSavedArraySizes[mSavedArraySizesCount] = ArraySizingData(&addressPointedTo->mData[0], alignedSizeForLargeAllocation);
+						mSavedArraySizes[mSavedArraySizesCount] = ArraySizingData(GetOffset(&addressPointedTo->mData[0]), alignedSizeForLargeAllocation);
 
 						mSavedArraySizesCount++;
 					}
 
+					// The hole is used up either way - if it is split, the remainder goes back in as a smaller hole
+					NoteFreeBlockRemoved(addressPointedTo->mDataSizeAndUsed);
+
 					// Now see if we need to add another free block which is the remainder of the memory within the block
 					if (addressPointedTo->mDataSizeAndUsed != alignedSizeForLargeAllocation)
 					{
+						NoteFreeBlockAdded(addressPointedTo->mDataSizeAndUsed - alignedSizeForLargeAllocation);
+
 						// Create a new large memory block at the split point
 						LargeDataMemoryBlock* newBlock = (LargeDataMemoryBlock*)(((char*)addressPointedTo) + alignedSizeForLargeAllocation);
 							                 *newBlock = LargeDataMemoryBlock(addressPointedTo->mDataSizeAndUsed - alignedSizeForLargeAllocation, false);
@@ -108,16 +740,16 @@ namespace Memory
 						addressPointedTo->mDataSizeAndUsed |= 1;
 
 						// Instead of removing the free element, we can instead just adjust the address it points to to be beyond the space we just re-used
-						mFreeLargeElementsList[i].mAddress = newBlock;
+						mFreeLargeElementsList[i].mBlockOffset = GetOffset(newBlock);
 
 						// Now we need to add this memory block to the list
-						LargeDataMemoryBlock* oldNext = addressPointedTo->mNext;
+						LargeDataMemoryBlock* oldNext = GetBlock(addressPointedTo->mNext);
 
-						addressPointedTo->mNext = newBlock;
-						newBlock->mNext         = oldNext;
+						addressPointedTo->mNext = GetOffset(newBlock);
+						newBlock->mNext         = GetOffset(oldNext);
 
 						// Set the prior pointer to being the one we just split in two
-						newBlock->mPrior = addressPointedTo;
+						newBlock->mPrior = GetOffset(addressPointedTo);
 
 						// If this element was the last in the list
 						if (oldNext == nullptr)
@@ -126,7 +758,7 @@ namespace Memory
 						}
 						else
 						{
-							oldNext->mPrior = newBlock;
+							oldNext->mPrior = GetOffset(newBlock);
 						}
 					}
 					else // Exactly equal to the amount of memory we need
@@ -135,10 +767,12 @@ namespace Memory
 						addressPointedTo->mDataSizeAndUsed |= 1;
 
 						// See which element we are looking at and copy across the last element to be here as a replacement
-						mFreeLargeElementsList[i].mAddress = mFreeLargeElementsList[mFreeElementsAllocated - 1].mAddress;
+						mFreeLargeElementsList[i].mBlockOffset = mFreeLargeElementsList[mFreeElementsAllocated - 1].mBlockOffset;
 						mFreeElementsAllocated--;
 					}
 
+					NoteAllocation(alignedSizeForLargeAllocation);
+
 					// Return the memory address back so that the user can modify this data section
 					return &addressPointedTo->mData[0];
 				}
@@ -153,25 +787,30 @@ namespace Memory
 			unsigned int bytesInSizeAllocation = (mLastElementInLargeAllocations->mDataSizeAndUsed & ~1);
 			LargeDataMemoryBlock* nextFreeSlot = (LargeDataMemoryBlock*)((char*)mLastElementInLargeAllocations + bytesInSizeAllocation);
 
-			mMemoryUsed += alignedSizeForLargeAllocation;
-
-			if (mMemoryUsed >= kBytesAllocatedForLargeAllocations - kBytesAllocatedForFreeArray)
+			// The end of the list is the limit, not the amount in use, as freed holes in the middle cannot be used for this
+			if ((char*)nextFreeSlot + alignedSizeForLargeAllocation >= (char*)mSavedArraySizes)
 			{
-				assert("Out of memory" && false);
+				if (mAssertOnOutOfMemory)
+					assert("Out of memory" && false);
+
+				return nullptr;
 			}
 
+			NoteAllocation(alignedSizeForLargeAllocation);
+			mEndOfUsedSpace.store(((char*)nextFreeSlot + alignedSizeForLargeAllocation) - (char*)mLargeDataAllocationsList, std::memory_order_relaxed);
+
 			// Construct the data here
 			*nextFreeSlot = LargeDataMemoryBlock(alignedSizeForLargeAllocation, true);
 
 			// Make sure that the last element is this new one
-			mLastElementInLargeAllocations->mNext = nextFreeSlot; // Set the old last one's next to be the new last one
-			nextFreeSlot->mPrior                  = mLastElementInLargeAllocations;
+			mLastElementInLargeAllocations->mNext = GetOffset(nextFreeSlot); // Set the old last one's next to be the new last one
+			nextFreeSlot->mPrior                  = GetOffset(mLastElementInLargeAllocations);
 			mLastElementInLargeAllocations        = nextFreeSlot; // Set the new last one to being the last one
 
 			// Store the size if this is for an array
 			if (forArray)
 			{
-				mSavedArraySizes[mSavedArraySizesCount] = ArraySizingData(&nextFreeSlot->mData[0], alignedSizeForLargeAllocation);
+				mSavedArraySizes[mSavedArraySizesCount] = ArraySizingData(GetOffset(&nextFreeSlot->mData[0]), alignedSizeForLargeAllocation);
 
 				mSavedArraySizesCount++;
 			}
@@ -183,16 +822,20 @@ namespace Memory
 		}
 		else
 		{
-			// Construct the block at the start - no memory allocation needed
-			*mLargeDataAllocationsList = LargeDataMemoryBlock(alignedSizeForLargeAllocation, true);
-
-			mMemoryUsed += alignedSizeForLargeAllocation;
-
-			if (mMemoryUsed >= kBytesAllocatedForLargeAllocations - kBytesAllocatedForFreeArray)
+			// Construct the block at the start - no memory allocation needed
+			if ((char*)mLargeDataAllocationsList + alignedSizeForLargeAllocation >= (char*)mSavedArraySizes)
 			{
-				assert("Out of memory" && false);
+				if (mAssertOnOutOfMemory)
+					assert("Out of memory" && false);
+
+				return nullptr;
 			}
 
+			*mLargeDataAllocationsList = LargeDataMemoryBlock(alignedSizeForLargeAllocation, true);
+
+			NoteAllocation(alignedSizeForLargeAllocation);
+			mEndOfUsedSpace.store(alignedSizeForLargeAllocation, std::memory_order_relaxed);
+
 			// Set that we have one stored
 			mLargeAllocationsPopulated = true;
 
@@ -202,7 +845,7 @@ namespace Memory
 			// Save the size if this is for an array
 			if (forArray)
 			{
-				mSavedArraySizes[mSavedArraySizesCount] = ArraySizingData(&mLargeDataAllocationsList->mData[0], alignedSizeForLargeAllocation);
+				mSavedArraySizes[mSavedArraySizesCount] = ArraySizingData(GetOffset(&mLargeDataAllocationsList->mData[0]), alignedSizeForLargeAllocation);
 
 				mSavedArraySizesCount++;
 			}
@@ -222,9 +865,11 @@ namespace Memory
 
 			// If this is for an array then the size passed in will be 0, as we dont know the size right now
 			// So look through the mapping of sizes to find the size
+			BlockOffset dataOffset = GetOffset(memoryPointer);
+
 			for (unsigned int i = 0; i < mSavedArraySizesCount; i++)
 			{
-				if (mSavedArraySizes[i].mMemoryAddress == memoryPointer)
+				if (mSavedArraySizes[i].mDataOffset == dataOffset)
 				{
 					// Set the size we are dealing with for later in the function
 					size = mSavedArraySizes[i].mSize;
@@ -267,15 +912,17 @@ namespace Memory
 			alignedSizeForLargeAllocation = AlignToArchitecture(size + sizeof(LargeDataMemoryBlock) - 1);
 
 		// Jump to the right point in memory - the pointer passed in is the point of the start of the char[1], so we just need to move back the size of the header
-		unsigned int          adjustmentCount     = sizeof(size_t) + (2 * sizeof(LargeDataMemoryBlock*));
-		LargeDataMemoryBlock* memoryBlockPassedIn = (LargeDataMemoryBlock*)(((char*)memoryPointer) - adjustmentCount);
+		LargeDataMemoryBlock* memoryBlockPassedIn = GetBlockFromData(memoryPointer);
 
 		if (memoryBlockPassedIn)
 		{
 			// Set the block to not being used
 			memoryBlockPassedIn->mDataSizeAndUsed &= ~1;
 
-			mMemoryUsed -= memoryBlockPassedIn->mDataSizeAndUsed;
+			NoteFree(memoryBlockPassedIn->mDataSizeAndUsed);
+
+			// Whatever this block gets merged with, it all ends up as one hole of this size
+			size_t freeBlockSize = memoryBlockPassedIn->mDataSizeAndUsed;
 
 			// this should always match, if not then we have stored the wrong value somewhere
 #ifdef _DEBUG
@@ -286,8 +933,11 @@ namespace Memory
 			}
 #endif
 
-			bool mergeForwards          = memoryBlockPassedIn->mNext  && !(memoryBlockPassedIn->mNext->mDataSizeAndUsed & 1);
-			bool mergeBackwards         = memoryBlockPassedIn->mPrior && !(memoryBlockPassedIn->mPrior->mDataSizeAndUsed & 1);
+			LargeDataMemoryBlock* nextBlock  = GetBlock(memoryBlockPassedIn->mNext);
+			LargeDataMemoryBlock* priorBlock = GetBlock(memoryBlockPassedIn->mPrior);
+
+			bool mergeForwards          = nextBlock  && !(nextBlock->mDataSizeAndUsed & 1);
+			bool mergeBackwards         = priorBlock && !(priorBlock->mDataSizeAndUsed & 1);
 			int  freeBlockIndexMergedTo = -1;
 
 			// ------------------------------- Merge forwards  ------------------------------- //
@@ -295,16 +945,19 @@ namespace Memory
 			if (mergeForwards)
 			{
 				// The next element in the list exists and is not being used
-				memoryBlockPassedIn->mDataSizeAndUsed += memoryBlockPassedIn->mNext->mDataSizeAndUsed;
+				NoteFreeBlockRemoved(nextBlock->mDataSizeAndUsed);
+				freeBlockSize += nextBlock->mDataSizeAndUsed;
+
+				memoryBlockPassedIn->mDataSizeAndUsed += nextBlock->mDataSizeAndUsed;
 
 				// Make sure to remove the freeBlockList element pointing to the place we are now skipping over
 				for (unsigned int i = 0; i < mFreeElementsAllocated; i++)
 				{
 					// TODO make this nicer to cache //
-					if (mFreeLargeElementsList[i].mAddress == memoryBlockPassedIn->mNext)
+					if (mFreeLargeElementsList[i].mBlockOffset == memoryBlockPassedIn->mNext)
 					{
 						// Remove this point by copying the last address in the list over this data
-						mFreeLargeElementsList[i].mAddress = memoryBlockPassedIn;
+						mFreeLargeElementsList[i].mBlockOffset = GetOffset(memoryBlockPassedIn);
 
 						freeBlockIndexMergedTo = i;
 
@@ -313,15 +966,18 @@ namespace Memory
 				}
 
 				// If the one we have just merged into this is the last one in the list then we need to update the store of the last element
-				if (memoryBlockPassedIn->mNext->mNext == nullptr)
+				if (nextBlock->mNext == kNoBlockOffset)
 					mLastElementInLargeAllocations = memoryBlockPassedIn;
 				else
 				{
-					memoryBlockPassedIn->mNext->mNext->mPrior = memoryBlockPassedIn;
+					GetBlock(nextBlock->mNext)->mPrior = GetOffset(memoryBlockPassedIn);
 				}
 
 				// Skip over the memory from the one that has been merged
-				memoryBlockPassedIn->mNext = memoryBlockPassedIn->mNext->mNext;
+				memoryBlockPassedIn->mNext = nextBlock->mNext;
+
+				if (mCompactionCursor == GetOffset(nextBlock))
+					mCompactionCursor = GetOffset(memoryBlockPassedIn);
 			}
 
 			// ------------------------------- Merge backwards  ------------------------------- //
@@ -329,41 +985,49 @@ namespace Memory
 			{
 				// The prior point in memory exists and is not being used
 
+				NoteFreeBlockRemoved(priorBlock->mDataSizeAndUsed);
+				freeBlockSize += priorBlock->mDataSizeAndUsed;
+
 				// Add this size to the prior element's size
-				memoryBlockPassedIn->mPrior->mDataSizeAndUsed += memoryBlockPassedIn->mDataSizeAndUsed;
+				priorBlock->mDataSizeAndUsed += memoryBlockPassedIn->mDataSizeAndUsed;
 
 				// If we have just merged forwards, then both this and the prior point are stored in the free list,
 				// So we need to make sure we fix that up
 				if (mergeForwards && freeBlockIndexMergedTo != -1)
 				{
 					// Remove this point by copying the last address in the list over this data
-					mFreeLargeElementsList[freeBlockIndexMergedTo].mAddress = mFreeLargeElementsList[mFreeElementsAllocated - 1].mAddress;
+					mFreeLargeElementsList[freeBlockIndexMergedTo].mBlockOffset = mFreeLargeElementsList[mFreeElementsAllocated - 1].mBlockOffset;
 
 					mFreeElementsAllocated--;
 				}
 
 				// Check if this element is the last one, and if so then we need to adjust the store of the last element
-				if (memoryBlockPassedIn->mNext == nullptr)
+				if (memoryBlockPassedIn->mNext == kNoBlockOffset)
 				{
-					mLastElementInLargeAllocations = memoryBlockPassedIn->mPrior;
+					mLastElementInLargeAllocations = priorBlock;
 				}
 				else
 				{
-					memoryBlockPassedIn->mNext->mPrior = memoryBlockPassedIn->mPrior;
+					GetBlock(memoryBlockPassedIn->mNext)->mPrior = memoryBlockPassedIn->mPrior;
 				}
 
 				// Skip over this element in the list
-				memoryBlockPassedIn->mPrior->mNext = memoryBlockPassedIn->mNext;
+				priorBlock->mNext = memoryBlockPassedIn->mNext;
+
+				if (mCompactionCursor == GetOffset(memoryBlockPassedIn))
+					mCompactionCursor = memoryBlockPassedIn->mPrior;
 			}
 
 			// If not merging with anything then we need to add this block to the free list
 			if (!mergeBackwards && !mergeForwards)
 			{
 				mFreeLargeElementsList[mFreeElementsAllocated]          = FreeMemoryBlockInfo();
-				mFreeLargeElementsList[mFreeElementsAllocated].mAddress = memoryBlockPassedIn;
+				mFreeLargeElementsList[mFreeElementsAllocated].mBlockOffset = GetOffset(memoryBlockPassedIn);
 				mFreeElementsAllocated++;
 			}
 
+			NoteFreeBlockAdded(freeBlockSize);
+
 			return;
 		}
 
@@ -374,6 +1038,461 @@ namespace Memory
 
 	// -------------------------------------------------------------------------
 
+	bool MemoryPool::TryExpandInPlace(void* memoryPointer, size_t oldSize, size_t newSize)
+	{
+		if (!memoryPointer || !mLargeAllocationsPopulated)
+			return false;
+
+		// Same sizing as AssignMemory and FreeMemory, so that the block can still be freed normally afterwards
+		size_t oldBlockSize = AlignToArchitecture(oldSize + sizeof(LargeDataMemoryBlock) - 1);
+		size_t newBlockSize = AlignToArchitecture(newSize + sizeof(LargeDataMemoryBlock) - 1);
+
+		LargeDataMemoryBlock* block = GetBlockFromData(memoryPointer);
+
+#ifdef _DEBUG
+		if ((block->mDataSizeAndUsed & ~1) != oldBlockSize || !(block->mDataSizeAndUsed & 1))
+		{
+			DebugOutputUsage();
+			assert(false);
+		}
+#endif
+
+		// Shrinking is not supported, as the tail would need to become a free block of its own
+		if (newBlockSize <= oldBlockSize)
+			return newBlockSize == oldBlockSize;
+
+		size_t extraBytes = newBlockSize - oldBlockSize;
+
+		// ------------------------------- Last block ------------------------------- //
+		// Nothing after it, so it can grow into the space that has never been handed out
+		if (block->mNext == kNoBlockOffset)
+		{
+			if ((char*)block + newBlockSize >= (char*)mSavedArraySizes)
+				return false;
+
+			block->mDataSizeAndUsed = newBlockSize | 1;
+
+			NoteExpansion(extraBytes);
+			mEndOfUsedSpace.store(((char*)block + newBlockSize) - (char*)mLargeDataAllocationsList, std::memory_order_relaxed);
+
+			return true;
+		}
+
+		// ------------------------------- Free neighbour ------------------------------- //
+		LargeDataMemoryBlock* nextBlock = GetBlock(block->mNext);
+
+		if (nextBlock->mDataSizeAndUsed & 1)
+			return false;
+
+		size_t nextBlockSize = nextBlock->mDataSizeAndUsed;
+
+		if (oldBlockSize + nextBlockSize < newBlockSize)
+			return false;
+
+		// Same rule as AssignMemory - either the hole is used up exactly, or what is left is big enough to stay a block
+		size_t remainder = (oldBlockSize + nextBlockSize) - newBlockSize;
+
+		if (remainder != 0 && (int)remainder <= (int)AlignToArchitecture(kMinSizeForLargeAllocationBlock + sizeof(LargeDataMemoryBlock) - 1))
+			return false;
+
+		int freeBlockIndex = -1;
+
+		for (unsigned int i = 0; i < mFreeElementsAllocated; i++)
+		{
+			if (mFreeLargeElementsList[i].mBlockOffset == block->mNext)
+			{
+				freeBlockIndex = i;
+				break;
+			}
+		}
+
+		if (freeBlockIndex == -1)
+		{
+			assert(false);
+			return false;
+		}
+
+		NoteFreeBlockRemoved(nextBlockSize);
+
+		LargeDataMemoryBlock* afterNext = GetBlock(nextBlock->mNext);
+
+		// The hole's header is about to move or go, so Compact must not carry on from it
+		if (mCompactionCursor == block->mNext)
+			mCompactionCursor = GetOffset(block);
+
+		if (remainder != 0)
+		{
+			NoteFreeBlockAdded(remainder);
+
+			// Move the hole's header forwards to the new end of this block - the free list entry just follows it
+			LargeDataMemoryBlock* newBlock = (LargeDataMemoryBlock*)(((char*)block) + newBlockSize);
+			                     *newBlock = LargeDataMemoryBlock((unsigned int)remainder, false);
+
+			newBlock->mPrior = GetOffset(block);
+			newBlock->mNext  = GetOffset(afterNext);
+			block->mNext     = GetOffset(newBlock);
+
+			if (afterNext == nullptr)
+				mLastElementInLargeAllocations = newBlock;
+			else
+				afterNext->mPrior = GetOffset(newBlock);
+
+			mFreeLargeElementsList[freeBlockIndex].mBlockOffset = GetOffset(newBlock);
+		}
+		else
+		{
+			// The whole hole is taken, so it leaves the list and the free list
+			block->mNext = GetOffset(afterNext);
+
+			if (afterNext == nullptr)
+				mLastElementInLargeAllocations = block;
+			else
+				afterNext->mPrior = GetOffset(block);
+
+			mFreeLargeElementsList[freeBlockIndex].mBlockOffset = mFreeLargeElementsList[mFreeElementsAllocated - 1].mBlockOffset;
+			mFreeElementsAllocated--;
+		}
+
+		block->mDataSizeAndUsed = newBlockSize | 1;
+
+		NoteExpansion(extraBytes);
+
+		return true;
+	}
+
+	// -------------------------------------------------------------------------
+
+	void* MemoryPool::AssignAlignedMemory(size_t size, size_t alignment)
+	{
+		// Alignment has to be a power of two for the masking below to work
+		assert((alignment & (alignment - 1)) == 0);
+
+		// Ask for enough extra space that we can always slide forwards to the next boundary and still fit the prefix in front of it
+		// This costs at most (alignment - 1) + prefix bytes, rather than a whole block per object
+		size_t requestedSize = size + (alignment - 1) + sizeof(AlignedAllocationPrefix);
+
+		char* blockData = (char*)AssignMemory(requestedSize, false);
+
+		if (!blockData)
+			return nullptr;
+
+		// Move past the prefix and then round up to the boundary
+		uintptr_t alignedAddress = ((uintptr_t)(blockData + sizeof(AlignedAllocationPrefix)) + (alignment - 1)) & ~((uintptr_t)alignment - 1);
+
+		// Store where the block really started so that the free can hand the right pointer back
+		AlignedAllocationPrefix* prefix = ((AlignedAllocationPrefix*)alignedAddress) - 1;
+		                         prefix->mPaddingBytes  = alignedAddress - (uintptr_t)blockData;
+		                         prefix->mRequestedSize = requestedSize;
+
+		return (void*)alignedAddress;
+	}
+
+	// -------------------------------------------------------------------------
+
+	void MemoryPool::FreeAlignedMemory(void* memoryPointer)
+	{
+		if (!memoryPointer)
+			return;
+
+		AlignedAllocationPrefix* prefix = ((AlignedAllocationPrefix*)memoryPointer) - 1;
+
+		FreeMemory(prefix->mRequestedSize, (char*)memoryPointer - prefix->mPaddingBytes, false);
+	}
+
+	// -------------------------------------------------------------------------
+
+	void MemoryPool::ResetHandles()
+	{
+		mHandleTable      = kNoBlockOffset;
+		mHandleCount      = 0;
+		mFreeHandle       = kInvalidMemoryHandle;
+		mCompactionCursor = kNoBlockOffset;
+	}
+
+	// -------------------------------------------------------------------------
+
+	bool MemoryPool::CreateHandleTable(unsigned int handleCount)
+	{
+		// The table is an ordinary block in the pool, so it goes wherever the pool goes - including into snapshots
+		void* tableData = AssignMemory(handleCount * sizeof(BlockOffset), false);
+
+		if (!tableData)
+			return false;
+
+		mHandleTable = GetOffset(GetBlockFromData(tableData));
+		mHandleCount = handleCount;
+
+		// Chain every handle onto the unused list, in order, so that the first handles handed out are the lowest
+		BlockOffset* table = GetHandleTable();
+
+		for (unsigned int i = 0; i < handleCount; i++)
+			table[i] = kFreeHandleBit | (i + 1 < handleCount ? (BlockOffset)(i + 1) : (BlockOffset)kInvalidMemoryHandle);
+
+		mFreeHandle = 0;
+
+		return true;
+	}
+
+	// -------------------------------------------------------------------------
+
+	MemoryHandle MemoryPool::AssignMovableMemory(size_t size)
+	{
+		if (mHandleTable == kNoBlockOffset && !CreateHandleTable(kDefaultMemoryHandleCount))
+			return kInvalidMemoryHandle;
+
+		// Out of handles is treated like out of memory - the caller has to find somewhere else for it
+		if (mFreeHandle == kInvalidMemoryHandle)
+			return kInvalidMemoryHandle;
+
+		void* blockData = AssignMemory(size + sizeof(MovableAllocationPrefix), false);
+
+		if (!blockData)
+			return kInvalidMemoryHandle;
+
+		BlockOffset* table  = GetHandleTable();
+		MemoryHandle handle = mFreeHandle;
+
+		mFreeHandle   = (MemoryHandle)(table[handle] & ~kFreeHandleBit);
+		table[handle] = GetOffset(GetBlockFromData(blockData));
+
+		MovableAllocationPrefix* prefix = (MovableAllocationPrefix*)blockData;
+		                         prefix->mHandle        = handle;
+		                         prefix->mRequestedSize = (unsigned int)size;
+
+		return handle;
+	}
+
+	// -------------------------------------------------------------------------
+
+	bool MemoryPool::ResizeMovableMemory(MemoryHandle handle, size_t newSize)
+	{
+		BlockOffset*             table  = GetHandleTable();
+		LargeDataMemoryBlock*    block  = GetBlock(table[handle]);
+		MovableAllocationPrefix* prefix = (MovableAllocationPrefix*)&block->mData[0];
+
+		size_t oldSize = prefix->mRequestedSize;
+
+		if (TryExpandInPlace(&block->mData[0], oldSize + sizeof(MovableAllocationPrefix), newSize + sizeof(MovableAllocationPrefix)))
+		{
+			prefix->mRequestedSize = (unsigned int)newSize;
+
+			return true;
+		}
+
+		// Could not grow where it is, so copy it somewhere that fits and point the handle there instead
+		void* blockData = AssignMemory(newSize + sizeof(MovableAllocationPrefix), false);
+
+		if (!blockData)
+			return false;
+
+		// Copies the prefix along with the data, so the handle is already right
+		memcpy(blockData, &block->mData[0], sizeof(MovableAllocationPrefix) + (oldSize < newSize ? oldSize : newSize));
+
+		((MovableAllocationPrefix*)blockData)->mRequestedSize = (unsigned int)newSize;
+
+		FreeMemory(oldSize + sizeof(MovableAllocationPrefix), &block->mData[0], false);
+
+		table[handle] = GetOffset(GetBlockFromData(blockData));
+
+		return true;
+	}
+
+	// -------------------------------------------------------------------------
+
+	void MemoryPool::FreeMovableMemory(MemoryHandle handle)
+	{
+		if (handle == kInvalidMemoryHandle)
+			return;
+
+		BlockOffset*             table  = GetHandleTable();
+		LargeDataMemoryBlock*    block  = GetBlock(table[handle]);
+		MovableAllocationPrefix* prefix = (MovableAllocationPrefix*)&block->mData[0];
+
+		FreeMemory(prefix->mRequestedSize + sizeof(MovableAllocationPrefix), &block->mData[0], false);
+
+		table[handle] = kFreeHandleBit | mFreeHandle;
+		mFreeHandle   = handle;
+	}
+
+	// -------------------------------------------------------------------------
+
+	void* MemoryPool::GetMovableData(MemoryHandle handle) const
+	{
+		return &GetBlock(GetHandleTable()[handle])->mData[sizeof(MovableAllocationPrefix)];
+	}
+
+	// -------------------------------------------------------------------------
+
+	size_t MemoryPool::GetMovableSize(MemoryHandle handle) const
+	{
+		return ((MovableAllocationPrefix*)&GetBlock(GetHandleTable()[handle])->mData[0])->mRequestedSize;
+	}
+
+	// -------------------------------------------------------------------------
+
+	bool MemoryPool::IsMovable(LargeDataMemoryBlock* block) const
+	{
+		if (!(block->mDataSizeAndUsed & 1) || mHandleTable == kNoBlockOffset)
+			return false;
+
+		// Only a movable block can have its own offset in the table under the handle at its start - unused entries have the
+		// top bit set, and every used one points at the movable block that owns it
+		MemoryHandle handle = ((MovableAllocationPrefix*)&block->mData[0])->mHandle;
+
+		return handle < mHandleCount && GetHandleTable()[handle] == GetOffset(block);
+	}
+
+	// -------------------------------------------------------------------------
+
+	int MemoryPool::FindFreeListIndex(LargeDataMemoryBlock* block) const
+	{
+		BlockOffset blockOffset = GetOffset(block);
+
+		for (unsigned int i = 0; i < mFreeElementsAllocated; i++)
+		{
+			if (mFreeLargeElementsList[i].mBlockOffset == blockOffset)
+				return (int)i;
+		}
+
+		return -1;
+	}
+
+	// -------------------------------------------------------------------------
+
+	LargeDataMemoryBlock* MemoryPool::SlideBlockDown(LargeDataMemoryBlock* hole, LargeDataMemoryBlock* block)
+	{
+		size_t holeSize  = hole->mDataSizeAndUsed;
+		size_t blockSize = block->mDataSizeAndUsed & ~1;
+
+		int    freeBlockIndex = FindFreeListIndex(hole);
+
+		if (freeBlockIndex == -1)
+		{
+			assert(false);
+			return nullptr;
+		}
+
+		BlockOffset           priorOffset = hole->mPrior;
+		LargeDataMemoryBlock* afterBlock  = GetBlock(block->mNext);
+
+		// The header comes along with the data - its links are put right below
+		LargeDataMemoryBlock* movedBlock = hole;
+		memmove(movedBlock, block, blockSize);
+
+		movedBlock->mPrior = priorOffset;
+
+		MovableAllocationPrefix* prefix = (MovableAllocationPrefix*)&movedBlock->mData[0];
+		GetHandleTable()[prefix->mHandle] = GetOffset(movedBlock);
+
+		// The hole is now straight after the block, the same size as before
+		LargeDataMemoryBlock* newHole = (LargeDataMemoryBlock*)(((char*)movedBlock) + blockSize);
+		                     *newHole = LargeDataMemoryBlock((unsigned int)holeSize, false);
+
+		newHole->mPrior    = GetOffset(movedBlock);
+		movedBlock->mNext  = GetOffset(newHole);
+
+		mFreeLargeElementsList[freeBlockIndex].mBlockOffset = GetOffset(newHole);
+
+		// If that brings it up against another hole, the two become one - which is how the holes gather together
+		if (afterBlock && !(afterBlock->mDataSizeAndUsed & 1))
+		{
+			int afterIndex = FindFreeListIndex(afterBlock);
+
+			NoteFreeBlockRemoved(holeSize);
+			NoteFreeBlockRemoved(afterBlock->mDataSizeAndUsed);
+			NoteFreeBlockAdded(holeSize + afterBlock->mDataSizeAndUsed);
+
+			newHole->mDataSizeAndUsed += afterBlock->mDataSizeAndUsed;
+
+			if (afterIndex != -1)
+			{
+				mFreeLargeElementsList[afterIndex].mBlockOffset = mFreeLargeElementsList[mFreeElementsAllocated - 1].mBlockOffset;
+				mFreeElementsAllocated--;
+			}
+
+			afterBlock = GetBlock(afterBlock->mNext);
+		}
+
+		newHole->mNext = GetOffset(afterBlock);
+
+		if (afterBlock)
+			afterBlock->mPrior = GetOffset(newHole);
+		else
+			mLastElementInLargeAllocations = newHole;
+
+		return newHole;
+	}
+
+	// -------------------------------------------------------------------------
+
+	void MemoryPool::TrimFreeTail()
+	{
+		LargeDataMemoryBlock* lastBlock = mLastElementInLargeAllocations;
+
+		// The first block stays, even when free, as the list always needs a head
+		if (!mLargeAllocationsPopulated || (lastBlock->mDataSizeAndUsed & 1) || lastBlock->mPrior == kNoBlockOffset)
+			return;
+
+		int freeBlockIndex = FindFreeListIndex(lastBlock);
+
+		if (freeBlockIndex == -1)
+			return;
+
+		NoteFreeBlockRemoved(lastBlock->mDataSizeAndUsed);
+
+		mFreeLargeElementsList[freeBlockIndex].mBlockOffset = mFreeLargeElementsList[mFreeElementsAllocated - 1].mBlockOffset;
+		mFreeElementsAllocated--;
+
+		LargeDataMemoryBlock* priorBlock = GetBlock(lastBlock->mPrior);
+		                      priorBlock->mNext = kNoBlockOffset;
+
+		mLastElementInLargeAllocations = priorBlock;
+		mEndOfUsedSpace.store(((char*)priorBlock + (priorBlock->mDataSizeAndUsed & ~1)) - (char*)mLargeDataAllocationsList, std::memory_order_relaxed);
+
+		if (mCompactionCursor == GetOffset(lastBlock))
+			mCompactionCursor = kNoBlockOffset;
+	}
+
+	// -------------------------------------------------------------------------
+
+	size_t MemoryPool::Compact(size_t maxBytesToMove, unsigned int maxBlocksToVisit)
+	{
+		if (!mLargeAllocationsPopulated || mHandleTable == kNoBlockOffset)
+			return 0;
+
+		size_t                bytesMoved    = 0;
+		unsigned int          blocksVisited = 0;
+		LargeDataMemoryBlock* block         = mCompactionCursor != kNoBlockOffset ? GetBlock(mCompactionCursor) : mLargeDataAllocationsList;
+
+		while (block && bytesMoved < maxBytesToMove && blocksVisited < maxBlocksToVisit)
+		{
+			blocksVisited++;
+
+			LargeDataMemoryBlock* nextBlock = GetBlock(block->mNext);
+
+			// Only a hole with something movable straight after it can be closed up - anything else is stepped over
+			if ((block->mDataSizeAndUsed & 1) || !nextBlock || !IsMovable(nextBlock))
+			{
+				block = nextBlock;
+				continue;
+			}
+
+			bytesMoved += nextBlock->mDataSizeAndUsed & ~1;
+
+			// Stay on the hole, so it keeps moving up until it hits something that cannot move
+			block = SlideBlockDown(block, nextBlock);
+		}
+
+		// Start again from the beginning once the end has been reached
+		mCompactionCursor = GetOffset(block);
+
+		TrimFreeTail();
+
+		return bytesMoved;
+	}
+
+	// -------------------------------------------------------------------------
+
 	void MemoryPool::DebugOutputUsage(bool outputPreSized, bool outputLargeAllocations)
 	{	
 		if (outputLargeAllocations)
@@ -392,26 +1511,26 @@ namespace Memory
 				bool used = currentBlock->mDataSizeAndUsed & 1 ? true : false;
 
 				std::cout << "Address:\t" << currentBlock << "\tSize:\t" << (used ? currentBlock->mDataSizeAndUsed - 1 : currentBlock->mDataSizeAndUsed) << "\tIn use:\t" << (used ? "yes" : "no") << "\t";
-				std::cout << "Next:\t" << currentBlock->mNext;
-				std::cout << "\tPrior:\t" << currentBlock->mPrior << std::endl;
+				std::cout << "Next:\t" << GetBlock(currentBlock->mNext);
+				std::cout << "\tPrior:\t" << GetBlock(currentBlock->mPrior) << std::endl;
 
-				if (currentBlock->mNext && currentBlock > currentBlock->mNext)
+				if (currentBlock->mNext != kNoBlockOffset && currentBlock > GetBlock(currentBlock->mNext))
 					std::cout << "Ordering issue!" << std::endl;
 
 				bytesAllocated += (currentBlock->mDataSizeAndUsed & ~1);
 
-				currentBlock = currentBlock->mNext;
+				currentBlock = GetBlock(currentBlock->mNext);
 			}
 			std::cout << "Elements in list: " << elementsInList << std::endl << std::endl;
 
-			std::cout << "Total bytes in memory pool: " << kBytesAllocatedForLargeAllocations << std::endl;
+			std::cout << "Total bytes in memory pool: " << mTotalBytes << std::endl;
 			std::cout << "Bytes allocated to program: " << bytesAllocated << std::endl;
 
 			// Free slots list
 			std::cout << "List of free sizes:" << std::endl;
 			for (unsigned int i = 0; i < mFreeElementsAllocated; i++)
 			{
-				std::cout << "Free address:\t" << mFreeLargeElementsList[i].mAddress << std::endl;
+				std::cout << "Free address:\t" << GetBlock(mFreeLargeElementsList[i].mBlockOffset) << std::endl;
 			}
 			std::cout << "Elements in list: " << mFreeElementsAllocated << std::endl;
 
@@ -420,7 +1539,7 @@ namespace Memory
 			std::cout << "Sizes of saved array elements:" << std::endl;
 			for (unsigned int i = 0; i < mSavedArraySizesCount; i++)
 			{
-				std::cout << "Address:\t" << mSavedArraySizes[i].mMemoryAddress;
+				std::cout << "Address:\t" << (void*)((char*)mLargeDataAllocationsList + mSavedArraySizes[i].mDataOffset);
 				std::cout << "\tSize:\t" << mSavedArraySizes[i].mSize << std::endl;
 			}
 			std::cout << "Elements in list: " << mSavedArraySizesCount << std::endl;
@@ -429,5 +1548,66 @@ namespace Memory
 		std::cout << std::endl << std::endl;
 	}
 
+	// -------------------------------------------------------------------------
+	MemoryPoolStats MemoryPool::GetStats() const
+	{
+		MemoryPoolStats stats = {};
+
+		for (unsigned int i = 0; i < kMemoryPoolSizeClasses; i++)
+		{
+			stats.mAllocationsPerSizeClass[i] = mAllocationsPerSizeClass[i].load(std::memory_order_relaxed);
+			stats.mFreesPerSizeClass[i]       = mFreesPerSizeClass[i].load(std::memory_order_relaxed);
+			stats.mFreeBlocksPerSizeClass[i]  = mFreeBlocksPerSizeClass[i].load(std::memory_order_relaxed);
+
+			stats.mTotalAllocations += stats.mAllocationsPerSizeClass[i];
+			stats.mTotalFrees       += stats.mFreesPerSizeClass[i];
+			stats.mFreeBlockCount   += stats.mFreeBlocksPerSizeClass[i];
+
+			// The smallest size a block in this class can be - the best that can be said without walking the list
+			if (stats.mFreeBlocksPerSizeClass[i] > 0)
+				stats.mLargestFreeBlock = (size_t)1 << i;
+		}
+
+		stats.mCapacity          = mTotalBytes > (2 * mBookkeepingBytes) ? mTotalBytes - (2 * mBookkeepingBytes) : 0;
+		stats.mBytesInUse        = mMemoryUsed.load(std::memory_order_relaxed);
+		stats.mPeakBytesInUse    = mPeakMemoryUsed.load(std::memory_order_relaxed);
+		stats.mFreeBytesInBlocks = mFreeBytesInBlocks.load(std::memory_order_relaxed);
+
+		size_t endOfUsedSpace    = mEndOfUsedSpace.load(std::memory_order_relaxed);
+		stats.mUntouchedBytes    = stats.mCapacity > endOfUsedSpace ? stats.mCapacity - endOfUsedSpace : 0;
+
+		if (stats.mUntouchedBytes > stats.mLargestFreeBlock)
+			stats.mLargestFreeBlock = stats.mUntouchedBytes;
+
+		size_t totalFree = stats.mFreeBytesInBlocks + stats.mUntouchedBytes;
+
+		if (totalFree > 0)
+			stats.mFragmentation = 1.0f - ((float)stats.mLargestFreeBlock / (float)totalFree);
+
+		return stats;
+	}
+
+	// -------------------------------------------------------------------------
+
+	void MemoryPoolStats::Output() const
+	{
+		std::cout << "Pool bytes in use:   " << mBytesInUse << " / " << mCapacity << " (peak " << mPeakBytesInUse << ")" << std::endl;
+		std::cout << "Allocations / frees: " << mTotalAllocations << " / " << mTotalFrees << std::endl;
+		std::cout << "Free blocks:         " << mFreeBlockCount << " holding " << mFreeBytesInBlocks << " bytes, " << mUntouchedBytes << " bytes untouched" << std::endl;
+		std::cout << "Largest free block:  " << mLargestFreeBlock << "\tFragmentation: " << mFragmentation << std::endl;
+
+		std::cout << "Size class\tAllocations\tFrees\tFree blocks" << std::endl;
+
+		for (unsigned int i = 0; i < kMemoryPoolSizeClasses; i++)
+		{
+			if (mAllocationsPerSizeClass[i] == 0 && mFreeBlocksPerSizeClass[i] == 0)
+				continue;
+
+			std::cout << ((size_t)1 << i) << "+\t\t" << mAllocationsPerSizeClass[i] << "\t\t" << mFreesPerSizeClass[i] << "\t" << mFreeBlocksPerSizeClass[i] << std::endl;
+		}
+
+		std::cout << std::endl;
+	}
+
 	// -------------------------------------------------------------------------
 }
\ No newline at end of file
@@ -3,8 +3,14 @@
 #include <malloc.h>
 #include <iostream>
 #include <assert.h>
+#include <stddef.h>
 
 #include <mutex>
+#include <atomic>
+#include <new>
+
+#include "Numa.h"
+#include "LockProfiler.h"
 
 namespace Memory
 {
@@ -34,18 +40,24 @@ namespace Memory
 		return (n + 3) & ~(3);
 	}
 
+	// Blocks refer to each other by their offset from the start of the arena rather than by address, so that an arena
+	// written out to disk can be mapped back in anywhere and still be walked without fixing anything up
+	using BlockOffset = size_t;
+
+	constexpr BlockOffset kNoBlockOffset = ~(BlockOffset)0;
+
 	struct LargeDataMemoryBlock
 	{
 		LargeDataMemoryBlock()
-			: mNext(nullptr)
-			, mPrior(nullptr)
+			: mNext(kNoBlockOffset)
+			, mPrior(kNoBlockOffset)
 			, mDataSizeAndUsed(0)
 			, mData()
 		{ }
 
 		LargeDataMemoryBlock(unsigned int totalSize, bool inUse)
-			: mNext(nullptr)
-			, mPrior(nullptr)
+			: mNext(kNoBlockOffset)
+			, mPrior(kNoBlockOffset)
 			, mDataSizeAndUsed(totalSize)
 			, mData()
 		{
@@ -54,8 +66,8 @@ namespace Memory
 				mDataSizeAndUsed |= 1;
 		}
 
-		LargeDataMemoryBlock* mNext;
-		LargeDataMemoryBlock* mPrior;
+		BlockOffset           mNext;
+		BlockOffset           mPrior;
 
 		// LSB is 1 or 0 telling if the block is used or not
 		// This is possible because we are aligning to the architecture blocks
@@ -67,18 +79,38 @@ namespace Memory
 
 	struct FreeMemoryBlockInfo
 	{
-		LargeDataMemoryBlock* mAddress;
+		BlockOffset mBlockOffset;
+	};
+
+	// Stored directly before the pointer handed out by AssignAlignedMemory so the free can find the real block again
+	struct AlignedAllocationPrefix
+	{
+		size_t mPaddingBytes;  // How far the pointer was moved forwards from what AssignMemory gave back - a distance, so it survives the pool moving
+		size_t mRequestedSize; // The size passed into AssignMemory, needed so that FreeMemory can re-create the block size
+	};
+
+	// An index into a pool's handle table - movable allocations are only ever reached through one of these, as Compact
+	// is free to move the memory behind it
+	using MemoryHandle = unsigned int;
+
+	constexpr MemoryHandle kInvalidMemoryHandle = ~(MemoryHandle)0;
+
+	// Stored at the start of every movable block, so the compactor can tell which handle to update when it moves one
+	struct MovableAllocationPrefix
+	{
+		MemoryHandle mHandle;
+		unsigned int mRequestedSize;
 	};
 
 	struct ArraySizingData
 	{
-		ArraySizingData(void* address, size_t size)
-			: mMemoryAddress(address)
+		ArraySizingData(BlockOffset dataOffset, size_t size)
+			: mDataOffset(dataOffset)
 			, mSize(size)
 		{ }
 
-		void*  mMemoryAddress; // This is the pointer provided to the user to use, not the start of the meta data struct
-		size_t mSize;          // This is the entire size, from the start of the meta data all the way to the end of the user provided data (plus any extra for alignment)
+		BlockOffset mDataOffset; // Offset of the pointer provided to the user to use, not the start of the meta data struct
+		size_t      mSize;       // This is the entire size, from the start of the meta data all the way to the end of the user provided data (plus any extra for alignment)
 	};
 
 	// ----------------------------------------------------------
@@ -88,9 +120,83 @@ namespace Memory
 	// Set to 10MB currently
 	constexpr unsigned int kBytesAllocatedForLargeAllocations = 1024 * 1024 * 1024;
 	constexpr unsigned int kBytesAllocatedForFreeArray        = 1024 * 1024;
+
+	// Smaller pools owned by a single leaf, so that the leaf's lists sit next to each other and can be dropped in one go
+	constexpr unsigned int kBytesAllocatedPerLeafRegion       = 256 * 1024;
+	constexpr unsigned int kBytesAllocatedForLeafFreeArray    = 8 * 1024;
+
+	// One pool per NUMA node, which memory that should stay local to a node's workers is carved out of
+	constexpr unsigned int kBytesAllocatedPerNodePool         = 256 * 1024 * 1024;
+	constexpr unsigned int kBytesAllocatedForNodeFreeArray    = 256 * 1024;
+
+	// Huge pages are 2MB on the platforms we run on - the arena is rounded up to a multiple of this when using them
+	constexpr size_t       kHugePageSize                      = 2 * 1024 * 1024;
+
+	// How many movable allocations a pool can have at once - the table is taken out of the pool on the first one
+	constexpr unsigned int kDefaultMemoryHandleCount          = 4096;
+
+	// The alignment that AssignMemory guarantees - anything needing more must go through AssignAlignedMemory
+	constexpr unsigned int kArchitectureAlignment             = 4;
 	
 	// ----------------------------------------------------------
 
+	// Where the memory behind a pool actually came from, so that it can be given back the same way
+	enum class PoolBacking
+	{
+		Malloc,
+		ExplicitHugePages,    // MAP_HUGETLB / MEM_LARGE_PAGES - every page is a huge page or the allocation failed
+		TransparentHugePages, // madvise(MADV_HUGEPAGE) - the kernel promotes pages when it can, so the count has to be asked for
+		NormalPages,          // Huge pages were asked for, but nothing could be obtained
+		NumaNode,             // Placed on one NUMA node
+		ParentPool,           // Carved out of another pool, e.g. a leaf region taken from its node's pool
+		Snapshot              // Restored from a file written by SaveSnapshot - copy-on-write mapped from the file where the OS allows it
+	};
+
+	// ----------------------------------------------------------
+
+	// Size classes are powers of two - class n holds blocks of [2^n, 2^(n+1)) bytes, including the block header
+	constexpr unsigned int kMemoryPoolSizeClasses = 32;
+
+	static inline unsigned int GetSizeClass(size_t size)
+	{
+		unsigned int sizeClass = 0;
+
+		while (size > 1 && sizeClass < kMemoryPoolSizeClasses - 1)
+		{
+			size >>= 1;
+			sizeClass++;
+		}
+
+		return sizeClass;
+	}
+
+	// A copy of the pool's counters at one point in time - taken without the pool's mutex, so the values can be
+	// a few allocations apart from each other, but nothing else is stopped to get them
+	struct MemoryPoolStats
+	{
+		size_t mAllocationsPerSizeClass[kMemoryPoolSizeClasses]; // Since Init - not reset by Reset(), so rates can be worked out
+		size_t mFreesPerSizeClass[kMemoryPoolSizeClasses];
+		size_t mFreeBlocksPerSizeClass[kMemoryPoolSizeClasses];  // Holes currently in the free list
+
+		size_t mTotalAllocations;
+		size_t mTotalFrees;
+
+		size_t mCapacity;                                        // Bytes that can be handed out - the arena minus the bookkeeping arrays
+		size_t mBytesInUse;
+		size_t mPeakBytesInUse;
+
+		size_t mFreeBlockCount;
+		size_t mFreeBytesInBlocks;                               // Freed holes between used blocks
+		size_t mUntouchedBytes;                                  // Space past the last block that has never been handed out
+		size_t mLargestFreeBlock;                                // Lower bound - holes are only known to the size class
+
+		float  mFragmentation;                                   // 0 = all free space is in one piece, towards 1 = free space is scattered in small holes
+
+		void Output() const;
+	};
+
+	// ----------------------------------------------------------
+
 	class MemoryPool
 	{
 	public:
@@ -100,8 +206,53 @@ namespace Memory
 		void* AssignMemory(size_t size, bool forArray);
 		void  FreeMemory(size_t size, void* memoryPointer, bool forArray);
 
-		void  Init();
-		void  InitMutex();
+		// Grows a non-array allocation without moving it, by taking space from the free block after it (or from the untouched
+		// space, if it is the last block). Returns false and leaves everything as it was if that is not possible.
+		// On success the allocation must be freed with newSize from then on
+		bool  TryExpandInPlace(void* memoryPointer, size_t oldSize, size_t newSize);
+
+		// For alignments larger than the architecture alignment - e.g. cache lines or SIMD registers
+		void* AssignAlignedMemory(size_t size, size_t alignment);
+		void  FreeAlignedMemory(void* memoryPointer);
+
+		void  Init(size_t totalBytes = kBytesAllocatedForLargeAllocations, size_t bookkeepingBytes = kBytesAllocatedForFreeArray, bool assertOnOutOfMemory = true, bool useHugePages = false);
+		void  InitMutex(const char* name = "MemoryPool");
+
+		// Alternatives to Init - the arena is placed on one NUMA node, or is taken out of another pool
+		void  InitOnNode(unsigned int node, size_t totalBytes = kBytesAllocatedPerNodePool, size_t bookkeepingBytes = kBytesAllocatedForNodeFreeArray);
+		void  InitFromParent(MemoryPool* parent, size_t totalBytes, size_t bookkeepingBytes, bool assertOnOutOfMemory);
+
+		// Movable allocations - reached through a handle rather than a pointer, so that Compact can slide them together.
+		// GetMovableData is only valid until the next Compact, and a resize keeps the handle even if the data has to move
+		MemoryHandle AssignMovableMemory(size_t size);
+		bool         ResizeMovableMemory(MemoryHandle handle, size_t newSize);
+		void         FreeMovableMemory(MemoryHandle handle);
+		void*        GetMovableData(MemoryHandle handle) const;
+		size_t       GetMovableSize(MemoryHandle handle) const;
+
+		// Slides movable blocks down into the holes in front of them, carrying on from where the last call stopped, and hands
+		// any hole left at the end back to the untouched space. Stops after moving maxBytesToMove or looking at maxBlocksToVisit
+		// blocks, so it can be run a little at a time between frames. Returns the bytes moved - any cached data pointers must be
+		// looked up again afterwards
+		size_t       Compact(size_t maxBytesToMove, unsigned int maxBlocksToVisit);
+
+		// Drops every allocation at once - anything still pointing into the pool is left dangling
+		void  Reset();
+
+		// Writes the blocks in use and the bookkeeping out as one blob. root is any allocation from this pool, which
+		// RestoreSnapshot hands back so the data can be found again. Nothing may be allocating from the pool while this runs
+		bool  SaveSnapshot(const char* path, const void* root) const;
+
+		// Replaces the arena with one written by SaveSnapshot and returns where root now is, or nullptr (with the pool left as
+		// it was) if the file could not be used. The blocks link by offset, so nothing needs fixing up - but any pointers stored inside the data will be
+		// wrong if the arena lands somewhere else, so only data that refers to itself by index or offset should be restored.
+		// The new arena starts on a page boundary, so AssignAlignedMemory results only keep their alignment if the old one did too
+		void* RestoreSnapshot(const char* path);
+
+		bool  Owns(const void* memoryPointer) const 
+		{ 
+			return (const char*)memoryPointer >= (const char*)mLargeDataAllocationsList && (const char*)memoryPointer < (const char*)mSavedArraySizes; 
+		}
 
 		static MemoryPool* Get()
 		{
@@ -109,20 +260,44 @@ namespace Memory
 			{
 				mThis  = (MemoryPool*)malloc(sizeof(MemoryPool));
 
+				// Constructed in place as the counters are atomic, so cannot be copied across
 				if(mThis)
-					*mThis = MemoryPool();
+					new (mThis) MemoryPool();
 			}
 
 			return mThis; 
 		}
 
+		// Sets up a pool for every NUMA node - until this is called GetForNode just hands back the main pool
+		static void        InitNodePools();
+		static MemoryPool* GetForNode(unsigned int node)
+		{
+			if (node < Numa::kMaxNumaNodes && mNodePools[node])
+				return mNodePools[node];
+
+			return Get();
+		}
+
+		// Walks every block and prints it - slow, and the mutex must be held. Use GetStats for anything regular
 		void DebugOutputUsage(bool outputPreSized = true, bool outputLargeAllocations = true);
 
-		std::mutex* GetMutex() { return mBlockingMutex; }
+		// Safe to call from any thread without the mutex
+		MemoryPoolStats GetStats() const;
+
+		// How many huge pages are really backing the arena right now - transparent huge pages only appear once memory is touched
+		size_t      GetHugePageCount() const;
+		PoolBacking GetBacking()       const { return mBacking; }
+		void        OutputHugePageUsage() const;
+
+		Profiling::ProfiledMutex* GetMutex() { return mBlockingMutex; }
+
+		// The pool this one was carved out of by InitFromParent, if any
+		MemoryPool* GetParentPool() const { return mParentPool; }
 
 	private:
 
 		static MemoryPool* mThis;
+		static MemoryPool* mNodePools[Numa::kMaxNumaNodes];
 
 		// ---------------------------------------------------------------------- //
 
@@ -136,9 +311,83 @@ namespace Memory
 		ArraySizingData*      mSavedArraySizes;
 		unsigned int          mSavedArraySizesCount;
 
-		std::mutex*           mBlockingMutex;
+		BlockOffset           mHandleTable;                    // Block holding the handle table - an array of block offsets, kNoBlockOffset until first used
+		unsigned int          mHandleCount;
+		MemoryHandle          mFreeHandle;                     // Head of the chain of unused handles, which is threaded through the table
+		BlockOffset           mCompactionCursor;               // The block Compact carries on from
+
+		Profiling::ProfiledMutex* mBlockingMutex;
+
+		// ---------------------------------------------------------------------- //
+
+		// Statistics - only ever written by whoever is allocating from the pool (under the mutex, or the region's single owner),
+		// so they are updated with plain relaxed loads and stores. They are atomic so that GetStats can read them from anywhere
+		std::atomic<size_t>   mMemoryUsed;
+		std::atomic<size_t>   mPeakMemoryUsed;
+		std::atomic<size_t>   mFreeBytesInBlocks;
+		std::atomic<size_t>   mEndOfUsedSpace;                 // Offset from the start of the arena to the end of the last block
+
+		std::atomic<size_t>   mAllocationsPerSizeClass[kMemoryPoolSizeClasses];
+		std::atomic<size_t>   mFreesPerSizeClass[kMemoryPoolSizeClasses];
+		std::atomic<size_t>   mFreeBlocksPerSizeClass[kMemoryPoolSizeClasses];
+
+		// ---------------------------------------------------------------------- //
+
+		size_t                mTotalBytes;                     // Including the bookkeeping arrays at the end
+		size_t                mBookkeepingBytes;               // Size of each of the free list and array size arrays
+		bool                  mAssertOnOutOfMemory;            // Regions are allowed to fill up, as their users fall back to the main pool
+
+		PoolBacking           mBacking;
+		size_t                mMappedBytes;                    // The size actually mapped, which is rounded up when huge pages are used
+		MemoryPool*           mParentPool;                     // Only set when the arena was carved out of another pool
 
-		unsigned int          mMemoryUsed;
+		// Turn the offsets stored in the blocks and bookkeeping arrays back into addresses in this pool's arena, and back again
+		LargeDataMemoryBlock* GetBlock(BlockOffset offset) const
+		{
+			return offset == kNoBlockOffset ? nullptr : (LargeDataMemoryBlock*)((char*)mLargeDataAllocationsList + offset);
+		}
+
+		BlockOffset GetOffset(const void* address) const
+		{
+			return address ? (BlockOffset)((const char*)address - (const char*)mLargeDataAllocationsList) : kNoBlockOffset;
+		}
+
+		// The block header in front of a pointer handed out by AssignMemory
+		static LargeDataMemoryBlock* GetBlockFromData(void* memoryPointer)
+		{
+			return (LargeDataMemoryBlock*)(((char*)memoryPointer) - offsetof(LargeDataMemoryBlock, mData));
+		}
+
+		void  SetupLayout(size_t totalBytes, size_t bookkeepingBytes, bool assertOnOutOfMemory);
+		void  ResetHandles();
+
+		BlockOffset* GetHandleTable() const { return (BlockOffset*)&GetBlock(mHandleTable)->mData[0]; }
+		bool         CreateHandleTable(unsigned int handleCount);
+		bool         IsMovable(LargeDataMemoryBlock* block) const;
+		int          FindFreeListIndex(LargeDataMemoryBlock* block) const;
+
+		// Moves the used block after a hole down to the hole's start, and returns the hole, which is now after it
+		LargeDataMemoryBlock* SlideBlockDown(LargeDataMemoryBlock* hole, LargeDataMemoryBlock* block);
+		void                  TrimFreeTail();
+		void* AllocateArena(size_t bytes, bool useHugePages);
+		void  FreeArena();
+
+		void  ResetStats();
+		void  NoteAllocation(size_t blockSize);
+		void  NoteFree(size_t blockSize);
+		void  NoteFreeBlockAdded(size_t blockSize);
+		void  NoteFreeBlockRemoved(size_t blockSize);
+		void  NoteExpansion(size_t extraBytes);
+
+		static inline void Increment(std::atomic<size_t>& counter, size_t amount)
+		{
+			counter.store(counter.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+		}
+
+		static inline void Decrement(std::atomic<size_t>& counter, size_t amount)
+		{
+			counter.store(counter.load(std::memory_order_relaxed) - amount, std::memory_order_relaxed);
+		}
 
 		// ---------------------------------------------------------------------- //
 	};
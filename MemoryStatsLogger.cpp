@@ -0,0 +1,147 @@
+#include "MemoryStatsLogger.h"
+
+#include "MemoryPool.h"
+#include "Numa.h"
+
+namespace Memory
+{
+	// -------------------------------------------------------------------------
+
+	MemoryStatsLogger::MemoryStatsLogger()
+		: mFile(nullptr)
+		, mInterval(1.0f)
+		, mTimeSinceLastLog(0.0f)
+		, mTimeSinceOpen(0.0f)
+	{
+
+	}
+
+	// -------------------------------------------------------------------------
+
+	MemoryStatsLogger::~MemoryStatsLogger()
+	{
+		Close();
+	}
+
+	// -------------------------------------------------------------------------
+
+	bool MemoryStatsLogger::Open(const char* path, float intervalSeconds)
+	{
+		Close();
+
+		mFile = fopen(path, "w");
+
+		if (!mFile)
+			return false;
+
+		mInterval         = intervalSeconds;
+		mTimeSinceLastLog = 0.0f;
+		mTimeSinceOpen    = 0.0f;
+
+		WriteHeader();
+
+		return true;
+	}
+
+	// -------------------------------------------------------------------------
+
+	void MemoryStatsLogger::Close()
+	{
+		if (!mFile)
+			return;
+
+		fclose(mFile);
+		mFile = nullptr;
+	}
+
+	// -------------------------------------------------------------------------
+
+	void MemoryStatsLogger::Update(float deltaTime)
+	{
+		if (!mFile)
+			return;
+
+		mTimeSinceOpen    += deltaTime;
+		mTimeSinceLastLog += deltaTime;
+
+		if (mTimeSinceLastLog < mInterval)
+			return;
+
+		mTimeSinceLastLog = 0.0f;
+
+		LogNow();
+	}
+
+	// -------------------------------------------------------------------------
+
+	void MemoryStatsLogger::LogNow()
+	{
+		if (!mFile)
+			return;
+
+		MemoryPool* mainPool = MemoryPool::Get();
+
+		WritePool("main", mainPool);
+
+		// GetForNode hands back the main pool for nodes without their own, which has already been written
+		for (unsigned int node = 0; node < Numa::GetNodeCount(); node++)
+		{
+			MemoryPool* nodePool = MemoryPool::GetForNode(node);
+
+			if (nodePool == mainPool)
+				continue;
+
+			char poolName[16];
+			snprintf(poolName, sizeof(poolName), "node%u", node);
+
+			WritePool(poolName, nodePool);
+		}
+
+		fflush(mFile);
+	}
+
+	// -------------------------------------------------------------------------
+
+	void MemoryStatsLogger::WriteHeader()
+	{
+		fprintf(mFile, "time,pool,capacity,bytes_in_use,peak_bytes_in_use,allocations,frees,free_blocks,free_bytes_in_blocks,untouched_bytes,largest_free_block,fragmentation");
+
+		for (unsigned int i = 0; i < kMemoryPoolSizeClasses; i++)
+			fprintf(mFile, ",allocations_%zu", (size_t)1 << i);
+
+		for (unsigned int i = 0; i < kMemoryPoolSizeClasses; i++)
+			fprintf(mFile, ",frees_%zu", (size_t)1 << i);
+
+		for (unsigned int i = 0; i < kMemoryPoolSizeClasses; i++)
+			fprintf(mFile, ",free_blocks_%zu", (size_t)1 << i);
+
+		fprintf(mFile, "\n");
+	}
+
+	// -------------------------------------------------------------------------
+
+	void MemoryStatsLogger::WritePool(const char* poolName, const MemoryPool* pool)
+	{
+		MemoryPoolStats stats = pool->GetStats();
+
+		fprintf(mFile, "%.3f,%s,%zu,%zu,%zu,%zu,%zu,%zu,%zu,%zu,%zu,%.4f", 
+			mTimeSinceOpen, poolName, 
+			stats.mCapacity, stats.mBytesInUse, stats.mPeakBytesInUse, 
+			stats.mTotalAllocations, stats.mTotalFrees, 
+			stats.mFreeBlockCount, stats.mFreeBytesInBlocks, stats.mUntouchedBytes, stats.mLargestFreeBlock, 
+			stats.mFragmentation);
+
+		for (unsigned int i = 0; i < kMemoryPoolSizeClasses; i++)
+			fprintf(mFile, ",%zu", stats.mAllocationsPerSizeClass[i]);
+
+		for (unsigned int i = 0; i < kMemoryPoolSizeClasses; i++)
+			fprintf(mFile, ",%zu", stats.mFreesPerSizeClass[i]);
+
+		for (unsigned int i = 0; i < kMemoryPoolSizeClasses; i++)
+			fprintf(mFile, ",%zu", stats.mFreeBlocksPerSizeClass[i]);
+
+		fprintf(mFile, "\n");
+	}
+
+	// -------------------------------------------------------------------------
+}
\ No newline at end of file
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <stdio.h>
+
+namespace Memory
+{
+	class MemoryPool;
+
+	// ----------------------------------------------------------
+
+	// Appends every pool's counters to a CSV file on a fixed interval - only reads the counters, so no pool is locked to do it
+	class MemoryStatsLogger
+	{
+	public:
+		MemoryStatsLogger();
+		~MemoryStatsLogger();
+
+		bool Open(const char* path, float intervalSeconds);
+		void Close();
+
+		// Called once a frame - only writes out once the interval has passed
+		void Update(float deltaTime);
+		void LogNow();
+
+	private:
+		void WriteHeader();
+		void WritePool(const char* poolName, const MemoryPool* pool);
+
+		FILE* mFile;
+		float mInterval;
+		float mTimeSinceLastLog;
+		float mTimeSinceOpen;
+	};
+
+	// ----------------------------------------------------------
+}
\ No newline at end of file
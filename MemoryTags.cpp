@@ -0,0 +1,152 @@
+#include "MemoryTags.h"
+
+#include <stdio.h>
+
+namespace Memory
+{
+	namespace MemoryTags
+	{
+		// -------------------------------------------------------------------------
+
+		thread_local MemoryTag tCurrentTag = MemoryTag::Untagged;
+
+		// Constant initialised before anything runs, so allocations made during static initialisation are still counted
+		static MemoryTagUsage  sTagUsage[kMemoryTagCount] =
+		{
+			{ 0, 0, 0, 0,                        false },
+			{ 0, 0, 0, MemoryBudgetQuadtree,     false },
+			{ 0, 0, 0, MemoryBudgetLeafLists,    false },
+			{ 0, 0, 0, MemoryBudgetPhysicsState, false },
+			{ 0, 0, 0, MemoryBudgetRender,       false },
+			{ 0, 0, 0, MemoryBudgetIO,           false }
+		};
+
+		static const char*     sTagNames[kMemoryTagCount] =
+		{
+			"Untagged",
+			"Quadtree",
+			"LeafLists",
+			"PhysicsState",
+			"Render",
+			"IO"
+		};
+
+		// -------------------------------------------------------------------------
+
+		const char* GetTagName(MemoryTag tag)
+		{
+			if ((unsigned int)tag >= kMemoryTagCount)
+				return "Unknown";
+
+			return sTagNames[(unsigned int)tag];
+		}
+
+		// -------------------------------------------------------------------------
+
+		void AddTaggedBytes(MemoryTag tag, size_t bytes, bool newAllocation)
+		{
+			if ((unsigned int)tag >= kMemoryTagCount)
+				tag = MemoryTag::Untagged;
+
+			MemoryTagUsage& usage = sTagUsage[(unsigned int)tag];
+
+			size_t newBytes  = usage.mBytes.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+			size_t peakBytes = usage.mPeakBytes.load(std::memory_order_relaxed);
+
+			while (newBytes > peakBytes && !usage.mPeakBytes.compare_exchange_weak(peakBytes, newBytes, std::memory_order_relaxed))
+			{ }
+
+			if (newAllocation)
+				usage.mAllocationCount.fetch_add(1, std::memory_order_relaxed);
+
+			size_t budget = usage.mBudget.load(std::memory_order_relaxed);
+
+			// Only the thread that flips the flag gives the warning - printf does not go through the new override, so this is safe in here
+			if (budget > 0 && newBytes > budget && !usage.mOverBudget.load(std::memory_order_relaxed) && !usage.mOverBudget.exchange(true, std::memory_order_relaxed))
+			{
+				printf("Memory budget exceeded: %s is using %zu bytes, budget is %zu bytes\n", GetTagName(tag), newBytes, budget);
+			}
+		}
+
+		// -------------------------------------------------------------------------
+
+		void RemoveTaggedBytes(MemoryTag tag, size_t bytes)
+		{
+			if ((unsigned int)tag >= kMemoryTagCount)
+				tag = MemoryTag::Untagged;
+
+			MemoryTagUsage& usage = sTagUsage[(unsigned int)tag];
+
+			size_t newBytes = usage.mBytes.fetch_sub(bytes, std::memory_order_relaxed) - bytes;
+
+			usage.mAllocationCount.fetch_sub(1, std::memory_order_relaxed);
+
+			// Back under, so the next time it goes over is warned about again
+			if (usage.mOverBudget.load(std::memory_order_relaxed) && newBytes <= usage.mBudget.load(std::memory_order_relaxed))
+				usage.mOverBudget.store(false, std::memory_order_relaxed);
+		}
+
+		// -------------------------------------------------------------------------
+
+		void SetBudget(MemoryTag tag, size_t bytes)
+		{
+			if ((unsigned int)tag >= kMemoryTagCount)
+				return;
+
+			sTagUsage[(unsigned int)tag].mBudget.store(bytes, std::memory_order_relaxed);
+			sTagUsage[(unsigned int)tag].mOverBudget.store(false, std::memory_order_relaxed);
+		}
+
+		// -------------------------------------------------------------------------
+
+		size_t GetBudget(MemoryTag tag)
+		{
+			if ((unsigned int)tag >= kMemoryTagCount)
+				return 0;
+
+			return sTagUsage[(unsigned int)tag].mBudget.load(std::memory_order_relaxed);
+		}
+
+		// -------------------------------------------------------------------------
+
+		size_t GetBytes(MemoryTag tag)
+		{
+			if ((unsigned int)tag >= kMemoryTagCount)
+				return 0;
+
+			return sTagUsage[(unsigned int)tag].mBytes.load(std::memory_order_relaxed);
+		}
+
+		// -------------------------------------------------------------------------
+
+		size_t GetPeakBytes(MemoryTag tag)
+		{
+			if ((unsigned int)tag >= kMemoryTagCount)
+				return 0;
+
+			return sTagUsage[(unsigned int)tag].mPeakBytes.load(std::memory_order_relaxed);
+		}
+
+		// -------------------------------------------------------------------------
+
+		void OutputUsage()
+		{
+			printf("%-14s %14s %14s %12s %14s\n", "Tag", "Live bytes", "Peak bytes", "Live allocs", "Budget");
+
+			for (unsigned int i = 0; i < kMemoryTagCount; i++)
+			{
+				MemoryTag tag    = (MemoryTag)i;
+				size_t    budget = GetBudget(tag);
+
+				printf("%-14s %14zu %14zu %12zu ", GetTagName(tag), GetBytes(tag), GetPeakBytes(tag), sTagUsage[i].mAllocationCount.load(std::memory_order_relaxed));
+
+				if (budget == 0)
+					printf("%14s\n", "-");
+				else
+					printf("%14zu%s\n", budget, GetPeakBytes(tag) > budget ? "  OVER" : "");
+			}
+		}
+
+		// -------------------------------------------------------------------------
+	}
+}
\ No newline at end of file
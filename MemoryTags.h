@@ -0,0 +1,140 @@
+#pragma once
+
+#include "Commons.h"
+#include "MemoryPool.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <new>
+#include <atomic>
+#include <type_traits>
+
+namespace Memory
+{
+	// ----------------------------------------------------------
+
+	// Which subsystem an allocation is charged to - anything allocated outside of a scope or a tagged allocator is Untagged
+	enum class MemoryTag : uint8_t
+	{
+		Untagged,
+		Quadtree,
+		LeafLists,
+		PhysicsState,
+		Render,
+		IO,
+
+		Count
+	};
+
+	constexpr unsigned int kMemoryTagCount = (unsigned int)MemoryTag::Count;
+
+	// ----------------------------------------------------------
+
+	// One per tag, each on its own cache line so that workers charging different tags do not fight over the same line
+	struct alignas(64) MemoryTagUsage
+	{
+		std::atomic<size_t> mBytes;
+		std::atomic<size_t> mPeakBytes;
+		std::atomic<size_t> mAllocationCount;
+		std::atomic<size_t> mBudget;           // 0 = no budget
+		std::atomic<bool>   mOverBudget;       // Set on the way over the budget, so the warning is only given once per crossing
+	};
+
+	// ----------------------------------------------------------
+
+	// Per-subsystem byte counts, fed by the new/delete overrides and the leaves' lists
+	namespace MemoryTags
+	{
+		// What allocations on this thread are currently charged to - set through ScopedMemoryTag
+		extern thread_local MemoryTag tCurrentTag;
+
+		inline MemoryTag GetCurrentTag() { return tCurrentTag; }
+
+		const char* GetTagName(MemoryTag tag);
+
+		// newAllocation is false when an existing allocation has grown in place, so the allocation count is left alone
+		void        AddTaggedBytes(MemoryTag tag, size_t bytes, bool newAllocation = true);
+		void        RemoveTaggedBytes(MemoryTag tag, size_t bytes);
+
+		void        SetBudget(MemoryTag tag, size_t bytes);
+		size_t      GetBudget(MemoryTag tag);
+
+		size_t      GetBytes(MemoryTag tag);
+		size_t      GetPeakBytes(MemoryTag tag);
+
+		// Live and peak bytes against the budget for every tag
+		void        OutputUsage();
+	}
+
+	// ----------------------------------------------------------
+
+	// Charges everything allocated on this thread to a tag until the scope ends, then puts the previous tag back
+	class ScopedMemoryTag
+	{
+	public:
+		explicit ScopedMemoryTag(MemoryTag tag)
+			: mPreviousTag(MemoryTags::tCurrentTag)
+		{
+			MemoryTags::tCurrentTag = tag;
+		}
+
+		~ScopedMemoryTag()
+		{
+			MemoryTags::tCurrentTag = mPreviousTag;
+		}
+
+		ScopedMemoryTag(const ScopedMemoryTag&)            = delete;
+		ScopedMemoryTag& operator=(const ScopedMemoryTag&) = delete;
+
+	private:
+		MemoryTag mPreviousTag;
+	};
+
+	// ----------------------------------------------------------
+
+	// STL adapter that charges a container to one tag, wherever it happens to be grown from
+	template<typename T, MemoryTag Tag>
+	class TaggedAllocator
+	{
+	public:
+		using value_type                             = T;
+		using is_always_equal                        = std::true_type;
+		using propagate_on_container_move_assignment = std::true_type;
+
+		template<typename U>
+		struct rebind { using other = TaggedAllocator<U, Tag>; };
+
+		TaggedAllocator() noexcept { }
+
+		template<typename U>
+		TaggedAllocator(const TaggedAllocator<U, Tag>&) noexcept { }
+
+		T* allocate(size_t count)
+		{
+			ScopedMemoryTag scope(Tag);
+
+			if (alignof(T) > kArchitectureAlignment)
+				return (T*)::operator new(count * sizeof(T), (std::align_val_t)alignof(T));
+
+			return (T*)::operator new(count * sizeof(T));
+		}
+
+		void deallocate(T* memoryPointer, size_t count) noexcept
+		{
+			// The tag is stored with the allocation, so the free does not need the scope
+			if (alignof(T) > kArchitectureAlignment)
+				::operator delete(memoryPointer, count * sizeof(T), (std::align_val_t)alignof(T));
+			else
+				::operator delete(memoryPointer, count * sizeof(T));
+		}
+
+		template<typename U>
+		bool operator==(const TaggedAllocator<U, Tag>&) const noexcept { return true; }
+
+		template<typename U>
+		bool operator!=(const TaggedAllocator<U, Tag>&) const noexcept { return false; }
+	};
+
+	// ----------------------------------------------------------
+}
\ No newline at end of file
@@ -0,0 +1,270 @@
+#pragma once
+
+#include "MemoryPool.h"
+#include "MemoryTags.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <type_traits>
+
+#if MemoryOverride && CountFrameAllocations
+	#include "AllocationCounter.h"
+#endif
+
+namespace Memory
+{
+	// ----------------------------------------------------------
+
+	// The same cut down std::vector as GrowableArray, but the storage is a movable allocation in a pool, so the pool's compactor
+	// can slide it along to close up the holes left by other lists. The data pointer is cached, so Refresh must be called
+	// after the pool has been compacted and before the array is used again. If the pool fills up, the array moves to the pool
+	// that it was carved out of, or the main pool
+	template<typename T, MemoryTag Tag = MemoryTag::Untagged>
+	class MovableArray
+	{
+		static_assert(std::is_trivially_copy_constructible<T>::value && std::is_trivially_destructible<T>::value, "MovableArray moves its elements with memcpy");
+
+	public:
+		using value_type     = T;
+		using iterator       = T*;
+		using const_iterator = const T*;
+
+		explicit MovableArray(MemoryPool* pool)
+			: mPool(pool)
+			, mHandle(kInvalidMemoryHandle)
+			, mData(nullptr)
+			, mSize(0)
+			, mCapacity(0)
+		{ }
+
+		~MovableArray()
+		{
+			Release();
+		}
+
+		MovableArray(const MovableArray&)            = delete;
+		MovableArray& operator=(const MovableArray&) = delete;
+
+		MovableArray(MovableArray&& other) noexcept
+			: mPool(other.mPool)
+			, mHandle(other.mHandle)
+			, mData(other.mData)
+			, mSize(other.mSize)
+			, mCapacity(other.mCapacity)
+		{
+			other.mHandle   = kInvalidMemoryHandle;
+			other.mData     = nullptr;
+			other.mSize     = 0;
+			other.mCapacity = 0;
+		}
+
+		MovableArray& operator=(MovableArray&& other) noexcept
+		{
+			if (this == &other)
+				return *this;
+
+			Release();
+
+			mPool           = other.mPool;
+			mHandle         = other.mHandle;
+			mData           = other.mData;
+			mSize           = other.mSize;
+			mCapacity       = other.mCapacity;
+
+			other.mHandle   = kInvalidMemoryHandle;
+			other.mData     = nullptr;
+			other.mSize     = 0;
+			other.mCapacity = 0;
+
+			return *this;
+		}
+
+		void push_back(const T& value)
+		{
+			if (mSize == mCapacity && !Grow(mSize + 1))
+				OutOfMemory(mSize + 1);
+
+			mData[mSize] = value;
+			mSize++;
+		}
+
+		void reserve(size_t count)
+		{
+			if (count > mCapacity && !Grow(count))
+				OutOfMemory(count);
+		}
+
+		iterator erase(iterator position)
+		{
+			size_t index = position - mData;
+
+			memmove((void*)(mData + index), (const void*)(mData + index + 1), (mSize - index - 1) * sizeof(T));
+			mSize--;
+
+			return mData + index;
+		}
+
+		void   clear()                          { mSize = 0; }
+
+		size_t size()     const                 { return mSize; }
+		size_t capacity() const                 { return mCapacity; }
+		bool   empty()    const                 { return mSize == 0; }
+
+		T&       operator[](size_t index)       { return mData[index]; }
+		const T& operator[](size_t index) const { return mData[index]; }
+
+		iterator       begin()                  { return mData; }
+		iterator       end()                    { return mData + mSize; }
+		const_iterator begin() const            { return mData; }
+		const_iterator end()   const            { return mData + mSize; }
+
+		// Looks the storage up again, in case the pool has been compacted since
+		void Refresh()
+		{
+			if (mHandle != kInvalidMemoryHandle)
+				mData = (T*)mPool->GetMovableData(mHandle);
+		}
+
+		MemoryPool* GetPool() const { return mPool; }
+
+	private:
+		// False if neither this pool nor the one above it had room - the array is left as it was
+		bool Grow(size_t minimumCapacity)
+		{
+			size_t newCapacity = mCapacity > 0 ? mCapacity * 2 : 8;
+
+			if (newCapacity < minimumCapacity)
+				newCapacity = minimumCapacity;
+
+			LockPool(mPool);
+
+				bool grown = false;
+
+				// A resize keeps the handle - it grows in place where it can, otherwise it is copied within the pool
+				if (mHandle == kInvalidMemoryHandle)
+				{
+					mHandle = mPool->AssignMovableMemory(newCapacity * sizeof(T));
+					grown   = mHandle != kInvalidMemoryHandle;
+				}
+				else
+				{
+					grown   = mPool->ResizeMovableMemory(mHandle, newCapacity * sizeof(T));
+				}
+
+				if (grown)
+					mData = (T*)mPool->GetMovableData(mHandle);
+
+			UnlockPool(mPool);
+
+			if (!grown)
+				return MoveToParentPool(newCapacity);
+
+#if UseMemoryTags
+			MemoryTags::AddTaggedBytes(Tag, (newCapacity - mCapacity) * sizeof(T), mCapacity == 0);
+#endif
+
+			mCapacity = newCapacity;
+
+			return true;
+		}
+
+		bool MoveToParentPool(size_t newCapacity)
+		{
+			// Regions that were not carved out of another pool fall back onto the main one
+			MemoryPool* parentPool = mPool->GetParentPool() ? mPool->GetParentPool() : MemoryPool::Get();
+
+			if (parentPool == mPool || parentPool->GetStats().mCapacity == 0)
+			{
+				assert("Out of memory" && false);
+				return false;
+			}
+
+#if MemoryOverride && CountFrameAllocations
+			// The region is this leaf's own, but the pool it spills onto is shared with everything else
+			AllocationCounter::RecordAllocation(newCapacity * sizeof(T));
+#endif
+
+			LockPool(parentPool);
+
+				MemoryHandle newHandle = parentPool->AssignMovableMemory(newCapacity * sizeof(T));
+				T*           newData   = newHandle != kInvalidMemoryHandle ? (T*)parentPool->GetMovableData(newHandle) : nullptr;
+
+				if (newData && mData)
+					memcpy((void*)newData, (const void*)mData, mSize * sizeof(T));
+
+			UnlockPool(parentPool);
+
+			if (!newData)
+			{
+				assert("Out of memory" && false);
+				return false;
+			}
+
+			// Gets counted as a new allocation again below
+			Release(false);
+
+			mPool     = parentPool;
+			mHandle   = newHandle;
+			mData     = newData;
+
+#if UseMemoryTags
+			MemoryTags::AddTaggedBytes(Tag, newCapacity * sizeof(T));
+#endif
+
+			mCapacity = newCapacity;
+
+			return true;
+		}
+
+		// The leaves keep indices into their lists, so carrying on an element short would quietly break them - stop instead
+		static void OutOfMemory(size_t capacity)
+		{
+			fprintf(stderr, "MovableArray could not grow to %zu elements - every pool it can use is full\n", capacity);
+			abort();
+		}
+
+		void Release(bool clearSize = true)
+		{
+			if (mHandle != kInvalidMemoryHandle)
+			{
+				LockPool(mPool);
+					mPool->FreeMovableMemory(mHandle);
+				UnlockPool(mPool);
+
+#if UseMemoryTags
+				MemoryTags::RemoveTaggedBytes(Tag, mCapacity * sizeof(T));
+#endif
+			}
+
+			mHandle   = kInvalidMemoryHandle;
+			mData     = nullptr;
+			mCapacity = 0;
+
+			if (clearSize)
+				mSize = 0;
+		}
+
+		// A leaf's own region has no mutex, but the pool it falls back onto is shared
+		static void LockPool(MemoryPool* pool)
+		{
+			if (Profiling::ProfiledMutex* mutex = pool->GetMutex())
+				mutex->lock();
+		}
+
+		static void UnlockPool(MemoryPool* pool)
+		{
+			if (Profiling::ProfiledMutex* mutex = pool->GetMutex())
+				mutex->unlock();
+		}
+
+		MemoryPool*  mPool;
+		MemoryHandle mHandle;
+		T*           mData;
+		size_t       mSize;
+		size_t       mCapacity;
+	};
+
+	// ----------------------------------------------------------
+}
\ No newline at end of file
@@ -0,0 +1,223 @@
+#include "Numa.h"
+
+#include <malloc.h>
+#include <stdio.h>
+#include <stdint.h>
+
+#ifdef _WIN32
+	#include <windows.h>
+	#include <psapi.h>
+#else
+	#include <sched.h>
+	#include <unistd.h>
+	#include <sys/mman.h>
+	#include <sys/syscall.h>
+#endif
+
+namespace Numa
+{
+	// -------------------------------------------------------------------------
+
+#ifndef _WIN32
+	// Values from <numaif.h> - defined here so that libnuma does not need to be installed to build
+	constexpr int kMemoryPolicyBind = 2;
+
+	// Reads a /sys cpulist such as "0-3,8-11" into an affinity mask
+	static bool ReadNodeCPUs(unsigned int node, cpu_set_t& cpus)
+	{
+		char path[128];
+		snprintf(path, sizeof(path), "/sys/devices/system/node/node%u/cpulist", node);
+
+		FILE* file = fopen(path, "r");
+
+		if (!file)
+			return false;
+
+		CPU_ZERO(&cpus);
+
+		unsigned int first = 0;
+		unsigned int last  = 0;
+		bool         found = false;
+
+		while (fscanf(file, "%u", &first) == 1)
+		{
+			last = first;
+
+			int next = fgetc(file);
+
+			if (next == '-')
+			{
+				if (fscanf(file, "%u", &last) != 1)
+					break;
+
+				next = fgetc(file);
+			}
+
+			for (unsigned int cpu = first; cpu <= last && cpu < CPU_SETSIZE; cpu++)
+			{
+				CPU_SET(cpu, &cpus);
+				found = true;
+			}
+
+			if (next != ',')
+				break;
+		}
+
+		fclose(file);
+
+		return found;
+	}
+#endif
+
+	// -------------------------------------------------------------------------
+
+	unsigned int GetNodeCount()
+	{
+		static unsigned int sNodeCount = 0;
+
+		if (sNodeCount > 0)
+			return sNodeCount;
+
+		unsigned int nodeCount = 1;
+
+#ifdef _WIN32
+		ULONG highestNode = 0;
+
+		if (GetNumaHighestNodeNumber(&highestNode))
+			nodeCount = (unsigned int)highestNode + 1;
+#else
+		// Nodes are numbered from 0 with no gaps on the machines we run on, so count until one is missing
+		nodeCount = 0;
+
+		cpu_set_t cpus;
+
+		while (nodeCount < kMaxNumaNodes && ReadNodeCPUs(nodeCount, cpus))
+			nodeCount++;
+
+		if (nodeCount == 0)
+			nodeCount = 1;
+#endif
+
+		if (nodeCount > kMaxNumaNodes)
+			nodeCount = kMaxNumaNodes;
+
+		sNodeCount = nodeCount;
+
+		return sNodeCount;
+	}
+
+	// -------------------------------------------------------------------------
+
+	unsigned int GetCurrentNode()
+	{
+#ifdef _WIN32
+		PROCESSOR_NUMBER processor;
+		USHORT           node = 0;
+
+		GetCurrentProcessorNumberEx(&processor);
+
+		if (!GetNumaProcessorNodeEx(&processor, &node))
+			return 0;
+
+		return (unsigned int)node;
+#else
+		unsigned int cpu  = 0;
+		unsigned int node = 0;
+
+		if (syscall(SYS_getcpu, &cpu, &node, nullptr) != 0)
+			return 0;
+
+		return node;
+#endif
+	}
+
+	// -------------------------------------------------------------------------
+
+	bool PinThisThreadToNode(unsigned int node)
+	{
+		if (node >= GetNodeCount())
+			return false;
+
+#ifdef _WIN32
+		GROUP_AFFINITY affinity = {};
+
+		if (!GetNumaNodeProcessorMaskEx((USHORT)node, &affinity))
+			return false;
+
+		return SetThreadGroupAffinity(GetCurrentThread(), &affinity, nullptr) != 0;
+#else
+		cpu_set_t cpus;
+
+		if (!ReadNodeCPUs(node, cpus))
+			return false;
+
+		return sched_setaffinity(0, sizeof(cpus), &cpus) == 0;
+#endif
+	}
+
+	// -------------------------------------------------------------------------
+
+	void* AllocateOnNode(size_t bytes, unsigned int node)
+	{
+#ifdef _WIN32
+		void* memory = VirtualAllocExNuma(GetCurrentProcess(), nullptr, bytes, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE, (DWORD)node);
+
+		if (!memory)
+			memory = VirtualAlloc(nullptr, bytes, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+
+		return memory;
+#else
+		void* memory = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+		if (memory == MAP_FAILED)
+			return nullptr;
+
+		// Nothing has been touched yet, so binding now means every page is created on the node
+		// If this fails (e.g. no NUMA support in the kernel) the pages just go wherever first-touch puts them
+		unsigned long nodeMask = 1UL << node;
+		syscall(SYS_mbind, memory, bytes, kMemoryPolicyBind, &nodeMask, (unsigned long)(kMaxNumaNodes + 1), 0);
+
+		return memory;
+#endif
+	}
+
+	// -------------------------------------------------------------------------
+
+	void FreeOnNode(void* memory, size_t bytes)
+	{
+		if (!memory)
+			return;
+
+#ifdef _WIN32
+		VirtualFree(memory, 0, MEM_RELEASE);
+#else
+		munmap(memory, bytes);
+#endif
+	}
+
+	// -------------------------------------------------------------------------
+
+	unsigned int GetNodeOfAddress(const void* address)
+	{
+#ifdef _WIN32
+		PSAPI_WORKING_SET_EX_INFORMATION info = {};
+		info.VirtualAddress = (PVOID)address;
+
+		if (!QueryWorkingSetEx(GetCurrentProcess(), &info, sizeof(info)) || !info.VirtualAttributes.Valid)
+			return kMaxNumaNodes;
+
+		return (unsigned int)info.VirtualAttributes.Node;
+#else
+		// move_pages with no target nodes just reports where each page is
+		void* page   = (void*)((uintptr_t)address & ~((uintptr_t)sysconf(_SC_PAGESIZE) - 1));
+		int   status = -1;
+
+		if (syscall(SYS_move_pages, 0, 1UL, &page, nullptr, &status, 0) != 0 || status < 0)
+			return kMaxNumaNodes;
+
+		return (unsigned int)status;
+#endif
+	}
+
+	// -------------------------------------------------------------------------
+}
\ No newline at end of file
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <stddef.h>
+
+// Thin layer over the OS NUMA calls, so that the pools and the quadtree's workers do not need platform code
+namespace Numa
+{
+	// ----------------------------------------------------------
+
+	constexpr unsigned int kMaxNumaNodes = 8;
+
+	// ----------------------------------------------------------
+
+	// Always at least 1 - machines without NUMA are treated as a single node
+	unsigned int GetNodeCount();
+
+	// The node of the core the calling thread is running on right now
+	unsigned int GetCurrentNode();
+
+	// Restricts the calling thread to the cores of one node
+	bool         PinThisThreadToNode(unsigned int node);
+
+	// Memory whose physical pages are placed on the given node - falls back to normal memory if the OS will not place it
+	void*        AllocateOnNode(size_t bytes, unsigned int node);
+	void         FreeOnNode(void* memory, size_t bytes);
+
+	// Which node the page holding this address currently lives on - returns kMaxNumaNodes if it cannot be found
+	unsigned int GetNodeOfAddress(const void* address);
+
+	// ----------------------------------------------------------
+}
\ No newline at end of file
@@ -0,0 +1,166 @@
+#include "NumaBenchmark.h"
+
+#include "Numa.h"
+#include "MemoryPool.h"
+
+#include <chrono>
+#include <thread>
+#include <iostream>
+#include <iomanip>
+
+#include <stdint.h>
+#include <string.h>
+
+namespace Benchmarks
+{
+	// -------------------------------------------------------------------------
+
+	// Large enough to be well out of the last level cache
+	constexpr size_t       kNumaBenchmarkBytes  = 256 * 1024 * 1024;
+	constexpr unsigned int kNumaBenchmarkPasses = 5;
+
+	// -------------------------------------------------------------------------
+
+	// Best of several passes, in GB/s
+	static double MeasureReadBandwidth(const uint64_t* data, size_t count)
+	{
+		double            bestSeconds = 1e9;
+		volatile uint64_t sink        = 0;
+
+		for (unsigned int pass = 0; pass < kNumaBenchmarkPasses; pass++)
+		{
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+			uint64_t sum = 0;
+
+			for (size_t i = 0; i < count; i++)
+				sum += data[i];
+
+			sink = sum;
+
+			std::chrono::duration<double> taken = std::chrono::steady_clock::now() - start;
+
+			if (taken.count() < bestSeconds)
+				bestSeconds = taken.count();
+		}
+
+		(void)sink;
+
+		return ((double)(count * sizeof(uint64_t)) / bestSeconds) / 1e9;
+	}
+
+	// -------------------------------------------------------------------------
+
+	// Fraction of the pages in the region that are actually on the node they were asked to be on
+	static double MeasurePlacement(const char* memory, size_t bytes, unsigned int node)
+	{
+		const size_t stride  = 2 * 1024 * 1024;
+		unsigned int checked = 0;
+		unsigned int onNode  = 0;
+
+		for (size_t offset = 0; offset < bytes; offset += stride)
+		{
+			unsigned int pageNode = Numa::GetNodeOfAddress(memory + offset);
+
+			if (pageNode >= Numa::kMaxNumaNodes)
+				continue;
+
+			checked++;
+
+			if (pageNode == node)
+				onNode++;
+		}
+
+		return checked > 0 ? (double)onNode / (double)checked : 0.0;
+	}
+
+	// -------------------------------------------------------------------------
+
+	void MeasureNumaBandwidth()
+	{
+		unsigned int nodeCount = Numa::GetNodeCount();
+
+		std::cout << "NUMA benchmark - " << nodeCount << " node(s), " << (kNumaBenchmarkBytes / (1024 * 1024)) << "MB per node" << std::endl;
+
+		double bandwidth[Numa::kMaxNumaNodes][Numa::kMaxNumaNodes] = {};
+
+		double       localTotal  = 0.0;
+		double       remoteTotal = 0.0;
+		unsigned int localCount  = 0;
+		unsigned int remoteCount = 0;
+
+		for (unsigned int memoryNode = 0; memoryNode < nodeCount; memoryNode++)
+		{
+			uint64_t* data = (uint64_t*)Numa::AllocateOnNode(kNumaBenchmarkBytes, memoryNode);
+
+			if (!data)
+			{
+				std::cout << "Could not allocate on node " << memoryNode << std::endl;
+				continue;
+			}
+
+			// Touch everything from a thread on the node, so that first-touch agrees with the binding on systems without mbind
+			std::thread toucher([&]()
+			{
+				Numa::PinThisThreadToNode(memoryNode);
+				memset(data, 1, kNumaBenchmarkBytes);
+			});
+			toucher.join();
+
+			std::cout << "Node " << memoryNode << " pages actually on node: " << std::fixed << std::setprecision(1) << (100.0 * MeasurePlacement((const char*)data, kNumaBenchmarkBytes, memoryNode)) << "%" << std::endl;
+
+			for (unsigned int cpuNode = 0; cpuNode < nodeCount; cpuNode++)
+			{
+				std::thread reader([&]()
+				{
+					Numa::PinThisThreadToNode(cpuNode);
+					bandwidth[cpuNode][memoryNode] = MeasureReadBandwidth(data, kNumaBenchmarkBytes / sizeof(uint64_t));
+				});
+				reader.join();
+
+				if (cpuNode == memoryNode)
+				{
+					localTotal += bandwidth[cpuNode][memoryNode];
+					localCount++;
+				}
+				else
+				{
+					remoteTotal += bandwidth[cpuNode][memoryNode];
+					remoteCount++;
+				}
+			}
+
+			Numa::FreeOnNode(data, kNumaBenchmarkBytes);
+		}
+
+		// Rows are where the reading thread ran, columns are where the memory was
+		std::cout << std::endl << "Read bandwidth (GB/s) - rows: CPU node, columns: memory node" << std::endl;
+
+		for (unsigned int cpuNode = 0; cpuNode < nodeCount; cpuNode++)
+		{
+			std::cout << "CPU " << cpuNode << ":";
+
+			for (unsigned int memoryNode = 0; memoryNode < nodeCount; memoryNode++)
+			{
+				std::cout << "\t" << std::fixed << std::setprecision(2) << bandwidth[cpuNode][memoryNode];
+			}
+
+			std::cout << std::endl;
+		}
+
+		std::cout << std::endl;
+		std::cout << "Average local bandwidth:  " << (localCount  > 0 ? localTotal  / localCount  : 0.0) << " GB/s" << std::endl;
+
+		if (remoteCount > 0)
+		{
+			std::cout << "Average remote bandwidth: " << remoteTotal / remoteCount << " GB/s" << std::endl;
+			std::cout << "Remote / local ratio:     " << (remoteTotal / remoteCount) / (localTotal / localCount) << std::endl;
+		}
+		else
+		{
+			std::cout << "Average remote bandwidth: N/A (single node)" << std::endl;
+		}
+	}
+
+	// -------------------------------------------------------------------------
+}
\ No newline at end of file
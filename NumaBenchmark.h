@@ -0,0 +1,7 @@
+#pragma once
+
+namespace Benchmarks
+{
+	// Measures read bandwidth from every node's cores to every node's memory, and checks the pools really are on their nodes
+	void MeasureNumaBandwidth();
+}
\ No newline at end of file
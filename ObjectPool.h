@@ -0,0 +1,168 @@
+#pragma once
+
+#include "MemoryPool.h"
+
+#include <new>
+#include <utility>
+
+namespace Memory
+{
+	// ----------------------------------------------------------
+
+	// Fixed size object storage - objects are constructed into contiguous chunks in the order they are acquired,
+	// acquire/release are O(1) through an intrusive free list, and ReleaseAll tears everything down in one pass
+	template<typename T>
+	class ObjectPool
+	{
+	public:
+		explicit ObjectPool(unsigned int objectsPerChunk = 64)
+			: mChunks(nullptr)
+			, mFreeList(nullptr)
+			, mObjectsPerChunk(objectsPerChunk > 0 ? objectsPerChunk : 1)
+			, mLiveCount(0)
+		{ }
+
+		~ObjectPool()
+		{
+			ReleaseAll();
+
+			while (mChunks)
+			{
+				Chunk* next = mChunks->mNext;
+
+				FreeChunk(mChunks);
+
+				mChunks = next;
+			}
+		}
+
+		ObjectPool(const ObjectPool&)            = delete;
+		ObjectPool& operator=(const ObjectPool&) = delete;
+
+		// Makes sure the next 'count' acquires all come from the same chunk, so that they end up next to each other
+		void Reserve(unsigned int count)
+		{
+			if (mChunks && mChunks->mCapacity - mChunks->mUsed >= count)
+				return;
+
+			AddChunk(count);
+		}
+
+		template<typename... Args>
+		T* Acquire(Args&&... args)
+		{
+			Slot* slot = mFreeList;
+
+			if (slot)
+			{
+				mFreeList = slot->mNextFree;
+			}
+			else
+			{
+				// Nothing free to re-use, so take the next unused slot in the newest chunk
+				if (!mChunks || mChunks->mUsed == mChunks->mCapacity)
+					AddChunk(mObjectsPerChunk);
+
+				slot = &mChunks->mSlots[mChunks->mUsed];
+				mChunks->mUsed++;
+			}
+
+			slot->mLive = true;
+			mLiveCount++;
+
+			return new (&slot->mStorage[0]) T(std::forward<Args>(args)...);
+		}
+
+		void Release(T* object)
+		{
+			if (!object)
+				return;
+
+			object->~T();
+
+			// The storage is at the start of the slot, so the object's address is the slot's address
+			Slot* slot = (Slot*)object;
+			slot->mLive     = false;
+			slot->mNextFree = mFreeList;
+			mFreeList       = slot;
+
+			mLiveCount--;
+		}
+
+		// Destroys every live object - the chunks are kept around for the next build
+		void ReleaseAll()
+		{
+			for (Chunk* chunk = mChunks; chunk != nullptr; chunk = chunk->mNext)
+			{
+				for (unsigned int i = 0; i < chunk->mUsed; i++)
+				{
+					if (chunk->mSlots[i].mLive)
+						((T*)&chunk->mSlots[i].mStorage[0])->~T();
+				}
+
+				chunk->mUsed = 0;
+			}
+
+			mFreeList  = nullptr;
+			mLiveCount = 0;
+		}
+
+		unsigned int GetLiveCount() const { return mLiveCount; }
+
+	private:
+		struct Slot
+		{
+			alignas(T) char mStorage[sizeof(T)];
+			Slot*           mNextFree;
+			bool            mLive;
+		};
+
+		struct Chunk
+		{
+			Chunk*       mNext;
+			unsigned int mCapacity;
+			unsigned int mUsed;
+			Slot*        mSlots;
+		};
+
+		void AddChunk(unsigned int capacity)
+		{
+			// The header and the slots are one allocation, with the slots starting on their own alignment
+			size_t headerSize = (sizeof(Chunk) + alignof(Slot) - 1) & ~(alignof(Slot) - 1);
+			size_t totalSize  = headerSize + (sizeof(Slot) * capacity);
+
+			char*  memory     = nullptr;
+
+			if (alignof(Slot) > kArchitectureAlignment)
+				memory = (char*)::operator new(totalSize, (std::align_val_t)alignof(Slot));
+			else
+				memory = (char*)::operator new(totalSize);
+
+			Chunk* chunk      = (Chunk*)memory;
+			chunk->mNext      = mChunks;
+			chunk->mCapacity  = capacity;
+			chunk->mUsed      = 0;
+			chunk->mSlots     = (Slot*)(memory + headerSize);
+
+			mChunks           = chunk;
+		}
+
+		void FreeChunk(Chunk* chunk)
+		{
+			size_t headerSize = (sizeof(Chunk) + alignof(Slot) - 1) & ~(alignof(Slot) - 1);
+			size_t totalSize  = headerSize + (sizeof(Slot) * chunk->mCapacity);
+
+			if (alignof(Slot) > kArchitectureAlignment)
+				::operator delete((void*)chunk, totalSize, (std::align_val_t)alignof(Slot));
+			else
+				::operator delete((void*)chunk, totalSize);
+		}
+
+		Chunk*       mChunks;          // Newest first - acquires always come out of the head chunk
+		Slot*        mFreeList;
+		unsigned int mObjectsPerChunk;
+		unsigned int mLiveCount;
+	};
+
+	// ----------------------------------------------------------
+}
\ No newline at end of file
@@ -16,10 +16,15 @@ ParentQuadrant::ParentQuadrant(unsigned int thisDepth, Vec3& minBounds, Vec3& ma
 	, mLastTime(std::chrono::steady_clock::now())
 {
 	mLastTime = std::chrono::steady_clock::now();
+}
+
+// ----------------------------------------------
 
+void ParentQuadrant::CreateChildren(Memory::ObjectPool<ParentQuadrant>& parentPool, Memory::ObjectPool<LeafQuadrant>& leafPool, std::vector<ParentQuadrant*>& buildQueue)
+{
 	// Calculate half the region size so we can pass the right bounds into the child quadrants
 	// Does not halve the Y as this is not an octree
-	Vec3 halfBoundsExtents    = maxBounds - minBounds;
+	Vec3 halfBoundsExtents    = mMaxBounds - mMinBounds;
 	     halfBoundsExtents.x /= 2.0f;
 	     halfBoundsExtents.z /= 2.0f;
 
@@ -29,17 +34,17 @@ ParentQuadrant::ParentQuadrant(unsigned int thisDepth, Vec3& minBounds, Vec3& ma
 	unsigned int row;
 
 	// If the next level down is the max depth, then all of the children need to be leaves
-	if (thisDepth + 1 >= sMaxDepth)
+	if (mThisDepth + 1 >= sMaxDepth)
 	{
 		for (unsigned int i = 0; i < 4; i++) 
 		{
 			column = i % 2;
 			row    = i / 2;
 
-			newMinBounds = minBounds + Vec3{ (halfBoundsExtents.x * column),       0.0f, halfBoundsExtents.z * row };
-			newMaxBounds = minBounds + Vec3{ (halfBoundsExtents.x * (column + 1)), 0.0f, halfBoundsExtents.z * (row + 1) };
+			newMinBounds = mMinBounds + Vec3{ (halfBoundsExtents.x * column),       0.0f, halfBoundsExtents.z * row };
+			newMaxBounds = mMinBounds + Vec3{ (halfBoundsExtents.x * (column + 1)), 0.0f, halfBoundsExtents.z * (row + 1) };
 
-			mChildQuadrants[i] = new LeafQuadrant(newMinBounds, newMaxBounds, tree);
+			mChildQuadrants[i] = leafPool.Acquire(newMinBounds, newMaxBounds, mTreePartOf);
 		}
 	}
 	else // We are not quite at the max depth yet so keep going with parents
@@ -49,10 +54,15 @@ ParentQuadrant::ParentQuadrant(unsigned int thisDepth, Vec3& minBounds, Vec3& ma
 			column = i % 2;
 			row    = i / 2;
 
-			newMinBounds = minBounds + Vec3{ (halfBoundsExtents.x * column),       0.0f, halfBoundsExtents.z * row       };
-			newMaxBounds = minBounds + Vec3{ (halfBoundsExtents.x * (column + 1)), 0.0f, halfBoundsExtents.z * (row + 1) };
+			newMinBounds = mMinBounds + Vec3{ (halfBoundsExtents.x * column),       0.0f, halfBoundsExtents.z * row       };
+			newMaxBounds = mMinBounds + Vec3{ (halfBoundsExtents.x * (column + 1)), 0.0f, halfBoundsExtents.z * (row + 1) };
 
-			mChildQuadrants[i] = new ParentQuadrant(thisDepth + 1, newMinBounds, newMaxBounds, tree);
+			ParentQuadrant* child = parentPool.Acquire(mThisDepth + 1, newMinBounds, newMaxBounds, mTreePartOf);
+
+			mChildQuadrants[i] = child;
+
+			// Children are filled in once this whole level has been created
+			buildQueue.push_back(child);
 		}
 	}
 }
@@ -71,13 +81,10 @@ ParentQuadrant::~ParentQuadrant()
 		}
 	}
 
+	// The children themselves are owned by the tree's object pools, so are not deleted here
 	for (unsigned int i = 0; i < 4; i++)
 	{
-		if (mChildQuadrants[i])
-		{
-			delete mChildQuadrants[i];
-			mChildQuadrants[i] = nullptr;
-		}
+		mChildQuadrants[i] = nullptr;
 	}
 }
 
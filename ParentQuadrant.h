@@ -1,8 +1,10 @@
 #include "BaseQuadrant.h"
 
 #include "Commons.h"
+#include "ObjectPool.h"
 
 #include <mutex>
+#include <vector>
 
 class LeafQuadrant;
 
@@ -12,6 +14,9 @@ public:
 	ParentQuadrant(unsigned int thisDepth, Vec3& minBounds, Vec3& maxBounds, Quadtree& tree);
 	~ParentQuadrant() override;
 
+	// Creates the four children out of the pools - any children that are parents are added to the build queue so that the tree is built breadth first
+	void            CreateChildren(Memory::ObjectPool<ParentQuadrant>& parentPool, Memory::ObjectPool<LeafQuadrant>& leafPool, std::vector<ParentQuadrant*>& buildQueue);
+
 	void            AddCube(unsigned int cubeIndex)         override;
 	void            Update(const float deltaTime)           override;
 
@@ -0,0 +1,298 @@
+#include "PerfCounters.h"
+
+#include <iostream>
+#include <atomic>
+
+#include <string.h>
+
+#if defined(__linux__)
+	#include <linux/perf_event.h>
+	#include <sys/syscall.h>
+	#include <unistd.h>
+#endif
+
+// -------------------------------------------------------------- //
+
+// One per thread that has asked for counters. The file descriptors are left open until the program ends - the threads
+// that use them live as long as the tree does
+struct ThreadCounterGroup
+{
+	int               mLeaderFd;
+	unsigned int      mMemberCount;
+	unsigned int      mMemberCounters[kPerfCounterCount]; // Which counter each member is, in the order the group reads them back
+	std::atomic<bool> mOpen;                              // Set once the rest is filled in, for ReadAllThreads on other threads
+};
+
+static ThreadCounterGroup sThreadGroups[kMaxTimingThreads];
+
+// -------------------------------------------------------------- //
+
+#if defined(__linux__)
+static int OpenCounter(uint32_t type, uint64_t config, int groupFd)
+{
+	perf_event_attr attributes;
+	memset(&attributes, 0, sizeof(attributes));
+
+	attributes.size           = sizeof(attributes);
+	attributes.type           = type;
+	attributes.config         = config;
+	attributes.read_format    = PERF_FORMAT_GROUP;
+	attributes.exclude_kernel = 1;
+	attributes.exclude_hv     = 1;
+
+	// This thread, on whichever CPU it happens to be on - the members only count while the leader does
+	return (int)syscall(__NR_perf_event_open, &attributes, 0, -1, groupFd, 0);
+}
+
+// -------------------------------------------------------------- //
+
+static void ReadGroup(const ThreadCounterGroup& group, PerfCounterValues& values)
+{
+	// The number of members, then one value each
+	uint64_t buffer[1 + kPerfCounterCount];
+
+	if (read(group.mLeaderFd, buffer, sizeof(buffer)) < (ssize_t)sizeof(uint64_t))
+		return;
+
+	unsigned int memberCount = (unsigned int)buffer[0] < group.mMemberCount ? (unsigned int)buffer[0] : group.mMemberCount;
+
+	for (unsigned int i = 0; i < memberCount; i++)
+		values.mValues[group.mMemberCounters[i]] = buffer[1 + i];
+}
+#endif
+
+// -------------------------------------------------------------- //
+
+unsigned int PerfCounters::GetThreadIndex()
+{
+	static std::atomic<unsigned int> sThreadsSeen(0);
+	thread_local unsigned int        tThreadIndex = sThreadsSeen.fetch_add(1, std::memory_order_relaxed);
+
+	return tThreadIndex;
+}
+
+// -------------------------------------------------------------- //
+
+bool PerfCounters::OpenForThisThread()
+{
+	// 0 = failed, 1 = open, anything else = not tried yet
+	thread_local int tOpened = -1;
+
+	if (tOpened >= 0)
+		return tOpened == 1;
+
+	tOpened = 0;
+
+	unsigned int threadIndex = GetThreadIndex();
+
+	if (threadIndex >= kMaxTimingThreads)
+		return false;
+
+#if defined(__linux__)
+	static const struct { uint32_t mType; uint64_t mConfig; } counterConfigs[kPerfCounterCount] =
+	{
+		{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+		{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+		{ PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D  | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16) },
+		{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+		{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+		{ PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16) }
+	};
+
+	ThreadCounterGroup& group = sThreadGroups[threadIndex];
+
+	group.mLeaderFd    = -1;
+	group.mMemberCount = 0;
+
+	// Whatever the CPU does not have, or a VM does not pass through, is skipped rather than losing the whole group
+	for (unsigned int i = 0; i < kPerfCounterCount; i++)
+	{
+		int fd = OpenCounter(counterConfigs[i].mType, counterConfigs[i].mConfig, group.mLeaderFd);
+
+		if (fd < 0)
+			continue;
+
+		if (group.mLeaderFd < 0)
+			group.mLeaderFd = fd;
+
+		group.mMemberCounters[group.mMemberCount] = i;
+		group.mMemberCount++;
+	}
+
+	if (group.mMemberCount == 0)
+		return false;
+
+	group.mOpen.store(true, std::memory_order_release);
+
+	tOpened = 1;
+
+	return true;
+#else
+	return false;
+#endif
+}
+
+// -------------------------------------------------------------- //
+
+void PerfCounters::ReadThisThread(PerfCounterValues& values)
+{
+	values = PerfCounterValues();
+
+#if defined(__linux__)
+	unsigned int threadIndex = GetThreadIndex();
+
+	if (threadIndex < kMaxTimingThreads && sThreadGroups[threadIndex].mOpen.load(std::memory_order_relaxed))
+		ReadGroup(sThreadGroups[threadIndex], values);
+#endif
+}
+
+// -------------------------------------------------------------- //
+
+void PerfCounters::ReadAllThreads(PerfCounterValues& values)
+{
+	values = PerfCounterValues();
+
+#if defined(__linux__)
+	for (unsigned int i = 0; i < kMaxTimingThreads; i++)
+	{
+		if (!sThreadGroups[i].mOpen.load(std::memory_order_acquire))
+			continue;
+
+		PerfCounterValues threadValues = PerfCounterValues();
+		ReadGroup(sThreadGroups[i], threadValues);
+
+		values += threadValues;
+	}
+#endif
+}
+
+// -------------------------------------------------------------- //
+
+const char* PerfCounters::GetCounterName(PerfCounter counter)
+{
+	static const char* counterNames[kPerfCounterCount] =
+	{
+		"cycles",
+		"instructions",
+		"L1D misses",
+		"LLC misses",
+		"branch misses",
+		"dTLB misses"
+	};
+
+	if ((unsigned int)counter >= kPerfCounterCount)
+		return "unknown";
+
+	return counterNames[(unsigned int)counter];
+}
+
+// -------------------------------------------------------------- //
+// -------------------------------------------------------------- //
+
+PerfStageCounters::PerfStageCounters()
+	: mSlots()
+{
+
+}
+
+// -------------------------------------------------------------- //
+
+PerfStageCounters::Slot* PerfStageCounters::GetThreadSlot()
+{
+	if (!PerfCounters::OpenForThisThread())
+		return nullptr;
+
+	return &mSlots[PerfCounters::GetThreadIndex()];
+}
+
+// -------------------------------------------------------------- //
+
+void PerfStageCounters::StartTiming()
+{
+	if (Slot* slot = GetThreadSlot())
+		PerfCounters::ReadThisThread(slot->mStart);
+}
+
+// -------------------------------------------------------------- //
+
+void PerfStageCounters::AddMeasurement()
+{
+	Slot* slot = GetThreadSlot();
+
+	if (!slot)
+		return;
+
+	PerfCounterValues now;
+	PerfCounters::ReadThisThread(now);
+
+	slot->mTotal += now - slot->mStart;
+	slot->mMeasurements++;
+}
+
+// -------------------------------------------------------------- //
+
+void PerfStageCounters::AddValues(const PerfCounterValues& values)
+{
+	unsigned int threadIndex = PerfCounters::GetThreadIndex();
+
+	if (threadIndex >= kMaxTimingThreads)
+		return;
+
+	mSlots[threadIndex].mTotal += values;
+	mSlots[threadIndex].mMeasurements++;
+}
+
+// -------------------------------------------------------------- //
+
+PerfCounterValues PerfStageCounters::Collect(uint64_t& measurements) const
+{
+	PerfCounterValues combined = PerfCounterValues();
+	measurements               = 0;
+
+	for (unsigned int i = 0; i < kMaxTimingThreads; i++)
+	{
+		combined     += mSlots[i].mTotal;
+		measurements += mSlots[i].mMeasurements;
+	}
+
+	return combined;
+}
+
+// -------------------------------------------------------------- //
+
+void PerfStageCounters::Clear()
+{
+	for (unsigned int i = 0; i < kMaxTimingThreads; i++)
+	{
+		mSlots[i].mTotal        = PerfCounterValues();
+		mSlots[i].mMeasurements = 0;
+	}
+}
+
+// -------------------------------------------------------------- //
+
+void PerfStageCounters::Output() const
+{
+	uint64_t          measurements = 0;
+	PerfCounterValues totals       = Collect(measurements);
+
+	uint64_t cycles       = totals.mValues[(unsigned int)PerfCounter::Cycles];
+	uint64_t instructions = totals.mValues[(unsigned int)PerfCounter::Instructions];
+
+	if (measurements == 0 || cycles == 0 || instructions == 0)
+	{
+		std::cout << "N/A" << std::endl;
+		return;
+	}
+
+	double perThousandInstructions = 1000.0 / (double)instructions;
+
+	std::cout << "IPC "     << (double)instructions / (double)cycles
+	          << " L1D "    << totals.mValues[(unsigned int)PerfCounter::L1DMisses]    * perThousandInstructions
+	          << " LLC "    << totals.mValues[(unsigned int)PerfCounter::LLCMisses]    * perThousandInstructions
+	          << " branch " << totals.mValues[(unsigned int)PerfCounter::BranchMisses] * perThousandInstructions
+	          << " dTLB "   << totals.mValues[(unsigned int)PerfCounter::DTLBMisses]   * perThousandInstructions
+	          << " (misses per 1000 instructions, " << cycles / measurements << " cycles per sample, " << measurements << " samples)" << std::endl;
+}
+
+// -------------------------------------------------------------- //
\ No newline at end of file
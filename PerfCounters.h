@@ -0,0 +1,107 @@
+#pragma once
+
+#include "TimeTracker.h"
+
+#include <stdint.h>
+
+// -------------------------------------------------------------- //
+
+// The hardware events counted around each stage - what the time went on, rather than just how much there was
+enum class PerfCounter : unsigned int
+{
+	Cycles,
+	Instructions,
+	L1DMisses,       // L1 data cache read misses
+	LLCMisses,       // Last level cache misses - these are the trips out to memory
+	BranchMisses,
+	DTLBMisses,      // Data TLB read misses
+
+	Count
+};
+
+constexpr unsigned int kPerfCounterCount = (unsigned int)PerfCounter::Count;
+
+struct PerfCounterValues
+{
+	uint64_t mValues[kPerfCounterCount];
+
+	PerfCounterValues& operator+=(const PerfCounterValues& other)
+	{
+		for (unsigned int i = 0; i < kPerfCounterCount; i++)
+			mValues[i] += other.mValues[i];
+
+		return *this;
+	}
+
+	PerfCounterValues operator-(const PerfCounterValues& other) const
+	{
+		PerfCounterValues difference;
+
+		for (unsigned int i = 0; i < kPerfCounterCount; i++)
+			difference.mValues[i] = mValues[i] - other.mValues[i];
+
+		return difference;
+	}
+};
+
+// -------------------------------------------------------------- //
+
+// Each thread gets one group of counters through perf_event_open, counting only in user space, which is read in one go so
+// that the counts all cover the same stretch of code. Counters the CPU or kernel will not give are left at zero. Reading
+// is a system call, so this is for looking into a stage rather than for leaving on. Windows has no user mode equivalent
+// (it needs a kernel driver or an ETW session), so on Windows nothing opens and everything reads as zero
+namespace PerfCounters
+{
+	// Opens the calling thread's group the first time - false if nothing could be opened
+	bool        OpenForThisThread();
+
+	// The calling thread's counts since its group was opened - zeros if it has none
+	void        ReadThisThread(PerfCounterValues& values);
+
+	// Every thread's counts added together - only consistent while the other threads are not doing anything, e.g. between frames
+	void        ReadAllThreads(PerfCounterValues& values);
+
+	// The index the calling thread's group is kept at, handed out the first time it asks - kMaxTimingThreads or more once they run out
+	unsigned int GetThreadIndex();
+
+	const char* GetCounterName(PerfCounter counter);
+}
+
+// -------------------------------------------------------------- //
+
+// Counter totals for one stage, which any number of threads can measure into at once. Named like the time trackers so
+// that ScopedTiming can drive it - each thread only writes to its own slot, which are added together when read
+class PerfStageCounters
+{
+public:
+	PerfStageCounters();
+
+	void              StartTiming();
+	void              AddMeasurement();
+
+	// For counts that were read some other way, e.g. every thread's counts over a frame
+	void              AddValues(const PerfCounterValues& values);
+
+	// The slots added together - only exact while nothing is being measured
+	PerfCounterValues Collect(uint64_t& measurements) const;
+
+	void              Clear();
+
+	// Instructions per cycle, and misses per thousand instructions
+	void              Output() const;
+
+private:
+	struct alignas(64) Slot
+	{
+		PerfCounterValues mStart;
+		PerfCounterValues mTotal;
+		uint64_t          mMeasurements;
+	};
+
+	// nullptr if the thread has no counters, or there are no slots left
+	Slot* GetThreadSlot();
+
+	Slot mSlots[kMaxTimingThreads];
+};
+
+// -------------------------------------------------------------- //
\ No newline at end of file
@@ -0,0 +1,205 @@
+#include "Profiler.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <new>
+
+namespace Profiling
+{
+	namespace Profiler
+	{
+		// -------------------------------------------------------------------------
+
+		// Only the owning thread writes to a buffer - the write index is published after the event, so the dump never reads
+		// a half written one. Allocated with malloc the first time a thread records, so that it does not show up in the
+		// allocation stats of the frames being captured
+		struct ThreadBuffer
+		{
+			ZoneEvent              mEvents[kProfilerEventsPerThread];
+			std::atomic<uint64_t>  mWriteIndex;
+			char                   mName[32];
+		};
+
+		std::atomic<bool>          sCapturing(false);
+
+		static ThreadBuffer*       sThreadBuffers[kMaxProfiledThreads] = { nullptr };
+		static std::atomic<unsigned int> sThreadBufferCount(0);
+
+		thread_local ThreadBuffer* tThreadBuffer = nullptr;
+		thread_local bool          tOutOfBuffers = false;
+
+		static const char*         sTracePath        = nullptr;
+		static unsigned int        sFirstFrame       = 0;
+		static unsigned int        sFrameCount       = 0;
+		static unsigned int        sCurrentFrame     = 0;
+		static uint64_t            sCaptureStart     = 0;
+
+		// -------------------------------------------------------------------------
+
+		static ThreadBuffer* GetThreadBuffer()
+		{
+			if (tThreadBuffer || tOutOfBuffers)
+				return tThreadBuffer;
+
+			unsigned int index = sThreadBufferCount.load(std::memory_order_relaxed);
+
+			if (index >= kMaxProfiledThreads)
+			{
+				tOutOfBuffers = true;
+				return nullptr;
+			}
+
+			ThreadBuffer* buffer = (ThreadBuffer*)malloc(sizeof(ThreadBuffer));
+
+			if (!buffer)
+			{
+				tOutOfBuffers = true;
+				return nullptr;
+			}
+
+			new (&buffer->mWriteIndex) std::atomic<uint64_t>(0);
+			snprintf(buffer->mName, sizeof(buffer->mName), "Thread %u", index);
+
+			// Claim a slot - if another thread got there first, try the next one
+			while (index < kMaxProfiledThreads)
+			{
+				if (sThreadBufferCount.compare_exchange_weak(index, index + 1, std::memory_order_acq_rel))
+				{
+					sThreadBuffers[index] = buffer;
+					tThreadBuffer         = buffer;
+
+					return buffer;
+				}
+			}
+
+			free(buffer);
+			tOutOfBuffers = true;
+
+			return nullptr;
+		}
+
+		// -------------------------------------------------------------------------
+
+		void Setup(const char* path, unsigned int firstFrame, unsigned int frameCount)
+		{
+			sTracePath    = path;
+			sFirstFrame   = firstFrame;
+			sFrameCount   = frameCount;
+			sCurrentFrame = 0;
+		}
+
+		// -------------------------------------------------------------------------
+
+		void SetThreadName(const char* name)
+		{
+			ThreadBuffer* buffer = GetThreadBuffer();
+
+			if (!buffer)
+				return;
+
+			strncpy(buffer->mName, name, sizeof(buffer->mName) - 1);
+			buffer->mName[sizeof(buffer->mName) - 1] = '\0';
+		}
+
+		// -------------------------------------------------------------------------
+
+		void RecordZone(const char* name, uint64_t startCycles, uint64_t endCycles)
+		{
+			if (!IsCapturing())
+				return;
+
+			ThreadBuffer* buffer = GetThreadBuffer();
+
+			if (!buffer)
+				return;
+
+			uint64_t   writeIndex = buffer->mWriteIndex.load(std::memory_order_relaxed);
+			ZoneEvent& event      = buffer->mEvents[writeIndex & (kProfilerEventsPerThread - 1)];
+
+			event.mName        = name;
+			event.mStartCycles = startCycles;
+			event.mEndCycles   = endCycles;
+
+			buffer->mWriteIndex.store(writeIndex + 1, std::memory_order_release);
+		}
+
+		// -------------------------------------------------------------------------
+
+		static void WriteTrace()
+		{
+			FILE* file = fopen(sTracePath, "w");
+
+			if (!file)
+			{
+				printf("Could not open %s for the profiler trace\n", sTracePath);
+				return;
+			}
+
+			fprintf(file, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+
+			bool         firstEvent  = true;
+			unsigned int bufferCount = sThreadBufferCount.load(std::memory_order_acquire);
+			uint64_t     eventCount  = 0;
+
+			for (unsigned int thread = 0; thread < bufferCount; thread++)
+			{
+				ThreadBuffer* buffer = sThreadBuffers[thread];
+
+				if (!buffer)
+					continue;
+
+				fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%u,\"args\":{\"name\":\"%s\"}}", firstEvent ? "" : ",\n", thread, buffer->mName);
+				firstEvent = false;
+
+				// Only the newest events are still in the ring if it wrapped
+				uint64_t writeIndex = buffer->mWriteIndex.load(std::memory_order_acquire);
+				uint64_t readIndex  = writeIndex > kProfilerEventsPerThread ? writeIndex - kProfilerEventsPerThread : 0;
+
+				for (; readIndex < writeIndex; readIndex++)
+				{
+					const ZoneEvent& event = buffer->mEvents[readIndex & (kProfilerEventsPerThread - 1)];
+
+					// Timestamps are in microseconds from the start of the capture, with nanoseconds after the point
+					double startMicroseconds    = (double)CycleClock::ToNanoseconds(event.mStartCycles - sCaptureStart) / 1000.0;
+					double durationMicroseconds = (double)CycleClock::ToNanoseconds(event.mEndCycles   - event.mStartCycles) / 1000.0;
+
+					fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":0,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}", event.mName, thread, startMicroseconds, durationMicroseconds);
+					eventCount++;
+				}
+
+				buffer->mWriteIndex.store(0, std::memory_order_relaxed);
+			}
+
+			fprintf(file, "\n]}\n");
+			fclose(file);
+
+			printf("Profiler trace of %u frames (%llu zones) written to %s\n", sFrameCount, (unsigned long long)eventCount, sTracePath);
+		}
+
+		// -------------------------------------------------------------------------
+
+		void NextFrame()
+		{
+			if (!sTracePath || sFrameCount == 0)
+				return;
+
+			if (sCurrentFrame == sFirstFrame)
+			{
+				sCaptureStart = CycleClock::Start();
+				sCapturing.store(true, std::memory_order_relaxed);
+			}
+			else if (sCurrentFrame == sFirstFrame + sFrameCount)
+			{
+				sCapturing.store(false, std::memory_order_relaxed);
+
+				WriteTrace();
+			}
+
+			sCurrentFrame++;
+		}
+
+		// -------------------------------------------------------------------------
+	}
+}
\ No newline at end of file
@@ -0,0 +1,87 @@
+#pragma once
+
+#include "Commons.h"
+#include "TimeTracker.h"
+
+#include <stdint.h>
+
+#include <atomic>
+
+namespace Profiling
+{
+	// ----------------------------------------------------------
+
+	constexpr unsigned int kMaxProfiledThreads     = 16;
+	constexpr unsigned int kProfilerEventsPerThread = 64 * 1024; // Must be a power of two - older events are overwritten past this
+
+	// ----------------------------------------------------------
+
+	// One timed scope on one thread. The name must outlive the dump, so it is always a string literal
+	struct ZoneEvent
+	{
+		const char* mName;
+		uint64_t    mStartCycles;
+		uint64_t    mEndCycles;
+	};
+
+	// ----------------------------------------------------------
+
+	// Records zones into one ring buffer per thread, only while a capture is running, and writes the capture out in the
+	// Chrome trace event format - open it in Perfetto (ui.perfetto.dev) or chrome://tracing to see every thread on one timeline
+	namespace Profiler
+	{
+		// Set for the frames being captured - the only thing a zone checks outside of them
+		extern std::atomic<bool> sCapturing;
+
+		inline bool IsCapturing() { return sCapturing.load(std::memory_order_relaxed); }
+
+		// Captures from frame firstFrame for frameCount frames, then writes the trace to path
+		void Setup(const char* path, unsigned int firstFrame, unsigned int frameCount);
+
+		// Called once a frame, at the start, by the thread that drives the frames. Starts and stops the capture, and writes
+		// the file at the end of it - nothing may be recording zones at that point, so it has to be between frames
+		void NextFrame();
+
+		// Shown as the thread's name on the timeline
+		void SetThreadName(const char* name);
+
+		// For zones that are only worth keeping once it is known how they turned out - e.g. only when a job was found
+		void RecordZone(const char* name, uint64_t startCycles, uint64_t endCycles);
+	}
+
+	// ----------------------------------------------------------
+
+	class ScopedZone
+	{
+	public:
+		explicit ScopedZone(const char* name)
+			: mName(name)
+			, mStartCycles(Profiler::IsCapturing() ? CycleClock::Start() : 0)
+		{ }
+
+		~ScopedZone()
+		{
+			if (mStartCycles != 0)
+				Profiler::RecordZone(mName, mStartCycles, CycleClock::Stop());
+		}
+
+		ScopedZone(const ScopedZone&)            = delete;
+		ScopedZone& operator=(const ScopedZone&) = delete;
+
+	private:
+		const char* mName;
+		uint64_t    mStartCycles;
+	};
+
+	// ----------------------------------------------------------
+}
+
+// Times the rest of the scope as a zone on this thread's timeline - compiled out entirely when UseProfilerZones is off
+#define PROFILE_ZONE_JOIN_INNER(a, b) a##b
+#define PROFILE_ZONE_JOIN(a, b)       PROFILE_ZONE_JOIN_INNER(a, b)
+
+#if UseProfilerZones
+	#define PROFILE_ZONE(name) Profiling::ScopedZone PROFILE_ZONE_JOIN(profileZone, __LINE__)(name)
+#else
+	#define PROFILE_ZONE(name)
+#endif
\ No newline at end of file
@@ -3,18 +3,36 @@
 #include "ParentQuadrant.h"
 #include "LeafQuadrant.h"
 #include "BaseQuadrant.h"
+#include "Numa.h"
+#include "Profiler.h"
 
 #include <iostream>
+#include <random>
+
+#if MemoryOverride && CountFrameAllocations
+	#include "AllocationCounter.h"
+#endif
+
+// ----------------------------------------------
+
+// The world state's pool is sized for the state plus this, which covers the block header with room to spare for a snapshot
+// from a build with a few more boxes
+constexpr size_t kWorldStateSpareBytes       = 64 * 1024;
+constexpr size_t kWorldStateBookkeepingBytes = 4 * 1024;
 
 // ----------------------------------------------
 // ----------------------------------------------
 // ----------------------------------------------
 
-Quadtree::Quadtree(unsigned int depth, Vec3 minBounds, Vec3 maxBounds)
-	: mCubes()
+Quadtree::Quadtree(unsigned int depth, Vec3 minBounds, Vec3 maxBounds, unsigned int threadCount, unsigned int cubeCapacity)
+	: mStatePool()
+	, mWorldState(nullptr)
 	, mBaseQuadrant(nullptr)
 	, mTreeDepth(depth)
 
+	, mParentQuadrantPool()
+	, mLeafQuadrantPool()
+
 #if SyncThreads == true
 	, mThreadsHitCollisionsBlock(0)
 	, mThreadsPassedCollisionBlock(0)
@@ -28,32 +46,81 @@ Quadtree::Quadtree(unsigned int depth, Vec3 minBounds, Vec3 maxBounds)
 	, mLeafJobs()
 	, mThreads()
 
-	, mUpdateTimeTracker()
+	, mJobBlockerMutex("JobBlocker")
 	, mDeltaTimeStore(0.0f)
-	, mJobBlockerMutex()
+
+	, mUpdateTimeTracker()
+	, mLeafStageTimeTrackers()
+	, mLeafStagePerfCounters()
+	, mFramePerfCounters()
+	, mLastFramePerfCounters()
 
 	, mThreadsWaiting(0)
+
+	, mLocalJobsProcessed(0)
+	, mRemoteJobsProcessed(0)
+
+	, mNextLeafToCompact(0)
+
+	, mLeafMetricsWriter()
+	, mFrameNumber(0)
 {
-	mCubes.reserve(NUMBER_OF_BOXES);
+	// The nodes, the job lists and the workers are all charged to the tree - the cubes are charged to the physics state below
+	Memory::ScopedMemoryTag memoryTag(Memory::MemoryTag::Quadtree);
+
+	// The boxes get a pool to themselves, so that saving the world is one write and loading it is one map
+	size_t worldStateBytes = sizeof(WorldState) + ((size_t)cubeCapacity * sizeof(Box));
+
+	// Huge pages like the main pool, as every leaf reads the boxes every frame. A loaded world cannot keep them - LoadState maps
+	// the saved blocks straight over the arena from the file (MAP_FIXED), and a private file mapping only ever gets normal pages
+	mStatePool.Init(worldStateBytes + kWorldStateSpareBytes, kWorldStateBookkeepingBytes, true, UseHugePages);
+
+	mWorldState                = (WorldState*)mStatePool.AssignMemory(worldStateBytes, false);
+	mWorldState->mCubeCount    = 0;
+	mWorldState->mCubeCapacity = cubeCapacity;
+
+#if UseMemoryTags
+	Memory::MemoryTags::AddTaggedBytes(Memory::MemoryTag::PhysicsState, worldStateBytes);
+#endif
 
 	// Set the max depth
 	ParentQuadrant::sMaxDepth = depth;
 
-	LeafQuadrantCount = (int)std::pow(4, QuadtreeDepth);
-
 	// ------------------------------------
 
+	// Size the pools up front so that every node comes out of one chunk per type
+	unsigned int leafCount   = (unsigned int)std::pow(4, depth);
+	unsigned int parentCount = (leafCount - 1) / 3;
+
+	mLeafQuadrantPool.Reserve(leafCount);
+
+	if (parentCount > 0)
+		mParentQuadrantPool.Reserve(parentCount);
+
 	// If the depth is 0 then we are not breaking the space up at all
 	if (depth == 0)
 	{
-		mBaseQuadrant = new LeafQuadrant(minBounds, maxBounds, *this);
+		mBaseQuadrant = mLeafQuadrantPool.Acquire(minBounds, maxBounds, *this);
 	}
 	else
 	{
-		mBaseQuadrant = new ParentQuadrant(0, minBounds, maxBounds, *this);
+		ParentQuadrant* root = mParentQuadrantPool.Acquire(0, minBounds, maxBounds, *this);
+
+		// Build the tree breadth first - each parent's children are created before going down a level,
+		// so nodes that are traversed together end up next to each other in the pools
+		std::vector<ParentQuadrant*> buildQueue;
+		buildQueue.reserve(parentCount);
+		buildQueue.push_back(root);
+
+		for (unsigned int i = 0; i < buildQueue.size(); i++)
+		{
+			buildQueue[i]->CreateChildren(mParentQuadrantPool, mLeafQuadrantPool, buildQueue);
+		}
+
+		mBaseQuadrant = root;
 
 		// Now the tree has been created, we need to determine which leaves are neighbours to each other
-		((ParentQuadrant*)mBaseQuadrant)->CalculateNeighbours();
+		root->CalculateNeighbours();
 	}
 
 	// ------------------------------------	
@@ -68,9 +135,32 @@ Quadtree::Quadtree(unsigned int depth, Vec3 minBounds, Vec3 maxBounds)
 
 	// ------------------------------------	
 
-	for (unsigned int i = 0; i < ThreadsToAllocateToProgram; i++)
+#if UseNumaPlacement
+	// Split the leaves into one contiguous block per node, in job order, and put each leaf's data on its node
+	unsigned int nodeCount = Numa::GetNodeCount();
+	unsigned int jobCount  = (unsigned int)mLeafJobs.size();
+
+	for (unsigned int i = 0; i < jobCount; i++)
 	{
-		mThreads.push_back(new std::thread(&Quadtree::ThreadJobGetter, this));
+		mLeafJobs[i]->SetHomeNode((i * nodeCount) / jobCount);
+	}
+#endif
+
+	// ------------------------------------	
+
+#if LogLeafMetrics
+	if (!mLeafMetricsWriter.Open(LeafMetricsPath, (unsigned int)mLeafJobs.size()))
+		std::cout << "Could not open " << LeafMetricsPath << " for the leaf metrics" << std::endl;
+#endif
+
+	// ------------------------------------	
+
+	// Each worker only ever has one job on the go, so this never has to grow once the frames are running
+	mJobsBeingProcessed.reserve(threadCount);
+
+	for (unsigned int i = 0; i < threadCount; i++)
+	{
+		mThreads.push_back(new std::thread(&Quadtree::ThreadJobGetter, this, i));
 	}
 }
 
@@ -81,7 +171,7 @@ Quadtree::~Quadtree()
 	// Set the program is over so all threads end
 	mProgramRunning = false;
 
-	for (unsigned int i = 0; i < ThreadsToAllocateToProgram; i++)
+	for (unsigned int i = 0; i < mThreads.size(); i++)
 	{
 		if (mThreads[i])
 		{
@@ -92,26 +182,39 @@ Quadtree::~Quadtree()
 		}
 	}
 
-	// Now clean up the quadrants
-	if (mBaseQuadrant)
-	{
-		delete mBaseQuadrant;
-		mBaseQuadrant = nullptr;
-	}
+	// Now clean up the quadrants - parents first, as they clear their leaves' neighbour links on the way out
+	mParentQuadrantPool.ReleaseAll();
+	mLeafQuadrantPool.ReleaseAll();
+
+	mBaseQuadrant = nullptr;
+
+	mLeafMetricsWriter.Close();
+
+#if UseMemoryTags
+	if (mWorldState)
+		Memory::MemoryTags::RemoveTaggedBytes(Memory::MemoryTag::PhysicsState, sizeof(WorldState) + (mWorldState->mCubeCapacity * sizeof(Box)));
+#endif
+
+	mWorldState = nullptr;
 }
 
 // ----------------------------------------------
 
 void Quadtree::AddCubeToTree(Box cube)
 {
+	// The state is sized for every box up front, so it never moves
+	if (mWorldState->mCubeCount >= mWorldState->mCubeCapacity)
+		return;
+
 	// Add the cube to the list
-	mCubes.emplace_back(cube);
+	mWorldState->GetCubes()[mWorldState->mCubeCount] = cube;
+	mWorldState->mCubeCount++;
 
 	if (!mBaseQuadrant)
 		return;
 
 	// Now add the cube to the quadrants
-	mBaseQuadrant->AddCube(mCubes.size() - 1);
+	mBaseQuadrant->AddCube(mWorldState->mCubeCount - 1);
 }
 
 // ----------------------------------------------
@@ -121,34 +224,211 @@ void Quadtree::Update(const float deltaTime)
 	if (!mBaseQuadrant)
 		return;
 
+	Memory::ScopedMemoryTag memoryTag(Memory::MemoryTag::Quadtree);
+
+#if MemoryOverride && CountFrameAllocations
+	Memory::AllocationCounter::BeginFrame(mFrameNumber);
+#endif
+
 	mUpdateTimeTracker.StartTiming();
 
 		mThreadsWaiting = 0;
 
-		mJobCopy        = mLeafJobs;
-		mDeltaTimeStore = deltaTime;
+		mJobBlockerMutex.lock();
+			mJobCopy.assign(mLeafJobs.begin(), mLeafJobs.end());
+			mDeltaTimeStore = deltaTime;
+		mJobBlockerMutex.unlock();
+
+		{
+			PROFILE_ZONE("WaitForJobs");
+
+			std::unique_lock block(mJobDoneWaitMutex);
 
-		std::unique_lock block(mJobDoneWaitMutex);
-		mWaitForJobsDone.wait(block);
+			// Check the jobs are actually finished, as the frame arenas are about to be reset from under them
+			mWaitForJobsDone.wait(block, [this]()
+			{
+				std::lock_guard<Profiling::ProfiledMutex> jobLock(mJobBlockerMutex);
+
+				return mJobCopy.empty() && mJobsBeingProcessed.empty();
+			});
+		}
+
+#if LogLeafMetrics
+		RecordLeafMetrics();
+#endif
+
+#if UsePerfCounters
+		// The workers are all idle, so this is a clean cut between frames. The first frame is left out, as the workers
+		// open their counters part way through it
+		PerfCounterValues frameEndCounters;
+		PerfCounters::ReadAllThreads(frameEndCounters);
+
+		if (mFrameNumber > 0)
+			mFramePerfCounters.AddValues(frameEndCounters - mLastFramePerfCounters);
+
+		mLastFramePerfCounters = frameEndCounters;
+#endif
+
+		mFrameNumber++;
+
+#if CompactPoolsBetweenFrames && UseMovableLeafLists
+		{
+			PROFILE_ZONE("CompactPools");
+
+			// Nothing is touching the leaves' lists now, so they can be moved
+			CompactPools();
+		}
+#endif
+
+		// Drop the job copy's storage before the arenas are reset so that it does not point into memory that is about to be reused
+		std::vector<LeafQuadrant*, Memory::FrameArenaAllocator<LeafQuadrant*>>().swap(mJobCopy);
+
+		// Everything allocated for this frame is now finished with
+		Memory::FrameArena::ResetAll();
 
 	mUpdateTimeTracker.AddMeasurement();
+
+#if MemoryOverride && CountFrameAllocations
+	Memory::AllocationCounter::EndFrame();
+#endif
+}
+
+// ----------------------------------------------
+
+void Quadtree::CompactPools()
+{
+	size_t       bytesLeft = CompactionBytesPerFrame;
+	unsigned int leafCount = (unsigned int)mLeafJobs.size();
+
+	// Carry on round the leaves from wherever the last frame ran out of budget
+	for (unsigned int i = 0; i < leafCount && bytesLeft > 0; i++)
+	{
+		size_t bytesMoved = mLeafJobs[mNextLeafToCompact]->Compact(bytesLeft, CompactionBlocksPerFrame);
+
+		bytesLeft         -= bytesMoved < bytesLeft ? bytesMoved : bytesLeft;
+		mNextLeafToCompact = (mNextLeafToCompact + 1) % leafCount;
+	}
+
+	// Lists that outgrew their region are in the node pools, which everything else shares, so these are locked while they move
+	unsigned int nodeCount = Numa::GetNodeCount();
+	bool         anyMoved  = false;
+
+	for (unsigned int node = 0; node < nodeCount && bytesLeft > 0; node++)
+	{
+		Memory::MemoryPool* pool = Memory::MemoryPool::GetForNode(node);
+
+		// Until the node pools exist every node hands back the main pool
+		if (node > 0 && pool == Memory::MemoryPool::GetForNode(0))
+			break;
+
+		Profiling::ProfiledMutex* mutex = pool->GetMutex();
+
+		if (mutex)
+			mutex->lock();
+
+		size_t bytesMoved = pool->Compact(bytesLeft, CompactionBlocksPerFrame);
+
+		if (mutex)
+			mutex->unlock();
+
+		bytesLeft -= bytesMoved < bytesLeft ? bytesMoved : bytesLeft;
+		anyMoved  |= bytesMoved > 0;
+	}
+
+	// Which lists were moved is not known, so they all look themselves up again
+	if (anyMoved)
+	{
+		for (unsigned int i = 0; i < leafCount; i++)
+			mLeafJobs[i]->RefreshLists();
+	}
 }
 
 // ----------------------------------------------
 
-void Quadtree::ThreadJobGetter()
+void Quadtree::RecordLeafMetrics()
 {
-	LeafQuadrant* job = nullptr;
+	// Still taken when the writer is behind, so that the next frame it gets only has that frame's counts in it
+	LeafFrameMetrics* frame     = mLeafMetricsWriter.BeginFrame();
+	unsigned int      leafCount = (unsigned int)mLeafJobs.size();
+
+	for (unsigned int i = 0; i < leafCount; i++)
+	{
+		LeafFrameMetrics metrics = mLeafJobs[i]->TakeFrameMetrics();
+
+		if (frame)
+			frame[i] = metrics;
+	}
+
+	if (frame)
+		mLeafMetricsWriter.SubmitFrame(mFrameNumber);
+}
+
+// ----------------------------------------------
+
+void Quadtree::ThreadJobGetter(unsigned int threadIndex)
+{
+	LeafQuadrant* job      = nullptr;
+	unsigned int  homeNode = 0;
+
+	// Anything the leaves allocate outside of their own lists is still the tree's
+	Memory::ScopedMemoryTag memoryTag(Memory::MemoryTag::Quadtree);
+
+#if UseNumaPlacement
+	// Spread the workers evenly over the nodes, and keep each one on its node so that its leaves' data stays local
+	homeNode = threadIndex % Numa::GetNodeCount();
+
+	Numa::PinThisThreadToNode(homeNode);
+#endif
+
+	ThreadedTimeTracker* getJobTracker      = GetLeafStageTracker(LeafStage::GetJob);
+	PerfStageCounters*   getJobPerfCounters = GetLeafStagePerfCounters(LeafStage::GetJob);
+
+#if UsePerfCounters
+	// Opened up front, so that the system calls are not counted in this worker's first job
+	PerfCounters::OpenForThisThread();
+#endif
+
+#if UseProfilerZones
+	char threadName[32];
+	snprintf(threadName, sizeof(threadName), "Worker %u", threadIndex);
+
+	Profiling::Profiler::SetThreadName(threadName);
+#endif
 
 	while (mProgramRunning)
 	{		
+		// Only counts the time taken when a job was found, so that the spinning between frames does not swamp it
+		uint64_t getJobStart = Profiling::Profiler::IsCapturing() ? CycleClock::Start() : 0;
+
+		if (getJobTracker)
+			getJobTracker->StartTiming();
+
+		if (getJobPerfCounters)
+			getJobPerfCounters->StartTiming();
+
 		mJobBlockerMutex.lock();
 
 			if (mJobCopy.size() > 0)
 			{
+				unsigned int jobIndex = 0;
+
+#if UseNumaPlacement
+				// Prefer a leaf whose data is on this worker's node - only take a remote one if there are none left
+				unsigned int jobCount = (unsigned int)mJobCopy.size();
+
+				for (unsigned int i = 0; i < jobCount; i++)
+				{
+					if (mJobCopy[i]->GetHomeNode() == homeNode)
+					{
+						jobIndex = i;
+						break;
+					}
+				}
+#endif
+
 				// Grab a job to do
-				job = mJobCopy[0];
-				mJobCopy.erase(mJobCopy.begin());
+				job = mJobCopy[jobIndex];
+				mJobCopy.erase(mJobCopy.begin() + jobIndex);
 
 				mJobsBeingProcessed.push_back(job);
 			}
@@ -157,6 +437,20 @@ void Quadtree::ThreadJobGetter()
 
 		if (job)
 		{
+			if (getJobTracker)
+				getJobTracker->AddMeasurement();
+
+			if (getJobPerfCounters)
+				getJobPerfCounters->AddMeasurement();
+
+			if (getJobStart != 0)
+				Profiling::Profiler::RecordZone("GetJob", getJobStart, CycleClock::Stop());
+
+			if (job->GetHomeNode() == homeNode)
+				mLocalJobsProcessed++;
+			else
+				mRemoteJobsProcessed++;
+
 			job->ThreadUpdate(mDeltaTimeStore);
 
 			mJobBlockerMutex.lock();
@@ -190,11 +484,12 @@ void Quadtree::ThreadJobGetter()
 
 void Quadtree::Render()
 {
-	unsigned int cubeCount = (unsigned int)mCubes.size();
+	unsigned int cubeCount = mWorldState->mCubeCount;
+	Box*         cubes     = mWorldState->GetCubes();
 
 	for (unsigned int i = 0; i < cubeCount; i++)
 	{
-		mCubes[i].Render();
+		cubes[i].Render();
 	}
 }
 
@@ -202,16 +497,65 @@ void Quadtree::Render()
 
 void Quadtree::ImpulseAllBoxes(float amount)
 {
-	unsigned int cubeCount = (unsigned int)mCubes.size();
+	unsigned int cubeCount = mWorldState->mCubeCount;
+	Box*         cubes     = mWorldState->GetCubes();
 
 	for (unsigned int i = 0; i < cubeCount; i++)
 	{
-		mCubes[i].velocity.y += amount;
+		cubes[i].velocity.y += amount;
 	}
 }
 
 // ----------------------------------------------
 
+void Quadtree::AddRandomCubes(unsigned int count, unsigned int seed)
+{
+	Memory::ScopedMemoryTag memoryTag(Memory::MemoryTag::PhysicsState);
+
+	std::mt19937                          random(seed);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+	for (unsigned int i = 0; i < count; i++)
+	{
+		Box box;
+
+		box.position = Vec3(minX + unit(random) * (maxX - minX), 10.0f + unit(random), minZ + unit(random) * (maxZ - minZ));
+		box.halfSize = Vec3(CubeSize / 2.0f, CubeSize / 2.0f, CubeSize / 2.0f);
+		box.velocity = Vec3(-1.0f + unit(random) * 2.0f, 0.0f, 0.0f);
+		box.colour   = Vec3(1.0f, 1.0f, 1.0f);
+
+		AddCubeToTree(box);
+	}
+}
+
+// ----------------------------------------------
+
+uint64_t Quadtree::GetStateChecksum()
+{
+	// FNV-1a over the raw bits, so that even a last place difference shows up
+	uint64_t     hash      = 14695981039346656037ull;
+	unsigned int cubeCount = mWorldState->mCubeCount;
+	Box*         cubes     = mWorldState->GetCubes();
+
+	for (unsigned int i = 0; i < cubeCount; i++)
+	{
+		const unsigned char* bytes[2] = { (const unsigned char*)&cubes[i].position, (const unsigned char*)&cubes[i].velocity };
+
+		for (unsigned int j = 0; j < 2; j++)
+		{
+			for (unsigned int k = 0; k < sizeof(Vec3); k++)
+			{
+				hash ^= bytes[j][k];
+				hash *= 1099511628211ull;
+			}
+		}
+	}
+
+	return hash;
+}
+
+// ----------------------------------------------
+
 void Quadtree::CheckCollisions()
 {
 	if (!mBaseQuadrant)
@@ -254,6 +598,10 @@ bool Quadtree::QueueAddCubeToTree(unsigned int cubeIndex)
 
 LeafQuadrant* Quadtree::FindQuadrantContainingPosition(Vec3& position)
 {
+	// The only leaf is the whole area, so anything outside of it has nowhere else to go
+	if (mTreeDepth == 0)
+		return nullptr;
+
 	LeafQuadrant* quadrant = ((ParentQuadrant*)mBaseQuadrant)->FindQuadrantForPosition(position);
 
 	return quadrant;
@@ -263,12 +611,156 @@ LeafQuadrant* Quadtree::FindQuadrantContainingPosition(Vec3& position)
 
 Box* Quadtree::GetCube(unsigned int index)
 {
-	if (mCubes.size() > index)
+	if (mWorldState->mCubeCount > index)
 	{
-		return &mCubes[index];
+		return &mWorldState->GetCubes()[index];
 	}
 
 	return nullptr;
 }
 
-// ----------------------------------------------
\ No newline at end of file
+// ----------------------------------------------
+
+void Quadtree::OutputNumaPlacement()
+{
+	unsigned int local  = mLocalJobsProcessed.load();
+	unsigned int remote = mRemoteJobsProcessed.load();
+	unsigned int total  = local + remote;
+
+	std::cout << "NUMA nodes: " << Numa::GetNodeCount() << std::endl;
+
+	if (total == 0)
+	{
+		std::cout << "Leaf jobs local/remote: N/A" << std::endl;
+		return;
+	}
+
+	std::cout << "Leaf jobs processed on their home node: " << local  << " (" << (100.0 * local  / total) << "%)" << std::endl;
+	std::cout << "Leaf jobs processed on a remote node: "   << remote << " (" << (100.0 * remote / total) << "%)" << std::endl;
+}
+
+// ----------------------------------------------
+
+// ----------------------------------------------
+
+bool Quadtree::SaveState(const char* path)
+{
+	Memory::ScopedMemoryTag memoryTag(Memory::MemoryTag::IO);
+
+	return mStatePool.SaveSnapshot(path, mWorldState);
+}
+
+// ----------------------------------------------
+
+bool Quadtree::LoadState(const char* path)
+{
+	Memory::ScopedMemoryTag memoryTag(Memory::MemoryTag::IO);
+
+#if UseMemoryTags
+	size_t oldStateBytes = sizeof(WorldState) + (mWorldState->mCubeCapacity * sizeof(Box));
+#endif
+
+	// The boxes come straight back from the file - only which leaf each one is in has to be worked out again
+	WorldState* restoredState = (WorldState*)mStatePool.RestoreSnapshot(path);
+
+	if (!restoredState)
+		return false;
+
+	mWorldState = restoredState;
+
+#if UseMemoryTags
+	Memory::MemoryTags::RemoveTaggedBytes(Memory::MemoryTag::PhysicsState, oldStateBytes);
+	Memory::MemoryTags::AddTaggedBytes(Memory::MemoryTag::PhysicsState, sizeof(WorldState) + (mWorldState->mCubeCapacity * sizeof(Box)));
+#endif
+
+	unsigned int leafCount = (unsigned int)mLeafJobs.size();
+
+	for (unsigned int i = 0; i < leafCount; i++)
+		mLeafJobs[i]->Reset();
+
+	if (!mBaseQuadrant)
+		return true;
+
+	// The leaves' lists are charged to the tree as they are rebuilt, as they would have been when the boxes were first added
+	Memory::ScopedMemoryTag listTag(Memory::MemoryTag::Quadtree);
+
+	unsigned int cubeCount = mWorldState->mCubeCount;
+
+	for (unsigned int i = 0; i < cubeCount; i++)
+		mBaseQuadrant->AddCube(i);
+
+	return true;
+}
+
+// ----------------------------------------------
+
+ThreadedTimeTracker* Quadtree::GetLeafStageTracker(LeafStage stage)
+{
+#if FINE_TUNED_MEASUREMENTS
+	return &mLeafStageTimeTrackers[(unsigned int)stage];
+#else
+	(void)stage;
+	return nullptr;
+#endif
+}
+
+// ----------------------------------------------
+
+void Quadtree::OutputLeafStageTimings()
+{
+	static const char* stageNames[(unsigned int)LeafStage::Count] =
+	{
+		"Add pending:   ",
+		"Physics:       ",
+		"Transitions:   ",
+		"Remove marked: ",
+		"Collisions:    ",
+		"Get job:       "
+	};
+
+	std::cout << "Leaf stage timings, per leaf:" << std::endl;
+
+	for (unsigned int i = 0; i < (unsigned int)LeafStage::Count; i++)
+	{
+		std::cout << stageNames[i];
+		mLeafStageTimeTrackers[i].Collect().OutputPercentiles();
+	}
+}
+
+// ----------------------------------------------
+
+PerfStageCounters* Quadtree::GetLeafStagePerfCounters(LeafStage stage)
+{
+#if UsePerfCounters
+	return &mLeafStagePerfCounters[(unsigned int)stage];
+#else
+	(void)stage;
+	return nullptr;
+#endif
+}
+
+// ----------------------------------------------
+
+void Quadtree::OutputPerfCounters()
+{
+	static const char* stageNames[(unsigned int)LeafStage::Count] =
+	{
+		"Add pending:   ",
+		"Physics:       ",
+		"Transitions:   ",
+		"Remove marked: ",
+		"Collisions:    ",
+		"Get job:       "
+	};
+
+	std::cout << "Hardware counters, per stage:" << std::endl;
+
+	for (unsigned int i = 0; i < (unsigned int)LeafStage::Count; i++)
+	{
+		std::cout << stageNames[i];
+		mLeafStagePerfCounters[i].Output();
+	}
+
+	std::cout << "Whole frame:   ";
+	mFramePerfCounters.Output();
+}
\ No newline at end of file
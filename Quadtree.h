@@ -4,6 +4,12 @@
 #include "Vector3D.h"
 #include "Commons.h"
 #include "TimeTracker.h"
+#include "PerfCounters.h"
+#include "LinearArena.h"
+#include "ObjectPool.h"
+#include "MemoryTags.h"
+#include "LeafMetrics.h"
+#include "LockProfiler.h"
 
 #include <vector>
 #include <mutex>
@@ -15,13 +21,42 @@
 
 class Quadrant;
 class LeafQuadrant;
+class ParentQuadrant;
+
+// -------------------------------------
+
+// The boxes as they sit in the tree's state pool, with the boxes straight after it. Nothing in here is a pointer,
+// so the pool can be written out and mapped back in at a different address
+struct WorldState
+{
+	unsigned int mCubeCount;
+	unsigned int mCubeCapacity;
+
+	Box*         GetCubes() { return (Box*)(this + 1); }
+};
+
+// -------------------------------------
+
+// The parts of a leaf's update that are timed separately, along with the workers' time spent getting jobs
+enum class LeafStage
+{
+	AddPending,
+	Physics,
+	Transitions,
+	RemoveMarked,
+	Collisions,
+	GetJob,
+
+	Count
+};
 
 // -------------------------------------
 
 class Quadtree
 {
 public:
-	Quadtree(unsigned int depth, Vec3 minBounds, Vec3 maxBounds);
+	// threadCount workers are started, and there is room for cubeCapacity boxes - the defaults are what the simulation runs with
+	Quadtree(unsigned int depth, Vec3 minBounds, Vec3 maxBounds, unsigned int threadCount = ThreadsToAllocateToProgram, unsigned int cubeCapacity = NUMBER_OF_BOXES);
 	~Quadtree();
 
 	void AddCubeToTree(Box cube);
@@ -30,9 +65,15 @@ public:
 	void ImpulseAllBoxes(float amount);
 	void CheckCollisions();
 
+	// Adds boxes spread over the area the way initScene does, but from their own seed, so headless runs always get the same scene
+	void AddRandomCubes(unsigned int count, unsigned int seed);
+
+	// A hash of every box's position and velocity - any change at all in how the simulation played out changes it
+	uint64_t GetStateChecksum();
+
 	bool QueueAddCubeToTree(unsigned int cubeIndex);
 
-	void               ThreadJobGetter();
+	void               ThreadJobGetter(unsigned int threadIndex);
 
 	bool               GetProgramRunning() const { return mProgramRunning; }
 
@@ -40,31 +81,78 @@ public:
 
 	LeafQuadrant*      FindQuadrantContainingPosition(Vec3& position);
 
+	// A ParentQuadrant unless the depth is 0, when it is the only leaf
+	Quadrant*          GetRootQuadrant() { return mBaseQuadrant; }
+
 	TimeTracker& GetTimeTracker() { return mUpdateTimeTracker; }
 
+	// Shared by every worker - nullptr when FINE_TUNED_MEASUREMENTS is off, which ScopedTiming treats as not timing
+	ThreadedTimeTracker* GetLeafStageTracker(LeafStage stage);
+
+	// Mean and tail for each stage, over every leaf and worker
+	void         OutputLeafStageTimings();
+
+	// nullptr when UsePerfCounters is off - fed alongside the stage timers
+	PerfStageCounters* GetLeafStagePerfCounters(LeafStage stage);
+
+	// IPC and miss rates for each stage, and for whole frames over every worker
+	void         OutputPerfCounters();
+
+	// How many jobs were picked up by a worker on the same NUMA node as the leaf's data
+	void         OutputNumaPlacement();
+
+	// Writes the boxes out as a snapshot of the state pool, and maps them back in - LoadState replaces whatever boxes
+	// the tree had and rebuilds the leaves' lists from them. Must not be called while an Update is running
+	bool         SaveState(const char* path);
+	bool         LoadState(const char* path);
+
 private:
-	std::vector<Box>          mCubes;
+	// Runs a slice of the compactor over the leaves' regions and the pools their lists fall back onto - workers must be idle
+	void CompactPools();
+
+	// Copies every leaf's counters for the frame just finished over to the metrics writer - workers must be idle
+	void RecordLeafMetrics();
+
+	Memory::MemoryPool        mStatePool;  // Holds nothing but the world state, so that it can be snapshotted on its own
+	WorldState*               mWorldState;
 
 	Quadrant*                 mBaseQuadrant;
 	unsigned int              mTreeDepth;
 
+	// All of the nodes live in these, constructed breadth first so that each level of the tree is contiguous
+	Memory::ObjectPool<ParentQuadrant> mParentQuadrantPool;
+	Memory::ObjectPool<LeafQuadrant>   mLeafQuadrantPool;
+
 	bool                       mProgramRunning;
 
 	std::vector<LeafQuadrant*> mLeafJobs;
-	std::vector<LeafQuadrant*> mJobCopy;
+	std::vector<LeafQuadrant*, Memory::FrameArenaAllocator<LeafQuadrant*>> mJobCopy; // Rebuilt every frame, so lives in the frame arena
 	std::vector<LeafQuadrant*> mJobsBeingProcessed;
 
 	std::vector<std::thread*>  mThreads;
 
-	std::mutex                 mJobBlockerMutex;
+	Profiling::ProfiledMutex   mJobBlockerMutex;
 	float                      mDeltaTimeStore;
 
 	std::condition_variable    mWaitForJobsDone;
 	std::mutex                 mJobDoneWaitMutex;
 
 	TimeTracker                mUpdateTimeTracker;
+	ThreadedTimeTracker        mLeafStageTimeTrackers[(unsigned int)LeafStage::Count];
+
+	PerfStageCounters          mLeafStagePerfCounters[(unsigned int)LeafStage::Count];
+	PerfStageCounters          mFramePerfCounters;     // Every worker's counts from the end of one frame to the end of the next
+	PerfCounterValues          mLastFramePerfCounters;
 
 	std::atomic<int>           mThreadsWaiting;
+
+	std::atomic<unsigned int>  mLocalJobsProcessed;
+	std::atomic<unsigned int>  mRemoteJobsProcessed;
+
+	unsigned int               mNextLeafToCompact;
+
+	LeafMetricsWriter          mLeafMetricsWriter;
+	unsigned int               mFrameNumber;
 };
 
 // -------------------------------------
\ No newline at end of file
@@ -0,0 +1,107 @@
+#include "RegionAllocator.h"
+
+namespace Memory
+{
+	// -------------------------------------------------------------------------
+
+	void* AllocateFromRegion(MemoryPool* region, size_t size, size_t alignment, MemoryTag tag)
+	{
+		void*                     memoryPointer = nullptr;
+		Profiling::ProfiledMutex* mutex         = region->GetMutex();
+
+		if (mutex)
+			mutex->lock();
+
+		if (alignment > kArchitectureAlignment)
+			memoryPointer = region->AssignAlignedMemory(size, alignment);
+		else
+			memoryPointer = region->AssignMemory(size, false);
+
+		if (mutex)
+			mutex->unlock();
+
+		if (memoryPointer)
+		{
+#if UseMemoryTags
+			MemoryTags::AddTaggedBytes(tag, size);
+#endif
+
+			return memoryPointer;
+		}
+
+		// The region is full, so fall back onto the global allocator - FreeToRegion can tell the difference by the address
+		ScopedMemoryTag scope(tag);
+
+		if (alignment > kArchitectureAlignment)
+			return ::operator new(size, (std::align_val_t)alignment);
+
+		return ::operator new(size);
+	}
+
+	// -------------------------------------------------------------------------
+
+	void FreeToRegion(MemoryPool* region, void* memoryPointer, size_t size, size_t alignment, MemoryTag tag)
+	{
+		if (!memoryPointer)
+			return;
+
+		if (!region->Owns(memoryPointer))
+		{
+			if (alignment > kArchitectureAlignment)
+				::operator delete(memoryPointer, size, (std::align_val_t)alignment);
+			else
+				::operator delete(memoryPointer, size);
+
+			return;
+		}
+
+#if UseMemoryTags
+		MemoryTags::RemoveTaggedBytes(tag, size);
+#else
+		(void)tag;
+#endif
+
+		Profiling::ProfiledMutex* mutex = region->GetMutex();
+
+		if (mutex)
+			mutex->lock();
+
+		if (alignment > kArchitectureAlignment)
+			region->FreeAlignedMemory(memoryPointer);
+		else
+			region->FreeMemory(size, memoryPointer, false);
+
+		if (mutex)
+			mutex->unlock();
+	}
+
+	// -------------------------------------------------------------------------
+
+	bool ExpandInRegion(MemoryPool* region, void* memoryPointer, size_t oldSize, size_t newSize, size_t alignment, MemoryTag tag)
+	{
+		// Aligned blocks have their prefix in front, and fallback memory belongs to the main pool's override, so only plain region blocks can grow
+		if (!memoryPointer || alignment > kArchitectureAlignment || !region->Owns(memoryPointer))
+			return false;
+
+		Profiling::ProfiledMutex* mutex = region->GetMutex();
+
+		if (mutex)
+			mutex->lock();
+
+		bool expanded = region->TryExpandInPlace(memoryPointer, oldSize, newSize);
+
+		if (mutex)
+			mutex->unlock();
+
+#if UseMemoryTags
+		if (expanded)
+			MemoryTags::AddTaggedBytes(tag, newSize - oldSize, false);
+#else
+		(void)tag;
+#endif
+
+		return expanded;
+	}
+
+	// -------------------------------------------------------------------------
+}
\ No newline at end of file
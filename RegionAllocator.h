@@ -0,0 +1,82 @@
+#pragma once
+
+#include "MemoryPool.h"
+#include "LinearArena.h"
+#include "MemoryTags.h"
+
+#include <type_traits>
+
+namespace Memory
+{
+	// ----------------------------------------------------------
+
+	// Pools - if the region has filled up then the memory comes from the main pool instead, so containers never fail to grow
+	// Memory from the region does not pass through the new override, so it is charged to the tag here instead
+	void* AllocateFromRegion(MemoryPool* region, size_t size, size_t alignment, MemoryTag tag);
+	void  FreeToRegion(MemoryPool* region, void* memoryPointer, size_t size, size_t alignment, MemoryTag tag);
+
+	// Grows an allocation from AllocateFromRegion without moving it - false if it has to be copied instead
+	bool  ExpandInRegion(MemoryPool* region, void* memoryPointer, size_t oldSize, size_t newSize, size_t alignment, MemoryTag tag);
+
+	// Arenas - freeing does nothing, the memory comes back when the arena is reset, so there is nothing to charge per allocation
+	inline void* AllocateFromRegion(LinearArena* region, size_t size, size_t alignment, MemoryTag) { return region->Allocate(size, alignment); }
+	inline void  FreeToRegion(LinearArena*, void*, size_t, size_t, MemoryTag)                      { }
+	inline bool  ExpandInRegion(LinearArena*, void*, size_t, size_t, size_t, MemoryTag)            { return false; }
+
+	// ----------------------------------------------------------
+
+	// Binds a container to one specific pool or arena, rather than going through the global new override
+	// Used so that everything a leaf owns can sit together in memory and be released together
+	template<typename T, typename Region, MemoryTag Tag = MemoryTag::Untagged>
+	class RegionAllocator
+	{
+	public:
+		using value_type                             = T;
+		using is_always_equal                        = std::false_type;
+		using propagate_on_container_copy_assignment = std::false_type;
+		using propagate_on_container_move_assignment = std::true_type;
+		using propagate_on_container_swap            = std::true_type;
+
+		template<typename U>
+		struct rebind { using other = RegionAllocator<U, Region, Tag>; };
+
+		// Not explicit, so that a list can be made straight from the region it lives in
+		RegionAllocator(Region* region) noexcept
+			: mRegion(region)
+		{ }
+
+		template<typename U>
+		RegionAllocator(const RegionAllocator<U, Region, Tag>& other) noexcept
+			: mRegion(other.GetRegion())
+		{ }
+
+		T* allocate(size_t count)
+		{
+			return (T*)AllocateFromRegion(mRegion, count * sizeof(T), alignof(T), Tag);
+		}
+
+		void deallocate(T* memoryPointer, size_t count) noexcept
+		{
+			FreeToRegion(mRegion, memoryPointer, count * sizeof(T), alignof(T), Tag);
+		}
+
+		// Not part of the STL allocator interface - used by GrowableArray to avoid the copy when the block can just get bigger
+		bool try_expand(T* memoryPointer, size_t oldCount, size_t newCount) noexcept
+		{
+			return ExpandInRegion(mRegion, memoryPointer, oldCount * sizeof(T), newCount * sizeof(T), alignof(T), Tag);
+		}
+
+		Region* GetRegion() const noexcept { return mRegion; }
+
+		template<typename U>
+		bool operator==(const RegionAllocator<U, Region, Tag>& other) const noexcept { return mRegion == other.GetRegion(); }
+
+		template<typename U>
+		bool operator!=(const RegionAllocator<U, Region, Tag>& other) const noexcept { return mRegion != other.GetRegion(); }
+
+	private:
+		Region* mRegion;
+	};
+
+	// ----------------------------------------------------------
+}
\ No newline at end of file
@@ -0,0 +1,352 @@
+#include "RegressionCheck.h"
+
+#include "Commons.h"
+#include "Quadtree.h"
+#include "TimeTracker.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+
+namespace Benchmarks
+{
+	// -------------------------------------------------------------------------
+
+	struct RegressionScenario
+	{
+		const char*  mName;
+		unsigned int mBoxCount;
+		unsigned int mDepth;
+		unsigned int mFrames;
+	};
+
+	// Fixed so that a baseline stays comparable - changing one of these means writing a new baseline
+	static const RegressionScenario kRegressionScenarios[] =
+	{
+		{ "sparse",  5000,            QuadtreeDepth, 200 },
+		{ "shallow", 10000,           2,             100 },
+		{ "default", NUMBER_OF_BOXES, QuadtreeDepth, 200 }
+	};
+
+	constexpr unsigned int kRegressionSeed            = 20240601;
+	constexpr float        kRegressionDeltaTime       = 1.0f / 60.0f;
+	constexpr unsigned int kRegressionWarmupFrames    = 10;
+
+	// A scene is only called slower if the frame times are unlikely to have come from the same distribution as the baseline's,
+	// and the median has moved by enough to matter - with a few hundred frames even a tiny change can be significant
+	constexpr double       kRegressionSignificance    = 0.01;
+	constexpr double       kRegressionMinimumSlowdown = 0.03;
+
+	constexpr unsigned int kRegressionBaselineVersion = 1;
+
+	// -------------------------------------------------------------------------
+
+	struct ScenarioResult
+	{
+		std::string           mName;
+		unsigned int          mBoxCount;
+		unsigned int          mDepth;
+		unsigned int          mFrames;
+		uint64_t              mChecksum;
+		std::vector<uint64_t> mFrameNanoseconds;
+	};
+
+	// -------------------------------------------------------------------------
+
+	static ScenarioResult RunScenario(const RegressionScenario& scenario)
+	{
+		ScenarioResult result;
+
+		result.mName     = scenario.mName;
+		result.mBoxCount = scenario.mBoxCount;
+		result.mDepth    = scenario.mDepth;
+		result.mFrames   = scenario.mFrames;
+
+		// The checksum comes from a run with a single worker - with more, leaves next to each other resolve their shared
+		// collisions in whichever order the workers get to them, so the result can change from run to run
+		{
+			Quadtree* tree = new Quadtree(scenario.mDepth, { minX, 0.0f, minZ }, { maxX, 1.0f, maxZ }, 1, scenario.mBoxCount);
+
+			tree->AddRandomCubes(scenario.mBoxCount, kRegressionSeed);
+
+			for (unsigned int frame = 0; frame < scenario.mFrames; frame++)
+				tree->Update(kRegressionDeltaTime);
+
+			result.mChecksum = tree->GetStateChecksum();
+
+			delete tree;
+		}
+
+		// The timings come from the worker count the simulation runs with
+		{
+			Quadtree* tree = new Quadtree(scenario.mDepth, { minX, 0.0f, minZ }, { maxX, 1.0f, maxZ }, ThreadsToAllocateToProgram, scenario.mBoxCount);
+
+			tree->AddRandomCubes(scenario.mBoxCount, kRegressionSeed);
+
+			for (unsigned int frame = 0; frame < kRegressionWarmupFrames; frame++)
+				tree->Update(kRegressionDeltaTime);
+
+			result.mFrameNanoseconds.reserve(scenario.mFrames);
+
+			for (unsigned int frame = 0; frame < scenario.mFrames; frame++)
+			{
+				uint64_t startCycles = CycleClock::Start();
+
+				tree->Update(kRegressionDeltaTime);
+
+				result.mFrameNanoseconds.push_back(CycleClock::ToNanoseconds(CycleClock::Stop() - startCycles));
+			}
+
+			delete tree;
+		}
+
+		return result;
+	}
+
+	// -------------------------------------------------------------------------
+
+	// One sided - how likely frame times at least this much slower than the baseline's would be if nothing had changed.
+	// Uses the normal approximation, with the variance corrected for ties, which is close enough at these sample counts
+	static double MannWhitneySlowerPValue(const std::vector<uint64_t>& baseline, const std::vector<uint64_t>& current)
+	{
+		std::vector<std::pair<uint64_t, bool>> combined; // Second is true for the current run's samples
+
+		combined.reserve(baseline.size() + current.size());
+
+		for (uint64_t value : baseline)
+			combined.push_back({ value, false });
+
+		for (uint64_t value : current)
+			combined.push_back({ value, true });
+
+		std::sort(combined.begin(), combined.end());
+
+		double totalCount     = (double)combined.size();
+		double baselineCount  = (double)baseline.size();
+		double currentCount   = (double)current.size();
+		double currentRankSum = 0.0;
+		double tieCorrection  = 0.0;
+
+		for (size_t i = 0; i < combined.size();)
+		{
+			size_t tieEnd = i;
+
+			while (tieEnd < combined.size() && combined[tieEnd].first == combined[i].first)
+				tieEnd++;
+
+			// Ranks count from 1, and tied samples all share the middle rank of their run
+			double rank = (double)(i + 1 + tieEnd) / 2.0;
+
+			for (size_t j = i; j < tieEnd; j++)
+			{
+				if (combined[j].second)
+					currentRankSum += rank;
+			}
+
+			double tieCount = (double)(tieEnd - i);
+			tieCorrection  += (tieCount * tieCount * tieCount) - tieCount;
+
+			i = tieEnd;
+		}
+
+		double u        = currentRankSum - (currentCount * (currentCount + 1.0)) / 2.0;
+		double mean     = (baselineCount * currentCount) / 2.0;
+		double variance = ((baselineCount * currentCount) / 12.0) * ((totalCount + 1.0) - tieCorrection / (totalCount * (totalCount - 1.0)));
+
+		if (variance <= 0.0)
+			return 1.0;
+
+		double z = (u - mean - 0.5) / sqrt(variance);
+
+		return 0.5 * erfc(z / sqrt(2.0));
+	}
+
+	// -------------------------------------------------------------------------
+
+	static double GetPercentileMilliseconds(std::vector<uint64_t> samples, double percentile)
+	{
+		if (samples.empty())
+			return 0.0;
+
+		std::sort(samples.begin(), samples.end());
+
+		size_t index = (size_t)((percentile / 100.0) * (double)(samples.size() - 1) + 0.5);
+
+		return (double)samples[index] / 1000000.0;
+	}
+
+	// -------------------------------------------------------------------------
+
+	static bool WriteBaseline(const char* path, const std::vector<ScenarioResult>& results)
+	{
+		FILE* file = fopen(path, "w");
+
+		if (!file)
+			return false;
+
+		fprintf(file, "PhysicsRegressionBaseline %u\n", kRegressionBaselineVersion);
+
+		// The percentiles are only there for reading - the comparison uses every frame
+		for (const ScenarioResult& result : results)
+		{
+			fprintf(file, "scenario %s %u %u %u %016llx %zu\n", result.mName.c_str(), result.mBoxCount, result.mDepth, result.mFrames,
+				(unsigned long long)result.mChecksum, result.mFrameNanoseconds.size());
+
+			fprintf(file, "percentiles_ms %.4f %.4f %.4f\n",
+				GetPercentileMilliseconds(result.mFrameNanoseconds, 50.0), GetPercentileMilliseconds(result.mFrameNanoseconds, 90.0),
+				GetPercentileMilliseconds(result.mFrameNanoseconds, 99.0));
+
+			for (size_t i = 0; i < result.mFrameNanoseconds.size(); i++)
+				fprintf(file, "%llu%c", (unsigned long long)result.mFrameNanoseconds[i], i + 1 < result.mFrameNanoseconds.size() ? ' ' : '\n');
+		}
+
+		fclose(file);
+
+		return true;
+	}
+
+	// -------------------------------------------------------------------------
+
+	static bool ReadBaseline(const char* path, std::vector<ScenarioResult>& results)
+	{
+		FILE* file = fopen(path, "r");
+
+		if (!file)
+			return false;
+
+		unsigned int version = 0;
+
+		if (fscanf(file, "PhysicsRegressionBaseline %u", &version) != 1 || version != kRegressionBaselineVersion)
+		{
+			fclose(file);
+			return false;
+		}
+
+		char               name[64];
+		unsigned long long checksum;
+		size_t             sampleCount;
+		ScenarioResult     result;
+
+		while (fscanf(file, " scenario %63s %u %u %u %llx %zu", name, &result.mBoxCount, &result.mDepth, &result.mFrames, &checksum, &sampleCount) == 6)
+		{
+			double ignored[3];
+
+			if (fscanf(file, " percentiles_ms %lf %lf %lf", &ignored[0], &ignored[1], &ignored[2]) != 3)
+				break;
+
+			result.mName     = name;
+			result.mChecksum = (uint64_t)checksum;
+			result.mFrameNanoseconds.resize(sampleCount);
+
+			bool readAll = true;
+
+			for (size_t i = 0; i < sampleCount && readAll; i++)
+			{
+				unsigned long long sample;
+
+				readAll                     = fscanf(file, "%llu", &sample) == 1;
+				result.mFrameNanoseconds[i] = (uint64_t)sample;
+			}
+
+			if (!readAll)
+				break;
+
+			results.push_back(result);
+		}
+
+		fclose(file);
+
+		return !results.empty();
+	}
+
+	// -------------------------------------------------------------------------
+
+	int CheckForRegressions(const char* baselinePath, bool writeBaseline)
+	{
+		std::vector<ScenarioResult> baseline;
+
+		bool compare = !writeBaseline && ReadBaseline(baselinePath, baseline);
+
+		if (!writeBaseline && !compare)
+			std::cout << "No usable baseline at " << baselinePath << " - this run will become the baseline" << std::endl;
+
+		std::vector<ScenarioResult> results;
+
+		for (const RegressionScenario& scenario : kRegressionScenarios)
+		{
+			std::cout << "Running " << scenario.mName << " - " << scenario.mBoxCount << " boxes, depth " << scenario.mDepth << ", " << scenario.mFrames << " frames" << std::endl;
+
+			results.push_back(RunScenario(scenario));
+		}
+
+		if (!compare)
+		{
+			if (!WriteBaseline(baselinePath, results))
+			{
+				std::cout << "Could not write the baseline to " << baselinePath << std::endl;
+				return 1;
+			}
+
+			std::cout << "Baseline written to " << baselinePath << std::endl;
+			return 0;
+		}
+
+		bool failed = false;
+
+		std::cout << std::left << std::setw(10) << "Scene" << std::right
+		          << std::setw(14) << "Base p50 ms" << std::setw(14) << "Now p50 ms" << std::setw(14) << "Base p99 ms" << std::setw(14) << "Now p99 ms"
+		          << std::setw(10) << "Change" << std::setw(12) << "p-value" << "  Result" << std::endl;
+
+		for (const ScenarioResult& result : results)
+		{
+			const ScenarioResult* baselineResult = nullptr;
+
+			for (const ScenarioResult& candidate : baseline)
+			{
+				if (candidate.mName == result.mName)
+					baselineResult = &candidate;
+			}
+
+			if (!baselineResult || baselineResult->mBoxCount != result.mBoxCount || baselineResult->mDepth != result.mDepth || baselineResult->mFrames != result.mFrames)
+			{
+				std::cout << std::left << std::setw(10) << result.mName << std::right << "  not in the baseline, or set up differently - write a new baseline" << std::endl;
+				failed = true;
+				continue;
+			}
+
+			double baselineMedian = GetPercentileMilliseconds(baselineResult->mFrameNanoseconds, 50.0);
+			double currentMedian  = GetPercentileMilliseconds(result.mFrameNanoseconds,          50.0);
+			double change         = baselineMedian > 0.0 ? (currentMedian - baselineMedian) / baselineMedian : 0.0;
+			double pValue         = MannWhitneySlowerPValue(baselineResult->mFrameNanoseconds, result.mFrameNanoseconds);
+
+			bool   diverged       = result.mChecksum != baselineResult->mChecksum;
+			bool   slower         = pValue < kRegressionSignificance && change > kRegressionMinimumSlowdown;
+
+			std::cout << std::left << std::setw(10) << result.mName << std::right << std::fixed << std::setprecision(3)
+			          << std::setw(14) << baselineMedian << std::setw(14) << currentMedian
+			          << std::setw(14) << GetPercentileMilliseconds(baselineResult->mFrameNanoseconds, 99.0) << std::setw(14) << GetPercentileMilliseconds(result.mFrameNanoseconds, 99.0)
+			          << std::setprecision(1) << std::setw(9) << change * 100.0 << "%" << std::setprecision(4) << std::setw(12) << pValue << "  ";
+
+			if (diverged)
+				std::cout << "DIVERGED (state checksum " << std::hex << result.mChecksum << ", baseline " << baselineResult->mChecksum << ")" << std::dec;
+			else if (slower)
+				std::cout << "SLOWER";
+			else
+				std::cout << "ok";
+
+			std::cout << std::endl;
+
+			failed |= diverged || slower;
+		}
+
+		return failed ? 1 : 0;
+	}
+
+	// -------------------------------------------------------------------------
+}
\ No newline at end of file
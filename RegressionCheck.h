@@ -0,0 +1,8 @@
+#pragma once
+
+namespace Benchmarks
+{
+	// Runs the regression scenes and checks them against the baseline at baselinePath, or writes a new baseline there if asked
+	// to or if there is not one yet. Returns 0 if everything matches and nothing is significantly slower, 1 otherwise
+	int CheckForRegressions(const char* baselinePath, bool writeBaseline);
+}
\ No newline at end of file
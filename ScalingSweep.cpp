@@ -0,0 +1,216 @@
+#include "ScalingSweep.h"
+
+#include "Commons.h"
+#include "Cube.h"
+#include "Quadtree.h"
+#include "LeafQuadrant.h"
+#include "MemoryPool.h"
+#include "TimeTracker.h"
+
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include <stdio.h>
+
+namespace Benchmarks
+{
+	// -------------------------------------------------------------------------
+
+	constexpr unsigned int kScalingSweepBoxCounts[]       = { ScalingSweepBoxCounts };
+
+	// Not timed - the first frame moves every box into its leaf, and the lists take a few frames to reach their size
+	constexpr unsigned int kScalingSweepWarmupFrames      = 10;
+	constexpr float        kScalingSweepDeltaTime         = 0.016f;
+	constexpr unsigned int kScalingSweepSeed              = 4242;
+
+	// Each leaf carries its transfer arrays and region whatever is in it, and the regions come out of the node pools
+	constexpr size_t       kScalingSweepLeafBytesBudget   = (Memory::kBytesAllocatedPerNodePool / 4) * 3;
+
+	// Every box is tested against every other box in its leaf, so a shallow tree over a lot of boxes would take hours
+	constexpr double       kScalingSweepMaxPairTests      = 2e8;
+
+	// -------------------------------------------------------------------------
+
+	struct ScalingResult
+	{
+		unsigned int mBoxCount;
+		unsigned int mDepth;
+		unsigned int mThreadCount;
+		double       mMeanMilliseconds;
+		double       mP50Milliseconds;
+		double       mP99Milliseconds;
+		double       mMaxMilliseconds;
+		double       mSpeedup;         // Mean frame time with one worker over the mean with this many
+		double       mEfficiency;      // Speedup per worker - 1 is perfect scaling
+	};
+
+	// -------------------------------------------------------------------------
+
+	// Powers of two up to the core count, and the core count itself
+	static std::vector<unsigned int> GetThreadCounts()
+	{
+		unsigned int coreCount = std::thread::hardware_concurrency();
+
+		if (coreCount == 0)
+			coreCount = ThreadsToAllocateToProgram;
+
+		std::vector<unsigned int> threadCounts;
+
+		for (unsigned int threadCount = 1; threadCount < coreCount; threadCount *= 2)
+			threadCounts.push_back(threadCount);
+
+		threadCounts.push_back(coreCount);
+
+		return threadCounts;
+	}
+
+	// -------------------------------------------------------------------------
+
+	// nullptr if the combination can be run - the leaves' sizes are fixed at compile time, so not every one fits in this build
+	static const char* GetSkipReason(unsigned int boxCount, unsigned int depth)
+	{
+		double leafCount    = std::pow(4.0, (double)depth);
+		double boxesPerLeaf = (double)boxCount / leafCount;
+		double leafBytes    = (double)(sizeof(LeafQuadrant) + Memory::kBytesAllocatedPerLeafRegion + Memory::kBytesAllocatedForLeafFreeArray);
+
+		if (leafCount * leafBytes > (double)kScalingSweepLeafBytesBudget)
+			return "the leaves would not fit in the node pools";
+
+		// Room for the boxes not being spread perfectly evenly, as anything over the limit is dropped on the way in
+		if (boxesPerLeaf > (double)(MaxCubeTransferRate / 2))
+			return "more boxes per leaf than MaxCubeTransferRate allows";
+
+		if ((double)boxCount * boxesPerLeaf > kScalingSweepMaxPairTests)
+			return "too many pair tests per frame";
+
+		return nullptr;
+	}
+
+	// -------------------------------------------------------------------------
+
+	static ScalingResult MeasureConfiguration(unsigned int boxCount, unsigned int depth, unsigned int threadCount)
+	{
+		// Every run starts its own workers, which hundreds of runs only get away with because deleting the tree joins them,
+		// and each exiting worker hands its frame arena on to the next run's
+		Quadtree* tree = new Quadtree(depth, { minX, 0.0f, minZ }, { maxX, 1.0f, maxZ }, threadCount, boxCount);
+
+		// The same scene for every depth and worker count
+		tree->AddRandomCubes(boxCount, kScalingSweepSeed);
+
+		for (unsigned int frame = 0; frame < kScalingSweepWarmupFrames; frame++)
+			tree->Update(kScalingSweepDeltaTime);
+
+		LatencyHistogram frameTimes;
+		double           totalNanoseconds = 0.0;
+
+		for (unsigned int frame = 0; frame < ScalingSweepFrames; frame++)
+		{
+			uint64_t startCycles = CycleClock::Start();
+
+			tree->Update(kScalingSweepDeltaTime);
+
+			uint64_t nanoseconds = CycleClock::ToNanoseconds(CycleClock::Stop() - startCycles);
+
+			frameTimes.Record(nanoseconds);
+			totalNanoseconds += (double)nanoseconds;
+		}
+
+		delete tree;
+
+		double milliseconds = 1.0 / 1000000.0;
+
+		ScalingResult result;
+
+		result.mBoxCount         = boxCount;
+		result.mDepth            = depth;
+		result.mThreadCount      = threadCount;
+		result.mMeanMilliseconds = (totalNanoseconds / ScalingSweepFrames) * milliseconds;
+		result.mP50Milliseconds  = frameTimes.GetPercentile(50.0) * milliseconds;
+		result.mP99Milliseconds  = frameTimes.GetPercentile(99.0) * milliseconds;
+		result.mMaxMilliseconds  = frameTimes.GetMax()            * milliseconds;
+
+		// Filled in once it can be compared against the single worker run
+		result.mSpeedup          = 0.0;
+		result.mEfficiency       = 0.0;
+
+		return result;
+	}
+
+	// -------------------------------------------------------------------------
+
+	static void OutputResult(const ScalingResult& result)
+	{
+		std::cout << std::setw(9) << result.mBoxCount << std::setw(7) << result.mDepth << std::setw(9) << result.mThreadCount
+		          << std::fixed << std::setprecision(3)
+		          << std::setw(11) << result.mMeanMilliseconds << std::setw(11) << result.mP50Milliseconds
+		          << std::setw(11) << result.mP99Milliseconds  << std::setw(11) << result.mMaxMilliseconds
+		          << std::setprecision(2)
+		          << std::setw(10) << result.mSpeedup << std::setw(12) << result.mEfficiency * 100.0 << "%" << std::endl;
+	}
+
+	// -------------------------------------------------------------------------
+
+	void MeasureScaling(const char* csvPath)
+	{
+		FILE* file = fopen(csvPath, "w");
+
+		if (!file)
+			std::cout << "Could not open " << csvPath << " for the scaling results" << std::endl;
+		else
+			fprintf(file, "boxes,depth,threads,mean_ms,p50_ms,p99_ms,max_ms,speedup,efficiency\n");
+
+		std::vector<unsigned int> threadCounts = GetThreadCounts();
+
+		std::cout << "Scaling sweep - " << ScalingSweepFrames << " frames per run, after " << kScalingSweepWarmupFrames << " warm up frames" << std::endl;
+		std::cout << std::setw(9) << "Boxes" << std::setw(7) << "Depth" << std::setw(9) << "Threads"
+		          << std::setw(11) << "Mean ms" << std::setw(11) << "p50 ms" << std::setw(11) << "p99 ms" << std::setw(11) << "Max ms"
+		          << std::setw(10) << "Speedup" << std::setw(13) << "Efficiency" << std::endl;
+
+		for (unsigned int boxCount : kScalingSweepBoxCounts)
+		{
+			for (unsigned int depth = 0; depth <= ScalingSweepMaxDepth; depth++)
+			{
+				if (const char* skipReason = GetSkipReason(boxCount, depth))
+				{
+					std::cout << std::setw(9) << boxCount << std::setw(7) << depth << "  skipped - " << skipReason << std::endl;
+					continue;
+				}
+
+				// One worker is always first, so it is there to measure the others against
+				double singleThreadMilliseconds = 0.0;
+
+				for (unsigned int threadCount : threadCounts)
+				{
+					ScalingResult result = MeasureConfiguration(boxCount, depth, threadCount);
+
+					if (threadCount == 1)
+						singleThreadMilliseconds = result.mMeanMilliseconds;
+
+					result.mSpeedup    = result.mMeanMilliseconds > 0.0 ? singleThreadMilliseconds / result.mMeanMilliseconds : 0.0;
+					result.mEfficiency = result.mSpeedup / threadCount;
+
+					OutputResult(result);
+
+					if (file)
+					{
+						fprintf(file, "%u,%u,%u,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f\n",
+							result.mBoxCount, result.mDepth, result.mThreadCount,
+							result.mMeanMilliseconds, result.mP50Milliseconds, result.mP99Milliseconds, result.mMaxMilliseconds,
+							result.mSpeedup, result.mEfficiency);
+
+						// A long sweep keeps what it has so far if it is stopped
+						fflush(file);
+					}
+				}
+			}
+		}
+
+		if (file)
+			fclose(file);
+	}
+
+	// -------------------------------------------------------------------------
+}
\ No newline at end of file
@@ -0,0 +1,8 @@
+#pragma once
+
+namespace Benchmarks
+{
+	// Times whole frames over every combination of box count, tree depth and worker count in Commons.h, on the same scene
+	// each time - prints frame time percentiles, speedup over one worker and parallel efficiency, and writes them to csvPath
+	void MeasureScaling(const char* csvPath);
+}
\ No newline at end of file
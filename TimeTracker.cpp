@@ -1,16 +1,174 @@
 #include "TimeTracker.h"
 
 #include <iostream>
+#include <atomic>
+#include <thread>
 
-#pragma optimize ("", off)
+// -------------------------------------------------------------- //
+
+double CycleClock::GetNanosecondsPerCycle()
+{
+	// Worked out once, on whichever thread gets here first - statics are initialised thread safely
+	static const double sNanosecondsPerCycle = []()
+	{
+#if defined(_MSC_VER) || defined(__x86_64__) || defined(__i386__)
+		std::chrono::steady_clock::time_point startTime   = std::chrono::steady_clock::now();
+		uint64_t                              startCycles = Start();
+
+		std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+		uint64_t                              endCycles   = Stop();
+		std::chrono::steady_clock::time_point endTime     = std::chrono::steady_clock::now();
+
+		double nanoseconds = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(endTime - startTime).count();
+
+		return endCycles > startCycles ? nanoseconds / (double)(endCycles - startCycles) : 1.0;
+#else
+		// The fallback already counts in nanoseconds
+		return 1.0;
+#endif
+	}();
+
+	return sNanosecondsPerCycle;
+}
+
+// -------------------------------------------------------------- //
+
+LatencyHistogram::LatencyHistogram()
+	: mCounts()
+	, mCount(0)
+	, mMax(0)
+{
+
+}
+
+// -------------------------------------------------------------- //
+
+unsigned int LatencyHistogram::GetBucketIndex(uint64_t value)
+{
+	// Below two whole steps the buckets are one nanosecond wide, so the value is its own index
+	if (value < 2 * kLatencySubBucketCount)
+		return (unsigned int)value;
+
+	unsigned int highestBit = 63;
+
+	while (!(value & ((uint64_t)1 << highestBit)))
+		highestBit--;
+
+	// Shift so that the top kLatencySubBucketBits + 1 bits are left - the top one is always set, the rest pick the step
+	unsigned int shift = highestBit - kLatencySubBucketBits;
+
+	return ((shift + 1) * kLatencySubBucketCount) + (unsigned int)((value >> shift) - kLatencySubBucketCount);
+}
+
+// -------------------------------------------------------------- //
+
+uint64_t LatencyHistogram::GetBucketUpperBound(unsigned int index)
+{
+	if (index < 2 * kLatencySubBucketCount)
+		return index;
+
+	unsigned int shift = (index / kLatencySubBucketCount) - 1;
+	uint64_t     step  = (index % kLatencySubBucketCount) + kLatencySubBucketCount;
+
+	return ((step + 1) << shift) - 1;
+}
+
+// -------------------------------------------------------------- //
+
+void LatencyHistogram::Record(uint64_t nanoseconds)
+{
+	mCounts[GetBucketIndex(nanoseconds)]++;
+	mCount++;
+
+	if (nanoseconds > mMax)
+		mMax = nanoseconds;
+}
+
+// -------------------------------------------------------------- //
+
+void LatencyHistogram::Merge(const LatencyHistogram& other)
+{
+	for (unsigned int i = 0; i < kLatencyBucketCount; i++)
+		mCounts[i] += other.mCounts[i];
+
+	mCount += other.mCount;
+
+	if (other.mMax > mMax)
+		mMax = other.mMax;
+}
+
+// -------------------------------------------------------------- //
+
+void LatencyHistogram::Clear()
+{
+	for (unsigned int i = 0; i < kLatencyBucketCount; i++)
+		mCounts[i] = 0;
+
+	mCount = 0;
+	mMax   = 0;
+}
+
+// -------------------------------------------------------------- //
+
+uint64_t LatencyHistogram::GetPercentile(double percentile) const
+{
+	if (mCount == 0)
+		return 0;
+
+	// The rank of the measurement wanted - at least the first one, so that p0 is the smallest rather than nothing
+	uint64_t target = (uint64_t)((percentile / 100.0) * (double)mCount + 0.5);
+
+	if (target < 1)
+		target = 1;
+
+	uint64_t seen = 0;
+
+	for (unsigned int i = 0; i < kLatencyBucketCount; i++)
+	{
+		seen += mCounts[i];
+
+		if (seen >= target)
+		{
+			uint64_t upperBound = GetBucketUpperBound(i);
+
+			return upperBound < mMax ? upperBound : mMax;
+		}
+	}
+
+	return mMax;
+}
+
+// -------------------------------------------------------------- //
+
+void LatencyHistogram::WriteCSV(FILE* file, const char* name) const
+{
+	if (!file || mCount == 0)
+		return;
+
+	uint64_t seen = 0;
 
+	for (unsigned int i = 0; i < kLatencyBucketCount; i++)
+	{
+		if (mCounts[i] == 0)
+			continue;
+
+		seen += mCounts[i];
+
+		fprintf(file, "%s,%llu,%u,%.4f\n", name, (unsigned long long)GetBucketUpperBound(i), mCounts[i], (100.0 * (double)seen) / (double)mCount);
+	}
+}
+
+// -------------------------------------------------------------- //
+// -------------------------------------------------------------- //
 // -------------------------------------------------------------- //
 
 TimeTracker::TimeTracker()
-	: mStartTime()
-	, mTakingInputs(true)
+	: mStartCycles(0)
 	, mRunningTotal(0.0)
 	, mMeasurementsTaken(0)
+	, mTakingInputs(true)
+	, mHistogram()
 {
 
 }
@@ -26,7 +184,7 @@ TimeTracker::~TimeTracker()
 
 void TimeTracker::StartTiming()
 {
-	mStartTime = std::chrono::high_resolution_clock::now();
+	mStartCycles = CycleClock::Start();
 }
 
 // -------------------------------------------------------------- //
@@ -36,13 +194,12 @@ void TimeTracker::AddMeasurement()
 	if (!mTakingInputs)
 		return;
 
-	std::chrono::time_point<std::chrono::high_resolution_clock> endTime  = std::chrono::high_resolution_clock::now();
-	std::chrono::microseconds                                   duration = std::chrono::duration_cast<std::chrono::microseconds>(endTime - mStartTime);
+	uint64_t nanoseconds = CycleClock::ToNanoseconds(CycleClock::Stop() - mStartCycles);
 
-	double durationDouble = (double)duration.count() / 1000000.0;
-
-	mRunningTotal += durationDouble;
+	mRunningTotal += (double)nanoseconds / 1000000000.0;
 	mMeasurementsTaken++;
+
+	mHistogram.Record(nanoseconds);
 }
 
 // -------------------------------------------------------------- //
@@ -69,10 +226,90 @@ void TimeTracker::OutputAverageTime()
 
 // -------------------------------------------------------------- //
 
-void TimeTracker::CombineTimes(TimeTracker& other)
+void TimeTracker::OutputPercentiles()
+{
+	if (mMeasurementsTaken == 0)
+	{
+		std::cout << "N/A" << std::endl;
+		return;
+	}
+
+	double milliseconds = 1.0 / 1000000.0;
+
+	std::cout << "mean "  << (mRunningTotal / (double)mMeasurementsTaken) * 1000.0
+	          << " p50 "   << mHistogram.GetPercentile(50.0) * milliseconds
+	          << " p90 "   << mHistogram.GetPercentile(90.0) * milliseconds
+	          << " p99 "   << mHistogram.GetPercentile(99.0) * milliseconds
+	          << " p99.9 " << mHistogram.GetPercentile(99.9) * milliseconds
+	          << " max "   << mHistogram.GetMax()            * milliseconds << " (ms, " << mMeasurementsTaken << " samples)" << std::endl;
+}
+
+// -------------------------------------------------------------- //
+
+void TimeTracker::CombineTimes(const TimeTracker& other)
 {
 	mMeasurementsTaken += other.mMeasurementsTaken;
 	mRunningTotal      += other.mRunningTotal;
+
+	mHistogram.Merge(other.mHistogram);
+}
+
+// -------------------------------------------------------------- //
+// -------------------------------------------------------------- //
+
+ThreadedTimeTracker::ThreadedTimeTracker()
+	: mSlots()
+{
+
+}
+
+// -------------------------------------------------------------- //
+
+TimeTracker* ThreadedTimeTracker::GetThreadSlot()
+{
+	static std::atomic<unsigned int> sThreadsSeen(0);
+	thread_local unsigned int        tSlotIndex = sThreadsSeen.fetch_add(1, std::memory_order_relaxed);
+
+	if (tSlotIndex >= kMaxTimingThreads)
+		return nullptr;
+
+	return &mSlots[tSlotIndex].mTracker;
+}
+
+// -------------------------------------------------------------- //
+
+void ThreadedTimeTracker::StartTiming()
+{
+	if (TimeTracker* slot = GetThreadSlot())
+		slot->StartTiming();
+}
+
+// -------------------------------------------------------------- //
+
+void ThreadedTimeTracker::AddMeasurement()
+{
+	if (TimeTracker* slot = GetThreadSlot())
+		slot->AddMeasurement();
+}
+
+// -------------------------------------------------------------- //
+
+TimeTracker ThreadedTimeTracker::Collect() const
+{
+	TimeTracker combined;
+
+	for (unsigned int i = 0; i < kMaxTimingThreads; i++)
+		combined.CombineTimes(mSlots[i].mTracker);
+
+	return combined;
+}
+
+// -------------------------------------------------------------- //
+
+void ThreadedTimeTracker::Clear()
+{
+	for (unsigned int i = 0; i < kMaxTimingThreads; i++)
+		mSlots[i].mTracker.Clear();
 }
 
 // -------------------------------------------------------------- //
\ No newline at end of file
@@ -3,6 +3,87 @@
 #include <chrono>
 #include <vector>
 
+#include <stdio.h>
+#include <stdint.h>
+
+#if defined(_MSC_VER)
+	#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+	#include <x86intrin.h>
+#endif
+
+// -------------------------------------------------------------- //
+
+// The CPU's timestamp counter - a handful of cycles to read, against the tens of nanoseconds a clock call can take.
+// Assumes an invariant TSC (anything from the last decade), so the rate does not change with frequency scaling.
+// Falls back to steady_clock in nanoseconds on CPUs without one
+namespace CycleClock
+{
+	inline uint64_t Start()
+	{
+#if defined(_MSC_VER) || defined(__x86_64__) || defined(__i386__)
+		return __rdtsc();
+#else
+		return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+	}
+
+	// rdtscp waits for everything before it to finish, so the work being timed cannot leak past the end of the measurement
+	inline uint64_t Stop()
+	{
+#if defined(_MSC_VER) || defined(__x86_64__) || defined(__i386__)
+		unsigned int processorID;
+		return __rdtscp(&processorID);
+#else
+		return Start();
+#endif
+	}
+
+	// Measured against steady_clock the first time it is asked for
+	double   GetNanosecondsPerCycle();
+
+	inline uint64_t ToNanoseconds(uint64_t cycles)
+	{
+		return (uint64_t)((double)cycles * GetNanosecondsPerCycle());
+	}
+}
+
+// -------------------------------------------------------------- //
+
+// Log-linear histogram of durations in nanoseconds, in the style of HdrHistogram - each power of two is split into
+// kLatencySubBucketCount equal steps, so any value is held to within about 3%, whatever its size, in a fixed amount of memory
+constexpr unsigned int kLatencySubBucketBits  = 5;
+constexpr unsigned int kLatencySubBucketCount = 1 << kLatencySubBucketBits;
+constexpr unsigned int kLatencyBucketCount    = (64 - kLatencySubBucketBits + 1) * kLatencySubBucketCount;
+
+class LatencyHistogram
+{
+public:
+	LatencyHistogram();
+
+	void     Record(uint64_t nanoseconds);
+	void     Merge(const LatencyHistogram& other);
+	void     Clear();
+
+	// percentile is 0-100. Gives the top of the bucket the value fell in, so it errs on the slow side - never more than the max
+	uint64_t GetPercentile(double percentile) const;
+	uint64_t GetMax()   const { return mMax; }
+	uint64_t GetCount() const { return mCount; }
+
+	// One row per bucket in use - tracker name, top of the bucket, count in the bucket, and the percentile reached by it
+	void     WriteCSV(FILE* file, const char* name) const;
+
+private:
+	static unsigned int GetBucketIndex(uint64_t value);
+	static uint64_t     GetBucketUpperBound(unsigned int index);
+
+	unsigned int mCounts[kLatencyBucketCount];
+	uint64_t     mCount;
+	uint64_t     mMax;
+};
+
+// -------------------------------------------------------------- //
+
 class TimeTracker
 {
 public:
@@ -15,19 +96,87 @@ public:
 
 	void OutputAverageTime();
 
+	// Mean, p50, p90, p99, p99.9 and max, in milliseconds
+	void OutputPercentiles();
+
 	void Clear() 
 	{
 		mRunningTotal      = 0.0;
 		mMeasurementsTaken = 0;
 		mTakingInputs      = true;
+
+		mHistogram.Clear();
 	}
 
-	void CombineTimes(TimeTracker& other);
+	void CombineTimes(const TimeTracker& other);
+
+	const LatencyHistogram& GetHistogram() const { return mHistogram; }
+
+private:
+	uint64_t         mStartCycles;
+	double           mRunningTotal;
+	unsigned int     mMeasurementsTaken;
+
+	bool             mTakingInputs;
+
+	LatencyHistogram mHistogram;
+};
+
+// -------------------------------------------------------------- //
+
+// Most threads that will ever time something at once - each gets its own slot in every ThreadedTimeTracker
+constexpr unsigned int kMaxTimingThreads = 16;
+
+// A TimeTracker that any number of threads can time into at once. Each thread writes only to its own slot, so there is
+// no locking or sharing of cache lines while timing - the slots are merged when the results are read
+class ThreadedTimeTracker
+{
+public:
+	ThreadedTimeTracker();
+
+	void        StartTiming();
+	void        AddMeasurement();
+
+	// The slots merged together - only exact while nothing is being timed, e.g. between frames
+	TimeTracker Collect() const;
+
+	void        Clear();
 
 private:
-	std::chrono::time_point<std::chrono::high_resolution_clock> mStartTime;
-	double                                                      mRunningTotal;
-	unsigned int                                                mMeasurementsTaken;
+	// The slot this thread uses in every tracker, handed out the first time a thread times anything - nullptr once they run out
+	TimeTracker* GetThreadSlot();
 
-	bool                                                        mTakingInputs;
+	struct alignas(64) Slot
+	{
+		TimeTracker mTracker;
+	};
+
+	Slot mSlots[kMaxTimingThreads];
+};
+
+// -------------------------------------------------------------- //
+
+// Times the scope it is in - does nothing if given no tracker, so timing can be switched off without touching the call sites
+template<typename Tracker>
+class ScopedTiming
+{
+public:
+	explicit ScopedTiming(Tracker* tracker)
+		: mTracker(tracker)
+	{
+		if (mTracker)
+			mTracker->StartTiming();
+	}
+
+	~ScopedTiming()
+	{
+		if (mTracker)
+			mTracker->AddMeasurement();
+	}
+
+	ScopedTiming(const ScopedTiming&)            = delete;
+	ScopedTiming& operator=(const ScopedTiming&) = delete;
+
+private:
+	Tracker* mTracker;
 };
\ No newline at end of file
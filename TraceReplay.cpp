@@ -0,0 +1,378 @@
+#include "TraceReplay.h"
+
+#include "AllocationTrace.h"
+#include "MemoryPool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <unordered_map>
+#include <vector>
+
+#include <malloc.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+namespace Benchmarks
+{
+	// -------------------------------------------------------------------------
+
+	// How many operations are timed in one go - the allocator's stats are read in between, outside of the timing
+	constexpr unsigned int kReplayOperationsPerChunk = 4096;
+
+	// -------------------------------------------------------------------------
+
+	// A trace record once its address has been swapped for an id, so that the replay only indexes an array
+	struct ReplayOperation
+	{
+		uint32_t                mAllocationId;
+		uint32_t                mSize;
+		Memory::TraceOperation  mOperation;
+		uint8_t                 mAlignmentLog2;
+		uint8_t                 mFlags;
+	};
+
+	// -------------------------------------------------------------------------
+
+	// Its own pool rather than the main one, so that the replay starts from an empty arena and does not disturb the program
+	class MemoryPoolReplayAllocator final : public ReplayAllocator
+	{
+	public:
+		MemoryPoolReplayAllocator()
+			: mPool((Memory::MemoryPool*)malloc(sizeof(Memory::MemoryPool)))
+		{
+			if (!mPool)
+				return;
+
+			new (mPool) Memory::MemoryPool();
+
+			// Not asserting when full, so that a trace too big for the pool shows up as failed allocations
+			mPool->Init(Memory::kBytesAllocatedForLargeAllocations, Memory::kBytesAllocatedForFreeArray, false, false);
+		}
+
+		~MemoryPoolReplayAllocator()
+		{
+			if (!mPool)
+				return;
+
+			mPool->~MemoryPool();
+			free(mPool);
+		}
+
+		const char* GetName() const override { return "MemoryPool"; }
+
+		void* Allocate(size_t size, size_t alignment, bool forArray) override
+		{
+			if (alignment > Memory::kArchitectureAlignment)
+				return mPool->AssignAlignedMemory(size, alignment);
+
+			return mPool->AssignMemory(size, forArray);
+		}
+
+		void Free(void* memory, size_t size, size_t alignment, bool forArray) override
+		{
+			if (alignment > Memory::kArchitectureAlignment)
+				mPool->FreeAlignedMemory(memory);
+			else
+				mPool->FreeMemory(forArray ? 0 : size, memory, forArray);
+		}
+
+		size_t GetPeakBytesHeld() const override { return mPool->GetStats().mPeakBytesInUse; }
+		float  GetFragmentation() const override { return mPool->GetStats().mFragmentation; }
+
+	private:
+		Memory::MemoryPool* mPool;
+	};
+
+	// -------------------------------------------------------------------------
+
+	class MallocReplayAllocator final : public ReplayAllocator
+	{
+	public:
+		const char* GetName() const override { return "malloc"; }
+
+		void* Allocate(size_t size, size_t alignment, bool) override
+		{
+			if (alignment > Memory::kArchitectureAlignment)
+			{
+#ifdef _WIN32
+				return _aligned_malloc(size, alignment);
+#else
+				return aligned_alloc(alignment, (size + alignment - 1) & ~(alignment - 1));
+#endif
+			}
+
+			return malloc(size);
+		}
+
+		void Free(void* memory, size_t, size_t alignment, bool) override
+		{
+#ifdef _WIN32
+			if (alignment > Memory::kArchitectureAlignment)
+			{
+				_aligned_free(memory);
+				return;
+			}
+#else
+			(void)alignment;
+#endif
+			free(memory);
+		}
+	};
+
+	// -------------------------------------------------------------------------
+
+	// Reads the trace, puts every thread's records into one timeline and swaps the addresses for ids
+	static bool LoadTrace(const char* path, std::vector<ReplayOperation>& operations, uint32_t& allocationIdCount, size_t& skippedFrees)
+	{
+		FILE* file = fopen(path, "rb");
+
+		if (!file)
+		{
+			std::cout << "Could not open allocation trace " << path << std::endl;
+			return false;
+		}
+
+		Memory::TraceFileHeader header = {};
+
+		if (fread(&header, sizeof(header), 1, file) != 1 || header.mMagic != Memory::kTraceFileMagic || 
+			header.mVersion != Memory::kTraceFileVersion || header.mRecordSize != sizeof(Memory::TraceRecord))
+		{
+			std::cout << path << " is not an allocation trace this build can read" << std::endl;
+
+			fclose(file);
+			return false;
+		}
+
+		// Everything after the header is records, so read them all in one go
+		long recordsStart = ftell(file);
+
+		fseek(file, 0, SEEK_END);
+		long fileEnd = ftell(file);
+		fseek(file, recordsStart, SEEK_SET);
+
+		std::vector<Memory::TraceRecord> records((size_t)(fileEnd - recordsStart) / sizeof(Memory::TraceRecord));
+
+		size_t recordsRead = fread(records.data(), sizeof(Memory::TraceRecord), records.size(), file);
+		records.resize(recordsRead);
+
+		fclose(file);
+
+		// Each thread's buffer was written out when it filled up, so the file is only in order per thread
+		std::stable_sort(records.begin(), records.end(), [](const Memory::TraceRecord& a, const Memory::TraceRecord& b)
+		{
+			return a.mTimestamp < b.mTimestamp;
+		});
+
+		std::unordered_map<uint64_t, uint32_t> liveAllocations;
+
+		operations.clear();
+		operations.reserve(records.size());
+
+		allocationIdCount = 0;
+		skippedFrees      = 0;
+
+		for (const Memory::TraceRecord& current : records)
+		{
+			ReplayOperation operation;
+			operation.mSize          = current.mSize;
+			operation.mOperation     = current.mOperation;
+			operation.mAlignmentLog2 = current.mAlignmentLog2;
+			operation.mFlags         = current.mFlags;
+
+			if (current.mOperation == Memory::TraceOperation::Allocate)
+			{
+				operation.mAllocationId           = allocationIdCount++;
+				liveAllocations[current.mAddress] = operation.mAllocationId;
+			}
+			else
+			{
+				std::unordered_map<uint64_t, uint32_t>::iterator found = liveAllocations.find(current.mAddress);
+
+				// Allocated before recording started, so there is nothing in the replay to free
+				if (found == liveAllocations.end())
+				{
+					skippedFrees++;
+					continue;
+				}
+
+				operation.mAllocationId = found->second;
+				liveAllocations.erase(found);
+			}
+
+			operations.push_back(operation);
+		}
+
+		return true;
+	}
+
+	// -------------------------------------------------------------------------
+
+	// What the replay needs to know about an allocation that is still live
+	struct ReplayLiveAllocation
+	{
+		void*    mMemory;
+		uint32_t mSize;
+		uint8_t  mAlignmentLog2;
+		uint8_t  mFlags;
+	};
+
+	// -------------------------------------------------------------------------
+
+	static void ReplayOperations(const std::vector<ReplayOperation>& operations, uint32_t allocationIdCount, ReplayAllocator& allocator)
+	{
+		// One slot per allocation id, from malloc so the replay's own bookkeeping is not part of what is being measured
+		ReplayLiveAllocation* liveAllocations = (ReplayLiveAllocation*)calloc(allocationIdCount > 0 ? allocationIdCount : 1, sizeof(ReplayLiveAllocation));
+
+		if (!liveAllocations)
+			return;
+
+		std::chrono::nanoseconds timeTaken(0);
+
+		size_t liveBytes          = 0;
+		size_t peakLiveBytes      = 0;
+		float  worstFragmentation = allocator.GetFragmentation();
+		size_t failedAllocations  = 0;
+
+		for (size_t chunkStart = 0; chunkStart < operations.size(); chunkStart += kReplayOperationsPerChunk)
+		{
+			size_t chunkEnd = std::min(chunkStart + (size_t)kReplayOperationsPerChunk, operations.size());
+
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+			for (size_t i = chunkStart; i < chunkEnd; i++)
+			{
+				const ReplayOperation& operation = operations[i];
+				ReplayLiveAllocation&  live      = liveAllocations[operation.mAllocationId];
+
+				size_t alignment = operation.mAlignmentLog2 > 0 ? (size_t)1 << operation.mAlignmentLog2 : 0;
+				bool   forArray  = (operation.mFlags & Memory::kTraceFlagArray) != 0;
+
+				if (operation.mOperation == Memory::TraceOperation::Allocate)
+				{
+					live.mMemory = allocator.Allocate(operation.mSize, alignment, forArray);
+
+					if (!live.mMemory)
+					{
+						failedAllocations++;
+						continue;
+					}
+
+					live.mSize          = operation.mSize;
+					live.mAlignmentLog2 = operation.mAlignmentLog2;
+					live.mFlags         = operation.mFlags;
+
+					liveBytes += operation.mSize;
+
+					if (liveBytes > peakLiveBytes)
+						peakLiveBytes = liveBytes;
+				}
+				else
+				{
+					// The allocation failed, so there is nothing to free
+					if (!live.mMemory)
+						continue;
+
+					allocator.Free(live.mMemory, live.mSize, alignment, forArray);
+
+					live.mMemory = nullptr;
+					liveBytes   -= live.mSize;
+				}
+			}
+
+			timeTaken += std::chrono::steady_clock::now() - start;
+
+			// Only checked between chunks, so a short spike in fragmentation inside a chunk can be missed
+			float fragmentation = allocator.GetFragmentation();
+
+			if (fragmentation > worstFragmentation)
+				worstFragmentation = fragmentation;
+		}
+
+		float  finalFragmentation = allocator.GetFragmentation();
+		size_t peakBytesHeld      = allocator.GetPeakBytesHeld();
+
+		std::cout << std::left << std::setw(14) << allocator.GetName();
+		std::cout << std::setw(12) << std::fixed << std::setprecision(2) << (double)timeTaken.count() / 1e6;
+		std::cout << std::setw(10) << std::setprecision(1) << (operations.empty() ? 0.0 : (double)timeTaken.count() / (double)operations.size());
+		std::cout << std::setw(16) << peakLiveBytes;
+
+		if (peakBytesHeld > 0)
+			std::cout << std::setw(16) << peakBytesHeld;
+		else
+			std::cout << std::setw(16) << "N/A";
+
+		if (finalFragmentation >= 0.0f)
+			std::cout << std::setw(12) << std::setprecision(4) << worstFragmentation << std::setw(12) << finalFragmentation;
+		else
+			std::cout << std::setw(12) << "N/A" << std::setw(12) << "N/A";
+
+		std::cout << failedAllocations << std::endl;
+
+		// Anything the trace never freed is given back outside of the timing
+		for (uint32_t i = 0; i < allocationIdCount; i++)
+		{
+			ReplayLiveAllocation& live = liveAllocations[i];
+
+			if (!live.mMemory)
+				continue;
+
+			allocator.Free(live.mMemory, live.mSize, live.mAlignmentLog2 > 0 ? (size_t)1 << live.mAlignmentLog2 : 0, (live.mFlags & Memory::kTraceFlagArray) != 0);
+		}
+
+		free(liveAllocations);
+	}
+
+	// -------------------------------------------------------------------------
+
+	static void OutputReplayHeader(const char* path, size_t operationCount, size_t skippedFrees)
+	{
+		std::cout << "Replaying " << path << " - " << operationCount << " operations";
+		std::cout << " (" << skippedFrees << " frees of memory allocated before recording started were dropped)" << std::endl;
+
+		std::cout << std::left << std::setw(14) << "Allocator" << std::setw(12) << "Time (ms)" << std::setw(10) << "ns/op";
+		std::cout << std::setw(16) << "Peak live" << std::setw(16) << "Peak held" << std::setw(12) << "Worst frag" << std::setw(12) << "Final frag" << "Failed" << std::endl;
+	}
+
+	// -------------------------------------------------------------------------
+
+	bool ReplayAllocationTrace(const char* path, ReplayAllocator& allocator)
+	{
+		std::vector<ReplayOperation> operations;
+		uint32_t                     allocationIdCount = 0;
+		size_t                       skippedFrees      = 0;
+
+		if (!LoadTrace(path, operations, allocationIdCount, skippedFrees))
+			return false;
+
+		OutputReplayHeader(path, operations.size(), skippedFrees);
+
+		ReplayOperations(operations, allocationIdCount, allocator);
+
+		return true;
+	}
+
+	// -------------------------------------------------------------------------
+
+	void ReplayAllocationTrace(const char* path)
+	{
+		// Loaded once and shared, as sorting and mapping the addresses is by far the slowest part
+		std::vector<ReplayOperation> operations;
+		uint32_t                     allocationIdCount = 0;
+		size_t                       skippedFrees      = 0;
+
+		if (!LoadTrace(path, operations, allocationIdCount, skippedFrees))
+			return;
+
+		OutputReplayHeader(path, operations.size(), skippedFrees);
+
+		MemoryPoolReplayAllocator poolAllocator;
+		ReplayOperations(operations, allocationIdCount, poolAllocator);
+
+		MallocReplayAllocator mallocAllocator;
+		ReplayOperations(operations, allocationIdCount, mallocAllocator);
+	}
+
+	// -------------------------------------------------------------------------
+}
\ No newline at end of file
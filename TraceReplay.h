@@ -0,0 +1,36 @@
+#pragma once
+
+#include <stddef.h>
+
+namespace Benchmarks
+{
+	// ----------------------------------------------------------
+
+	// Anything a recorded trace can be played back against - wrap a candidate allocator in one of these to compare it with the pool
+	class ReplayAllocator abstract
+	{
+	public:
+		virtual ~ReplayAllocator() { }
+
+		virtual const char* GetName() const                                              = 0;
+
+		virtual void*       Allocate(size_t size, size_t alignment, bool forArray)           = 0;
+		virtual void        Free(void* memory, size_t size, size_t alignment, bool forArray) = 0;
+
+		// The most the allocator has held at once for live allocations, its own headers and padding included - 0 if it cannot tell
+		virtual size_t      GetPeakBytesHeld() const { return 0; }
+
+		// 0 when all of the free space is in one piece, towards 1 as it is split up - negative if it cannot tell
+		virtual float       GetFragmentation() const { return -1.0f; }
+	};
+
+	// ----------------------------------------------------------
+
+	// Plays the trace back, in timestamp order on one thread, against the pool and malloc and prints a comparison
+	void ReplayAllocationTrace(const char* path);
+
+	// Plays the trace back against one allocator - returns false if the trace could not be loaded
+	bool ReplayAllocationTrace(const char* path, ReplayAllocator& allocator);
+
+	// ----------------------------------------------------------
+}
\ No newline at end of file
@@ -8,9 +8,12 @@
 #include <chrono>
 
 #include "TimeTracker.h"
+#include "Profiler.h"
+#include "LockProfiler.h"
 #include "Cube.h"
 #include "Vector3D.h"
 #include "Quadtree.h"
+#include "MemoryTags.h"
 
 #include "Commons.h"
 
@@ -18,10 +21,50 @@
     #include "GlobalTrackers.h"
 #endif
 
-#if UseMemoryPools
+#if MemoryOverride && CountFrameAllocations
+    #include "AllocationCounter.h"
+#endif
+
+#if UseMemoryPools || UseNumaPlacement
     #include "MemoryPool.h"
 #endif
 
+#if RunNumaBenchmark
+    #include "NumaBenchmark.h"
+#endif
+
+#if RunAllocatorBenchmark
+    #include "AllocatorBenchmark.h"
+#endif
+
+#if RunKernelBenchmarks
+    #include "KernelBenchmark.h"
+#endif
+
+#if RunScalingSweep
+    #include "ScalingSweep.h"
+#endif
+
+#if RunRegressionCheck
+    #include "RegressionCheck.h"
+#endif
+
+#if MemoryOverride && CaptureAllocationTrace
+    #include "AllocationTrace.h"
+#endif
+
+#if RunTraceReplay
+    #include "TraceReplay.h"
+#endif
+
+#if LogMemoryPoolStats
+    #include "MemoryStatsLogger.h"
+#endif
+
+#if MemoryOverride && UseAllocationSampling
+    #include "AllocationSampler.h"
+#endif
+
 // Trackers - overall
 TimeTracker sIdleTimeTracker;
 TimeTracker sRenderTimeTracker;
@@ -32,6 +75,10 @@ TimeTracker sRenderTimeTracker;
     TimeTracker mDrawSceneTimeTracker;
 #endif
 
+#if LogMemoryPoolStats
+    Memory::MemoryStatsLogger sMemoryStatsLogger;
+#endif
+
 // --------------------------------------------------------------------------------------------------- //
 
     Quadtree* sQuadtree = nullptr;
@@ -40,6 +87,8 @@ TimeTracker sRenderTimeTracker;
 
 void initScene(int boxCount) 
 {
+    Memory::ScopedMemoryTag memoryTag(Memory::MemoryTag::PhysicsState);
+
     float xRange = maxX - minX;
     float zRange = maxX - minX;
 
@@ -73,40 +122,6 @@ void initScene(int boxCount)
 
 // --------------------------------------------------------------------------------------------------- //
 
-bool rayBoxIntersection(const Vec3& rayOrigin, const Vec3& rayDirection, const Box& box)
-{
-    float tMin = (box.position.x - box.halfSize.x - rayOrigin.x) / rayDirection.x;
-    float tMax = (box.position.x + box.halfSize.x - rayOrigin.x) / rayDirection.x;
-
-    if (tMin > tMax) std::swap(tMin, tMax);
-
-    float tyMin = (box.position.y - box.halfSize.y - rayOrigin.y) / rayDirection.y;
-    float tyMax = (box.position.y + box.halfSize.y - rayOrigin.y) / rayDirection.y;
-
-    if (tyMin > tyMax) std::swap(tyMin, tyMax);
-
-    if ((tMin > tyMax) || (tyMin > tMax))
-        return false;
-
-    if (tyMin > tMin)
-        tMin = tyMin;
-
-    if (tyMax < tMax)
-        tMax = tyMax;
-
-    float tzMin = (box.position.z - box.halfSize.z - rayOrigin.z) / rayDirection.z;
-    float tzMax = (box.position.z + box.halfSize.z - rayOrigin.z) / rayDirection.z;
-
-    if (tzMin > tzMax) std::swap(tzMin, tzMax);
-
-    if ((tMin > tzMax) || (tzMin > tMax))
-        return false;
-
-    return true;
-}
-
-// --------------------------------------------------------------------------------------------------- //
-
 Vec3 screenToWorld(int x, int y) 
 {
     GLint    viewport[4];
@@ -210,6 +225,10 @@ void drawScene()
 
 void display() 
 {
+    Memory::ScopedMemoryTag memoryTag(Memory::MemoryTag::Render);
+
+    PROFILE_ZONE("Display");
+
     sRenderTimeTracker.StartTiming();
     {
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
@@ -228,6 +247,15 @@ void display()
 
 void idle() 
 {
+    // Between frames, so the workers are not recording anything if this writes the trace out
+    Profiling::Profiler::NextFrame();
+
+#if ProfileLockContention
+    Profiling::LockProfiler::NextFrame();
+#endif
+
+    PROFILE_ZONE("Idle");
+
     static std::chrono::steady_clock::time_point last      = std::chrono::steady_clock::now();
 	std::chrono::steady_clock::time_point        old       = last;
 		                                         last      = std::chrono::steady_clock::now();
@@ -235,6 +263,10 @@ void idle()
 	const std::chrono::duration<float>           frameTime = last - old;
 	float                                        deltaTime = frameTime.count();
 
+#if LogMemoryPoolStats
+    sMemoryStatsLogger.Update(deltaTime);
+#endif
+
     // If there are 0 threads allocated then we need to do it all on the main thread like before
     if (ThreadsToAllocateToProgram > 0)
     {
@@ -324,11 +356,8 @@ void keyboard(unsigned char key, int x, int y)
 #if UseMemoryPools
     else if (key == '2')
     {
-        Memory::MemoryPool::Get()->GetMutex()->lock();
-
-            Memory::MemoryPool::Get()->DebugOutputUsage(true, false);
-
-        Memory::MemoryPool::Get()->GetMutex()->unlock();
+        // Only reads the counters, so the workers carry on allocating while this prints
+        Memory::MemoryPool::Get()->GetStats().Output();
     }
     else if (key == '3')
     {
@@ -339,12 +368,38 @@ void keyboard(unsigned char key, int x, int y)
         Memory::MemoryPool::Get()->GetMutex()->unlock();
     }
 #endif
+
+#if MemoryOverride && UseAllocationSampling
+    else if (key == '4')
+    {
+        Memory::AllocationSampler::OutputReport();
+    }
+#endif
+
+#if MemoryOverride && UseMemoryTags
+    else if (key == '5')
+    {
+        Memory::MemoryTags::OutputUsage();
+    }
+#endif
+    else if (key == '6')
+    {
+        if (!sQuadtree->SaveState(WorldSnapshotPath))
+            std::cout << "Could not save the world to " << WorldSnapshotPath << std::endl;
+    }
+    else if (key == '7')
+    {
+        if (!sQuadtree->LoadState(WorldSnapshotPath))
+            std::cout << "Could not load the world from " << WorldSnapshotPath << std::endl;
+    }
 }
 
 // --------------------------------------------------------------------------------------------------- //
 
 void OutputFinalMeasurements()
 {
+    Memory::ScopedMemoryTag memoryTag(Memory::MemoryTag::IO);
+
     std::cout << "Update timings: ";
     sQuadtree->GetTimeTracker().OutputAverageTime();
 
@@ -361,6 +416,58 @@ void OutputFinalMeasurements()
 
     std::cout << "Average time for draw scene function call: ";
     mDrawSceneTimeTracker.OutputAverageTime();
+
+    sQuadtree->OutputLeafStageTimings();
+#endif
+
+#if UsePerfCounters
+    sQuadtree->OutputPerfCounters();
+#endif
+
+    // The averages hide the spikes, so the tails of the per-frame trackers are given as well
+    std::cout << std::endl << "Update latency:  ";
+    sQuadtree->GetTimeTracker().OutputPercentiles();
+
+    std::cout << "Idle latency:    ";
+    sIdleTimeTracker.OutputPercentiles();
+
+    std::cout << "Display latency: ";
+    sRenderTimeTracker.OutputPercentiles();
+
+    if (FILE* histogramFile = fopen(TimingHistogramPath, "w"))
+    {
+        fprintf(histogramFile, "Tracker,UpperBoundNanoseconds,Count,Percentile\n");
+
+        sQuadtree->GetTimeTracker().GetHistogram().WriteCSV(histogramFile, "Update");
+        sIdleTimeTracker.GetHistogram().WriteCSV(histogramFile, "Idle");
+        sRenderTimeTracker.GetHistogram().WriteCSV(histogramFile, "Display");
+
+        fclose(histogramFile);
+    }
+    else
+    {
+        std::cout << "Could not open " << TimingHistogramPath << " for the timing histograms" << std::endl;
+    }
+
+#if UseNumaPlacement
+    sQuadtree->OutputNumaPlacement();
+#endif
+
+#if UseMemoryPools
+    // Reported at the end, as transparent huge pages only show up once the memory has been touched
+    Memory::MemoryPool::Get()->OutputHugePageUsage();
+#endif
+
+#if MemoryOverride && UseAllocationSampling
+    Memory::AllocationSampler::OutputReport();
+#endif
+
+#if MemoryOverride && UseMemoryTags
+    Memory::MemoryTags::OutputUsage();
+#endif
+
+#if MemoryOverride && CountFrameAllocations
+    Memory::AllocationCounter::Output();
 #endif
 }
 
@@ -377,15 +484,75 @@ int main(int argc, char** argv)
 {
 #if UseMemoryPools
     // Getting here so that it is setup
-    Memory::MemoryPool::Get()->Init();
+    Memory::MemoryPool::Get()->Init(Memory::kBytesAllocatedForLargeAllocations, Memory::kBytesAllocatedForFreeArray, true, UseHugePages);
     Memory::MemoryPool::Get()->InitMutex();
 #endif
 
+#if UseNumaPlacement
+    // Needs to be before the quadtree is created, as the leaves take their regions from these
+    Memory::MemoryPool::InitNodePools();
+#endif
+
+#if RunNumaBenchmark
+    Benchmarks::MeasureNumaBandwidth();
+    return 0;
+#endif
+
+#if RunAllocatorBenchmark
+    Benchmarks::CompareAllocators();
+    return 0;
+#endif
+
+#if RunKernelBenchmarks
+    Benchmarks::MeasureKernels(KernelBenchmarkPath);
+    return 0;
+#endif
+
+#if RunScalingSweep
+    Benchmarks::MeasureScaling(ScalingSweepPath);
+    return 0;
+#endif
+
+#if RunRegressionCheck
+    return Benchmarks::CheckForRegressions(RegressionBaselinePath, RegressionWriteBaseline);
+#endif
+
+#if RunTraceReplay
+    Benchmarks::ReplayAllocationTrace(AllocationTracePath);
+    return 0;
+#endif
+
+    {
+        Memory::ScopedMemoryTag memoryTag(Memory::MemoryTag::IO);
+
+#if MemoryOverride && CaptureAllocationTrace
+        if (!Memory::AllocationTrace::Start(AllocationTracePath))
+            std::cout << "Could not open " << AllocationTracePath << " for the allocation trace" << std::endl;
+#endif
+
+#if LogMemoryPoolStats
+        if (!sMemoryStatsLogger.Open(MemoryPoolStatsPath, MemoryPoolStatsInterval))
+            std::cout << "Could not open " << MemoryPoolStatsPath << " for the memory pool stats" << std::endl;
+#endif
+
+#if UseProfilerZones
+        Profiling::Profiler::Setup(ProfilerTracePath, ProfilerFirstFrame, ProfilerFrameCount);
+        Profiling::Profiler::SetThreadName("Main");
+#endif
+    }
+
     std::cout << "Time taken for setup: ";
     sIdleTimeTracker.StartTiming();
     {
+        // The window and GL state are charged to rendering - the tree and the scene set their own tags
+        Memory::ScopedMemoryTag memoryTag(Memory::MemoryTag::Render);
+
         // Setup
+#if SceneRandomSeed
+        srand(SceneRandomSeed);
+#else
         srand(static_cast<unsigned>(time(0))); // Seed random number generator
+#endif
         glutInit(&argc, argv);
         glutInitDisplayMode(GLUT_DOUBLE | GLUT_RGB | GLUT_DEPTH);
         glutInitWindowSize(1920, 1080);
@@ -413,7 +580,13 @@ int main(int argc, char** argv)
 
         sQuadtree = new Quadtree(QuadtreeDepth, { minX, 0.0f, minZ }, { maxX, 1.0f, maxZ });
 
+#if RestoreWorldFromSnapshot
+        // Maps the boxes straight back in - falls back to a fresh scene if there is no snapshot yet
+        if (!sQuadtree->LoadState(WorldSnapshotPath))
+            initScene(NUMBER_OF_BOXES);
+#else
         initScene(NUMBER_OF_BOXES);
+#endif
 
         // Provide the render callbacks
         glutDisplayFunc(display);
@@ -429,9 +602,26 @@ int main(int argc, char** argv)
 
     OutputFinalMeasurements();
 
+#if UseMemoryTracking
+    Memory::ShutdownGlobalTrackers();
+#endif
+
+#if LogMemoryPoolStats
+    // One last row, so the file always has the state at exit
+    Memory::ScopedMemoryTag memoryTag(Memory::MemoryTag::IO);
+
+    sMemoryStatsLogger.LogNow();
+    sMemoryStatsLogger.Close();
+#endif
+
     delete sQuadtree;
     sQuadtree = nullptr;
 
+#if MemoryOverride && CaptureAllocationTrace
+    // After the quadtree has gone, so that its workers have stopped and its teardown is in the trace
+    Memory::AllocationTrace::Stop();
+#endif
+
     return 0;
 }
 